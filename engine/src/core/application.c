@@ -8,9 +8,16 @@
 #include "core/event.h"
 #include "core/input.h"
 #include "core/clock.h"
+#include "core/profiler.h"
+#include "core/frame_stats.h"
+#include "core/frame_pacer.h"
+#include "core/fixed_timestep.h"
 
 #include "memory/linear_allocator.h"
 
+#include "systems/job_system.h"
+#include "systems/task_graph.h"
+
 #include "renderer/renderer_frontend.h"
 
 typedef struct application_state {
@@ -21,6 +28,10 @@ typedef struct application_state {
     i16 height;
     clock clock;
     f64 last_time;
+    frame_pacer pacer;
+    // Only used with fixed updates.
+    b8 use_fixed_timestep;
+    fixed_timestep timestep;
     linear_allocator systems_allocator;
 
     u64 event_system_memory_requirement;
@@ -32,9 +43,29 @@ typedef struct application_state {
     u64 logging_system_memory_requirement;
     void* logging_system_state;
 
+    u64 profiler_system_memory_requirement;
+    void* profiler_system_state;
+
+    u64 frame_stats_system_memory_requirement;
+    void* frame_stats_system_state;
+
     u64 input_system_memory_requirement;
     void* input_system_state;
 
+    u64 job_system_memory_requirement;
+    void* job_system_state;
+
+    // Per-frame work, executed on the job system.
+    task_graph frame_graph;
+    // The delta time of the frame being executed, for frame tasks.
+    f64 frame_delta;
+    // The number of updates to run this frame and their delta. Once with the frame delta
+    // unless using fixed updates.
+    u32 update_count;
+    f64 update_delta;
+    // How far between the last two updates to render.
+    f32 render_alpha;
+
     u64 platform_system_memory_requirement;
     void* platform_system_state;
 
@@ -50,6 +81,11 @@ b8 application_on_event(u16 code, void* sender, void* listener_inst, event_conte
 b8 application_on_key(u16 code, void* sender, void* listener_inst, event_context context);
 b8 application_on_resized(u16 code, void* sender, void* listener_inst, event_context context);
 
+// Frame tasks
+b8 application_task_update(void* user);
+b8 application_task_render(void* user);
+b8 application_task_draw_frame(void* user);
+
 b8 application_create(game* game_inst) {
     if (game_inst->application_state) {
         KERROR("application_create called more than once.");
@@ -78,17 +114,59 @@ b8 application_create(game* game_inst) {
     memory_system_initialize(&app_state->memory_system_memory_requirement, app_state->memory_system_state);
 
     // Logging
-    initialize_logging(&app_state->logging_system_memory_requirement, 0);
+    // By default written out on a background thread, so logging doesn't stall the frame.
+    logger_config logging_config = {0};
+    logging_config.async = true;
+    logging_config.file_path = "console.log";
+    logging_config.file_flush_level = LOG_LEVEL_ERROR;
+    logging_config.file_max_size = 16 * 1024 * 1024;
+    logging_config.file_max_backups = 3;
+    if (game_inst->app_config.logging) {
+        logging_config = *game_inst->app_config.logging;
+    }
+    initialize_logging(&app_state->logging_system_memory_requirement, 0, &logging_config);
     app_state->logging_system_state = linear_allocator_allocate(&app_state->systems_allocator, app_state->logging_system_memory_requirement);
-    if (!initialize_logging(&app_state->logging_system_memory_requirement, app_state->logging_system_state)) {
+    if (!initialize_logging(&app_state->logging_system_memory_requirement, app_state->logging_system_state, &logging_config)) {
         KERROR("Failed to initialize logging system; shutting down.");
         return false;
     }
 
+    // Profiler
+    profiler_system_initialize(&app_state->profiler_system_memory_requirement, 0);
+    app_state->profiler_system_state = linear_allocator_allocate(&app_state->systems_allocator, app_state->profiler_system_memory_requirement);
+    profiler_system_initialize(&app_state->profiler_system_memory_requirement, app_state->profiler_system_state);
+    if (game_inst->app_config.profile_counters) {
+        profiler_set_counters_enabled(true);
+    }
+    if (game_inst->app_config.profile_capture_path) {
+        u32 capture_frames = game_inst->app_config.profile_capture_frames ? game_inst->app_config.profile_capture_frames : 300;
+        profiler_capture_start(game_inst->app_config.profile_capture_path, capture_frames);
+    }
+
+    // Frame stats
+    frame_stats_system_initialize(&app_state->frame_stats_system_memory_requirement, 0, 0);
+    app_state->frame_stats_system_state = linear_allocator_allocate(&app_state->systems_allocator, app_state->frame_stats_system_memory_requirement);
+    frame_stats_system_initialize(&app_state->frame_stats_system_memory_requirement, app_state->frame_stats_system_state, 0);
+
+    // Jobs
+    job_system_config job_config = {0};
+    job_config.use_fibers = true;
+    job_system_initialize(&app_state->job_system_memory_requirement, 0, &job_config);
+    app_state->job_system_state = linear_allocator_allocate(&app_state->systems_allocator, app_state->job_system_memory_requirement);
+    if (!job_system_initialize(&app_state->job_system_memory_requirement, app_state->job_system_state, &job_config)) {
+        KFATAL("Failed to initialize job system; shutting down.");
+        return false;
+    }
+
     // Input
     input_system_initialize(&app_state->input_system_memory_requirement, 0);
     app_state->input_system_state = linear_allocator_allocate(&app_state->systems_allocator, app_state->input_system_memory_requirement);
     input_system_initialize(&app_state->input_system_memory_requirement, app_state->input_system_state);
+    if (game_inst->app_config.input_replay_path) {
+        input_replay_start(game_inst->app_config.input_replay_path, 0);
+    } else if (game_inst->app_config.input_record_path) {
+        input_recording_start(game_inst->app_config.input_record_path);
+    }
 
     // Register for engine-level events.
     event_register(EVENT_CODE_APPLICATION_QUIT, 0, application_on_event);
@@ -96,6 +174,10 @@ b8 application_create(game* game_inst) {
     event_register(EVENT_CODE_KEY_RELEASED, 0, application_on_key);
     event_register(EVENT_CODE_RESIZED, 0, application_on_resized);
 
+    // Window managers can report many sizes per frame while dragging; only the last matters,
+    // and it keeps renderer_on_resized to once per frame.
+    event_set_coalescing(EVENT_CODE_RESIZED, EVENT_COALESCE_LAST_WINS, 0);
+
     // Platform
     platform_system_startup(&app_state->platform_system_memory_requirement, 0, 0, 0, 0, 0, 0);
     app_state->platform_system_state = linear_allocator_allocate(&app_state->systems_allocator, app_state->platform_system_memory_requirement);
@@ -118,6 +200,38 @@ b8 application_create(game* game_inst) {
         return false;
     }
 
+    // Frame task graph. Engine tasks are registered first; the game may add its own in initialize.
+    // The frame is the critical path, so its tasks go on the high priority lane.
+    task_graph_create(&app_state->frame_graph);
+    app_state->frame_graph.priority = JOB_PRIORITY_HIGH;
+    u64 game_state_resource = task_graph_resource(&app_state->frame_graph, "game_state");
+    u64 render_data_resource = task_graph_resource(&app_state->frame_graph, "render_data");
+
+    // The game's update and render stay on the main thread, which game code has always been
+    // able to rely on. They run in a strict chain with drawing anyway, so nothing is lost.
+    task_desc update_task = {0};
+    update_task.name = "game_update";
+    update_task.execute = application_task_update;
+    update_task.writes = game_state_resource;
+    update_task.main_thread = true;
+    task_graph_add_task(&app_state->frame_graph, &update_task);
+
+    task_desc render_task = {0};
+    render_task.name = "game_render";
+    render_task.execute = application_task_render;
+    render_task.reads = game_state_resource;
+    render_task.writes = render_data_resource;
+    render_task.main_thread = true;
+    task_graph_add_task(&app_state->frame_graph, &render_task);
+
+    // Presents to the swapchain, so must stay on the main thread.
+    task_desc draw_frame_task = {0};
+    draw_frame_task.name = "renderer_draw_frame";
+    draw_frame_task.execute = application_task_draw_frame;
+    draw_frame_task.reads = render_data_resource;
+    draw_frame_task.main_thread = true;
+    task_graph_add_task(&app_state->frame_graph, &draw_frame_task);
+
     // Initialize the game.
     if (!app_state->game_inst->initialize(app_state->game_inst)) {
         KFATAL("Game failed to initialize.");
@@ -135,59 +249,66 @@ b8 application_run() {
     clock_start(&app_state->clock);
     clock_update(&app_state->clock);
     app_state->last_time = app_state->clock.elapsed;
-    f64 running_time = 0;
-    u8 frame_count = 0;
-    f64 target_frame_seconds = 1.0f / 60;
+    frame_pacer_create(app_state->game_inst->app_config.target_frame_rate, 0, &app_state->pacer);
+    app_state->use_fixed_timestep = app_state->game_inst->app_config.fixed_update_rate > 0;
+    if (app_state->use_fixed_timestep) {
+        fixed_timestep_create(app_state->game_inst->app_config.fixed_update_rate, app_state->game_inst->app_config.max_updates_per_frame, &app_state->timestep);
+    }
 
     KINFO(get_memory_usage_str());
 
     while (app_state->is_running) {
+        // Covers the whole frame, which the profiler then collects.
+        KPROFILE_BEGIN(frame_zone, "application_run");
+        f64 frame_start_time = platform_get_absolute_time();
+
         if (!platform_pump_messages()) {
             app_state->is_running = false;
         }
 
+        // Input and window events gathered while pumping messages, handled as one batch.
+        // Done before the suspended check, as a resize is what resumes the application.
+        event_dispatch_queued();
+
+        // Main thread work queued since the last frame, such as window operations.
+        job_system_drain_main_thread();
+
         if (!app_state->is_suspended) {
             // Update clock and get delta time.
             clock_update(&app_state->clock);
             f64 current_time = app_state->clock.elapsed;
             f64 delta = (current_time - app_state->last_time);
-            f64 frame_start_time = platform_get_absolute_time();
-
-            if (!app_state->game_inst->update(app_state->game_inst, (f32)delta)) {
-                KFATAL("Game update failed, shutting down.");
-                app_state->is_running = false;
-                break;
+            if (input_is_replaying()) {
+                // Replayed sessions must step the same way every run, whatever the frame took.
+                delta = input_replay_frame_delta();
             }
 
-            // Call the game's render routine.
-            if (!app_state->game_inst->render(app_state->game_inst, (f32)delta)) {
-                KFATAL("Game render failed, shutting down.");
+            // Run the game's update and render and draw the frame, along with any other frame
+            // tasks. Main thread tasks are executed here while waiting on the rest.
+            app_state->frame_delta = delta;
+            if (app_state->use_fixed_timestep) {
+                app_state->update_count = fixed_timestep_advance(&app_state->timestep, delta);
+                app_state->update_delta = app_state->timestep.step;
+                app_state->render_alpha = fixed_timestep_alpha(&app_state->timestep);
+            } else {
+                app_state->update_count = 1;
+                app_state->update_delta = delta;
+                app_state->render_alpha = 1.0f;
+            }
+            if (!task_graph_execute(&app_state->frame_graph)) {
                 app_state->is_running = false;
+                // The failed frame is still ended, so it shows up in the profile.
+                KPROFILE_END(frame_zone);
+                KPROFILE_FRAME_END();
                 break;
             }
 
-            // TODO: refactor packet creation
-            render_packet packet;
-            packet.delta_time = delta;
-            renderer_draw_frame(&packet);
+            // Anything the frame's jobs handed back to the main thread.
+            job_system_drain_main_thread();
 
-            // Figure out how long the frame took and, if below
+            // Figure out how long the frame took.
             f64 frame_end_time = platform_get_absolute_time();
             f64 frame_elapsed_time = frame_end_time - frame_start_time;
-            running_time += frame_elapsed_time;
-            f64 remaining_seconds = target_frame_seconds - frame_elapsed_time;
-
-            if (remaining_seconds > 0) {
-                u64 remaining_ms = (remaining_seconds * 1000);
-
-                // If there is time left, give it back to the OS.
-                b8 limit_frames = false;
-                if (remaining_ms > 0 && limit_frames) {
-                    platform_sleep(remaining_ms - 1);
-                }
-
-                frame_count++;
-            }
 
             // NOTE: Input update/state copying should always be handled
             // after any input should be recorded; I.E. before this line.
@@ -195,24 +316,55 @@ b8 application_run() {
             // this frame ends.
             input_update(delta);
 
+            frame_stats_frame_end(frame_elapsed_time);
+
+            // Give any time left before the next frame back to the OS.
+            frame_pacer_wait(&app_state->pacer);
+
             // Update last time
             app_state->last_time = current_time;
         }
+
+        KPROFILE_END(frame_zone);
+        KPROFILE_FRAME_END();
     }
 
     app_state->is_running = false;
 
+    if (app_state->pacer.period > 0) {
+        frame_pacer_stats pacing;
+        frame_pacer_get_stats(&app_state->pacer, &pacing);
+        KINFO("Frame pacing: %llu waits, %llu late frames, error mean %.3fms, jitter %.3fms, max %.3fms.",
+              pacing.wait_count, pacing.late_count, pacing.mean_error * 1000.0, pacing.jitter * 1000.0, pacing.max_error * 1000.0);
+    }
+    if (app_state->use_fixed_timestep) {
+        KINFO("Fixed updates: %llu steps of %.3fms, %llu clamped frames dropping %.3fs.",
+              app_state->timestep.step_count, app_state->timestep.step * 1000.0, app_state->timestep.clamped_count, app_state->timestep.dropped_time);
+    }
+
     // Shutdown event system.
     event_unregister(EVENT_CODE_APPLICATION_QUIT, 0, application_on_event);
     event_unregister(EVENT_CODE_KEY_PRESSED, 0, application_on_key);
     event_unregister(EVENT_CODE_KEY_RELEASED, 0, application_on_key);
 
+    task_graph_report(&app_state->frame_graph);
+    task_graph_destroy(&app_state->frame_graph);
+
+    job_system_shutdown(app_state->job_system_state);
+
+    profiler_report();
+    profiler_system_shutdown(app_state->profiler_system_state);
+
+    frame_stats_system_shutdown(app_state->frame_stats_system_state);
+
     input_system_shutdown(app_state->input_system_state);
 
     renderer_system_shutdown(app_state->renderer_system_state);
 
     platform_system_shutdown(app_state->platform_system_state);
 
+    shutdown_logging(app_state->logging_system_state);
+
     memory_system_shutdown(app_state->memory_system_state);
 
     event_system_shutdown(app_state->event_system_state);
@@ -225,6 +377,43 @@ void application_get_framebuffer_size(u32* width, u32* height) {
     *height = app_state->height;
 }
 
+task_graph* application_get_frame_graph() {
+    return &app_state->frame_graph;
+}
+
+b8 application_task_update(void* user) {
+    f64 start_time = platform_get_absolute_time();
+    for (u32 i = 0; i < app_state->update_count; ++i) {
+        if (!app_state->game_inst->update(app_state->game_inst, (f32)app_state->update_delta)) {
+            KFATAL("Game update failed, shutting down.");
+            return false;
+        }
+    }
+    frame_stats_record(FRAME_STAT_UPDATE, platform_get_absolute_time() - start_time);
+    return true;
+}
+
+b8 application_task_render(void* user) {
+    // Call the game's render routine.
+    f64 start_time = platform_get_absolute_time();
+    if (!app_state->game_inst->render(app_state->game_inst, (f32)app_state->frame_delta, app_state->render_alpha)) {
+        KFATAL("Game render failed, shutting down.");
+        return false;
+    }
+    frame_stats_record(FRAME_STAT_RENDER, platform_get_absolute_time() - start_time);
+    return true;
+}
+
+b8 application_task_draw_frame(void* user) {
+    // TODO: refactor packet creation
+    render_packet packet;
+    packet.delta_time = app_state->frame_delta;
+    f64 start_time = platform_get_absolute_time();
+    renderer_draw_frame(&packet);
+    frame_stats_record(FRAME_STAT_PRESENT, platform_get_absolute_time() - start_time);
+    return true;
+}
+
 b8 application_on_event(u16 code, void* sender, void* listener_inst, event_context context) {
     switch (code) {
         case EVENT_CODE_APPLICATION_QUIT: {
@@ -249,7 +438,7 @@ b8 application_on_key(u16 code, void* sender, void* listener_inst, event_context
             return true;
         } else if (key_code == KEY_A) {
             // Example on checking for a key
-            KDEBUG("Explicit - A key pressed!");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Explicit - A key pressed!");
         } else {
             KDEBUG("'%c' key pressed in window.", key_code);
         }
@@ -257,7 +446,7 @@ b8 application_on_key(u16 code, void* sender, void* listener_inst, event_context
         u16 key_code = context.data.u16[0];
         if (key_code == KEY_B) {
             // Example on checking for a key
-            KDEBUG("Explicit - B key released!");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Explicit - B key released!");
         } else {
             KDEBUG("'%c' key released in window.", key_code);
         }
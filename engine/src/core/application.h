@@ -1,8 +1,10 @@
 #pragma once
 
 #include "defines.h"
+#include "core/logger.h"
 
 struct game;
+struct task_graph;
 
 // Application configuration.
 typedef struct application_config {
@@ -20,6 +22,41 @@ typedef struct application_config {
 
     // The application name used in windowing, if applicable.
     char* name;
+
+    // If set, input is recorded to this file for later replay.
+    const char* input_record_path;
+
+    // If set, input is replayed from this file in place of live input, with a fixed frame
+    // delta. The application quits when the replay ends. Takes precedence over recording.
+    const char* input_replay_path;
+
+    // The number of frames per second to hold to. 0 doesn't limit the rate.
+    f32 target_frame_rate;
+
+    // If set, the game is updated this many times per second with a fixed delta, however
+    // long frames take, and rendered with an alpha to interpolate between the last two
+    // updates. 0 updates once per frame with the frame's delta and an alpha of 1.
+    f32 fixed_update_rate;
+
+    // The most fixed updates run in one frame. Frames which would need more drop the time
+    // instead, so the simulation falls behind rather than slowing the game to a halt.
+    // 0 uses the default of 5.
+    u32 max_updates_per_frame;
+
+    // If set, the first profile_capture_frames frames are captured to this file as Chrome Trace Event JSON.
+    const char* profile_capture_path;
+
+    // The number of frames to capture to profile_capture_path. 0 uses the default of 300.
+    u32 profile_capture_frames;
+
+    // If set, profiled zones record hardware performance counters along with their time,
+    // where available. Adds a little overhead to every zone.
+    b8 profile_counters;
+
+    // If set, configures logging in place of the default, which logs asynchronously to the
+    // console and to console.log, flushing on errors and rotating at 16MiB with 3 backups.
+    // Servers may turn off the console here, for example.
+    const logger_config* logging;
 } application_config;
 
 
@@ -27,4 +64,11 @@ KAPI b8 application_create(struct game* game_inst);
 
 KAPI b8 application_run();
 
-void application_get_framebuffer_size(u32* width, u32* height);
\ No newline at end of file
+void application_get_framebuffer_size(u32* width, u32* height);
+
+/**
+ * @brief Obtains the task graph executed every frame. The game's update and render are
+ * registered first, reading/writing the "game_state" and "render_data" resources; games
+ * may add their own tasks from initialize.
+ */
+KAPI struct task_graph* application_get_frame_graph();
\ No newline at end of file
@@ -1,24 +1,190 @@
 #include "core/event.h"
 
 #include "core/kmemory.h"
+#include "core/logger.h"
+#include "core/profiler.h"
 #include "containers/darray.h"
+#include "platform/kmutex.h"
+#include "platform/kthread.h"
+#include "platform/platform.h"
+#include "platform/filesystem.h"
+#include "core/kstring.h"
 
+#include <stdlib.h>
+
+// A listener as seen by dispatch.
 typedef struct registered_event {
     void* listener;
     PFN_on_event callback;
 } registered_event;
 
+/**
+ * An immutable snapshot of the listeners for a code, in dispatch order. Never modified
+ * once published; it is rebuilt from the code's subscriptions instead, so dispatch can
+ * read it without locking.
+ */
+typedef struct event_listener_list {
+    u32 count;
+    registered_event events[];
+} event_listener_list;
+
+// A listener as stored by register/unregister.
+typedef struct event_subscription {
+    void* listener;
+    PFN_on_event callback;
+    i32 order;
+    // Registration sequence number, so listeners with the same order keep registration order.
+    u32 sequence;
+    // The handle slot pointing at this subscription, fixed up when it is moved.
+    u32 handle_index;
+} event_subscription;
+
 typedef struct event_code_entry {
-    registered_event* events;
+    // The published snapshot, read by dispatch.
+    event_listener_list* volatile listeners;
+    // The subscriptions, in no particular order. darray, guarded by writer_mutex.
+    event_subscription* subscriptions;
+    // Set when subscriptions have changed since the snapshot was built.
+    volatile b8 dirty;
+    // How queued events of this code are coalesced. An event_coalesce_policy.
+    volatile u8 coalesce;
+    PFN_event_accumulate accumulate;
 } event_code_entry;
 
-// This should be more than enough codes...
-#define MAX_MESSAGE_CODES 16384
+// A user event code's entry. Empty while code is 0, as user codes start at 256.
+typedef struct event_code_slot {
+    volatile u16 code;
+    event_code_entry entry;
+} event_code_slot;
+
+/**
+ * Open-addressed hashtable of user event codes. Slots are only ever claimed, never
+ * cleared, so readers can probe it without locking. It is rebuilt, dropping codes
+ * with no subscriptions or coalescing policy, when it grows.
+ */
+typedef struct event_code_table {
+    // Always a power of 2.
+    u32 capacity;
+    u32 count;
+    event_code_slot slots[];
+} event_code_table;
+
+// Maps an event_handle to its subscription.
+typedef struct event_handle_slot {
+    u16 code;
+    // Index into the code's subscriptions while in use; the next free slot otherwise.
+    u32 index;
+    // Bumped on every unregister, so stale handles are rejected.
+    u32 generation;
+} event_handle_slot;
+
+// A block retired by a writer, to be freed once no reader can be using it.
+typedef struct retired_block {
+    void* block;
+    u64 size;
+} retired_block;
+
+typedef struct queued_event {
+    u16 code;
+    void* sender;
+    event_context context;
+} queued_event;
+
+// A coalesced code's events within one dispatch.
+typedef struct coalesced_event {
+    u16 code;
+    // Only the event at this position is delivered.
+    u64 last_position;
+    event_coalesce_policy policy;
+    PFN_event_accumulate accumulate;
+    event_context total;
+} coalesced_event;
+
+// A slot in the posted event queue. The sequence tells producers and the consumer
+// whose turn it is to use the slot.
+typedef struct queued_event_slot {
+    volatile u64 sequence;
+    queued_event event;
+} queued_event_slot;
+
+// System codes, which are looked up directly.
+#define EVENT_SYSTEM_CODE_COUNT (MAX_EVENT_CODE + 1)
+
+#define EVENT_CODE_TABLE_INITIAL_CAPACITY 16
+
+#define EVENT_HANDLE_FREE_LIST_END 0xFFFFFFFF
+
+// The maximum number of events which may be posted between dispatches. Must be a power of 2.
+#define EVENT_QUEUE_CAPACITY 1024
+
+// The most distinct coalesced codes tracked per dispatch. Beyond this, events are delivered as-is.
+#define EVENT_MAX_COALESCED_CODES 32
+
+// The payload memory available to events posted between dispatches, per arena.
+#define EVENT_PAYLOAD_ARENA_SIZE (32 * 1024)
+#define EVENT_PAYLOAD_ALIGNMENT 16
+
+/**
+ * Bump allocator for posted payloads. There are two, alternating each dispatch: one takes
+ * new payloads while the other holds those being dispatched.
+ */
+typedef struct event_payload_arena {
+    u8* memory;
+    volatile u64 offset;
+    // The number of posts currently allocating from or writing to the arena.
+    volatile u32 writers;
+} event_payload_arena;
+
+// Recorded statistics for a code, with those of its listener callbacks.
+typedef struct event_code_stats_entry {
+    event_code_stats stats;
+    // darray
+    event_listener_stats* listeners;
+} event_code_stats_entry;
+
+// Marks a code without recorded statistics in the stats index.
+#define EVENT_STATS_INDEX_NONE 0xFFFF
+// The size of the stats index, with one entry per possible code.
+#define EVENT_STATS_INDEX_SIZE (sizeof(u16) * 65536)
 
 // State structure.
 typedef struct event_system_state {
-    // Lookup table for event codes.
-    event_code_entry registered[MAX_MESSAGE_CODES];
+    // Entries for the system codes, indexed by code.
+    event_code_entry system_codes[EVENT_SYSTEM_CODE_COUNT];
+    // Entries for user codes. Created on first use.
+    event_code_table* volatile user_codes;
+
+    // Serializes registration and snapshot rebuilds. Dispatch only takes it to
+    // rebuild a snapshot after the listeners of a code have changed.
+    kmutex writer_mutex;
+    // Handle slots. darray, guarded by writer_mutex.
+    event_handle_slot* handles;
+    u32 free_handle;
+    u32 next_sequence;
+    // The number of threads currently reading listeners.
+    volatile i32 active_readers;
+    // Listener lists and code tables replaced while they may still be being read.
+    // Freed once no reader is active. darray, guarded by writer_mutex.
+    retired_block* retired;
+
+    // Posted events. Any thread may post; only the dispatching thread consumes.
+    queued_event_slot queue[EVENT_QUEUE_CAPACITY];
+    // The next position to be claimed by a producer.
+    volatile u64 queue_tail;
+    // The next position to be dispatched.
+    u64 queue_head;
+
+    event_payload_arena payload_arenas[2];
+    // The arena new payloads are allocated from.
+    volatile u32 payload_arena_index;
+
+    volatile b8 instrumentation_enabled;
+    // Guards the statistics below, which may be recorded from any firing thread.
+    kmutex stats_mutex;
+    // Index into stats for each code, or EVENT_STATS_INDEX_NONE. Created on first enable.
+    u16* stats_index;
+    // darray
+    event_code_stats_entry* stats;
 } event_system_state;
 
 /**
@@ -26,51 +192,444 @@ typedef struct event_system_state {
  */
 static event_system_state* state_ptr;
 
+static u64 event_listener_list_size(u32 count) {
+    return sizeof(event_listener_list) + sizeof(registered_event) * count;
+}
+
+static u64 event_code_table_size(u32 capacity) {
+    return sizeof(event_code_table) + sizeof(event_code_slot) * capacity;
+}
+
+static u32 event_code_hash(u16 code, u32 capacity) {
+    // Fibonacci hashing spreads consecutive codes across the table.
+    return (u32)((code * 2654435769u) >> 16) & (capacity - 1);
+}
+
+static void event_retire(void* block, u64 size) {
+    retired_block retired;
+    retired.block = block;
+    retired.size = size;
+    darray_push(state_ptr->retired, retired);
+}
+
+/**
+ * @brief Frees retired blocks if nobody can still be reading them.
+ * Must be called with the writer mutex held.
+ */
+static void event_reclaim_retired() {
+    u64 retired_count = darray_length(state_ptr->retired);
+    if (retired_count == 0) {
+        return;
+    }
+
+    // NOTE: Blocks are unpublished before being retired, so any reader arriving after
+    // this check sees the replacement and never the retired block.
+    if (__atomic_load_n(&state_ptr->active_readers, __ATOMIC_SEQ_CST) != 0) {
+        return;
+    }
+
+    for (u64 i = 0; i < retired_count; ++i) {
+        kfree(state_ptr->retired[i].block, state_ptr->retired[i].size, MEMORY_TAG_EVENT);
+    }
+    _darray_clear(state_ptr->retired);
+}
+
+/**
+ * @brief Obtains the entry of a code without locking. Callers must be counted in
+ * active_readers, and may only read the published listeners and dirty flag.
+ */
+static event_code_entry* event_entry_get(u16 code) {
+    if (code < EVENT_SYSTEM_CODE_COUNT) {
+        return &state_ptr->system_codes[code];
+    }
+
+    event_code_table* table = __atomic_load_n(&state_ptr->user_codes, __ATOMIC_SEQ_CST);
+    if (!table) {
+        return 0;
+    }
+    for (u32 i = event_code_hash(code, table->capacity);; i = (i + 1) & (table->capacity - 1)) {
+        u16 slot_code = __atomic_load_n(&table->slots[i].code, __ATOMIC_ACQUIRE);
+        if (slot_code == code) {
+            return &table->slots[i].entry;
+        }
+        if (slot_code == 0) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Claims the slot for a code in the given table, which must have room.
+ */
+static event_code_slot* event_code_table_claim(event_code_table* table, u16 code) {
+    u32 i = event_code_hash(code, table->capacity);
+    while (table->slots[i].code != 0 && table->slots[i].code != code) {
+        i = (i + 1) & (table->capacity - 1);
+    }
+    event_code_slot* slot = &table->slots[i];
+    if (slot->code == 0) {
+        kzero_memory(&slot->entry, sizeof(event_code_entry));
+        // Published last, so a reader matching the code sees an initialized slot.
+        __atomic_store_n(&slot->code, code, __ATOMIC_RELEASE);
+        table->count++;
+    }
+    return slot;
+}
+
+static b8 event_entry_is_live(const event_code_entry* entry) {
+    return (entry->subscriptions && darray_length(entry->subscriptions) > 0) || entry->coalesce != EVENT_COALESCE_NONE;
+}
+
+/**
+ * @brief Obtains the entry of a code for writing, creating it for user codes if need be.
+ * Must be called with the writer mutex held.
+ * @returns A pointer to the entry, or 0 if it doesn't exist and create is false.
+ */
+static event_code_entry* event_entry_get_for_write(u16 code, b8 create) {
+    if (code < EVENT_SYSTEM_CODE_COUNT) {
+        return &state_ptr->system_codes[code];
+    }
+
+    event_code_table* table = state_ptr->user_codes;
+    if (table) {
+        for (u32 i = event_code_hash(code, table->capacity); table->slots[i].code != 0; i = (i + 1) & (table->capacity - 1)) {
+            if (table->slots[i].code == code) {
+                return &table->slots[i].entry;
+            }
+        }
+    }
+    if (!create) {
+        return 0;
+    }
+
+    // Keep the load at or under half so probes stay short.
+    if (!table || (table->count + 1) * 2 > table->capacity) {
+        u32 live_count = 0;
+        if (table) {
+            for (u32 i = 0; i < table->capacity; ++i) {
+                live_count += event_entry_is_live(&table->slots[i].entry);
+            }
+        }
+        u32 capacity = EVENT_CODE_TABLE_INITIAL_CAPACITY;
+        while ((live_count + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+
+        // Rebuild with only the codes that are still in use.
+        event_code_table* new_table = kallocate(event_code_table_size(capacity), MEMORY_TAG_EVENT);
+        new_table->capacity = capacity;
+        if (table) {
+            for (u32 i = 0; i < table->capacity; ++i) {
+                event_code_entry* entry = &table->slots[i].entry;
+                if (event_entry_is_live(entry)) {
+                    event_code_table_claim(new_table, table->slots[i].code)->entry = *entry;
+                } else {
+                    if (entry->subscriptions) {
+                        darray_destroy(entry->subscriptions);
+                    }
+                    if (entry->listeners) {
+                        event_retire(entry->listeners, event_listener_list_size(entry->listeners->count));
+                    }
+                }
+            }
+        }
+        __atomic_store_n(&state_ptr->user_codes, new_table, __ATOMIC_SEQ_CST);
+        if (table) {
+            event_retire(table, event_code_table_size(table->capacity));
+        }
+        table = new_table;
+    }
+
+    return &event_code_table_claim(table, code)->entry;
+}
+
+static int event_subscription_compare(const void* a, const void* b) {
+    const event_subscription* left = a;
+    const event_subscription* right = b;
+    if (left->order != right->order) {
+        return left->order < right->order ? -1 : 1;
+    }
+    return left->sequence < right->sequence ? -1 : (left->sequence > right->sequence ? 1 : 0);
+}
+
+/**
+ * @brief Rebuilds and publishes the dispatch snapshot of an entry from its subscriptions,
+ * sorted by order key then registration. Must be called with the writer mutex held.
+ */
+static void event_entry_rebuild(event_code_entry* entry) {
+    u32 count = entry->subscriptions ? (u32)darray_length(entry->subscriptions) : 0;
+    event_listener_list* list = 0;
+    if (count > 0) {
+        // Sorted in place; the subscriptions' own order doesn't matter, only their handles.
+        qsort(entry->subscriptions, count, sizeof(event_subscription), event_subscription_compare);
+        list = kallocate(event_listener_list_size(count), MEMORY_TAG_EVENT);
+        list->count = count;
+        for (u32 i = 0; i < count; ++i) {
+            event_subscription* subscription = &entry->subscriptions[i];
+            state_ptr->handles[subscription->handle_index].index = i;
+            list->events[i].listener = subscription->listener;
+            list->events[i].callback = subscription->callback;
+        }
+    }
+
+    event_listener_list* old = entry->listeners;
+    __atomic_store_n(&entry->listeners, list, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&entry->dirty, false, __ATOMIC_RELEASE);
+    if (old) {
+        event_retire(old, event_listener_list_size(old->count));
+    }
+    event_reclaim_retired();
+}
+
+/**
+ * @brief Removes the subscription behind a handle slot by swapping the last subscription
+ * into its place. Must be called with the writer mutex held.
+ */
+static void event_remove_subscription(u32 handle_index) {
+    event_handle_slot* handle = &state_ptr->handles[handle_index];
+    event_code_entry* entry = event_entry_get_for_write(handle->code, false);
+
+    u32 last = (u32)darray_length(entry->subscriptions) - 1;
+    if (handle->index != last) {
+        entry->subscriptions[handle->index] = entry->subscriptions[last];
+        state_ptr->handles[entry->subscriptions[handle->index].handle_index].index = handle->index;
+    }
+    _darray_field_set(entry->subscriptions, DARRAY_LENGTH, last);
+    __atomic_store_n(&entry->dirty, true, __ATOMIC_RELEASE);
+
+    // Invalidate the handle and put the slot on the free list.
+    handle->generation++;
+    handle->index = state_ptr->free_handle;
+    state_ptr->free_handle = handle_index;
+}
+
+/**
+ * @brief Obtains the recorded statistics of a code, creating them if need be.
+ * Must be called with the stats mutex held.
+ */
+static event_code_stats_entry* event_stats_get(u16 code) {
+    u16 index = state_ptr->stats_index[code];
+    if (index == EVENT_STATS_INDEX_NONE) {
+        event_code_stats_entry new_entry = {0};
+        new_entry.stats.code = code;
+        new_entry.listeners = darray_create(event_listener_stats);
+        darray_push(state_ptr->stats, new_entry);
+        index = (u16)(darray_length(state_ptr->stats) - 1);
+        state_ptr->stats_index[code] = index;
+    }
+    return &state_ptr->stats[index];
+}
+
+static void event_stats_record_listener(u16 code, PFN_on_event callback, f64 elapsed, b8 handled) {
+    kmutex_lock(&state_ptr->stats_mutex);
+    event_code_stats_entry* entry = event_stats_get(code);
+
+    event_listener_stats* listener = 0;
+    u32 count = (u32)darray_length(entry->listeners);
+    for (u32 i = 0; i < count; ++i) {
+        if (entry->listeners[i].callback == callback) {
+            listener = &entry->listeners[i];
+            break;
+        }
+    }
+    if (!listener) {
+        event_listener_stats new_listener = {0};
+        new_listener.callback = callback;
+        darray_push(entry->listeners, new_listener);
+        listener = &entry->listeners[count];
+        entry->stats.listener_stats_count = count + 1;
+    }
+
+    listener->call_count++;
+    listener->total_time += elapsed;
+    if (elapsed > listener->max_time) {
+        listener->max_time = elapsed;
+    }
+    if (handled) {
+        listener->handled_count++;
+        entry->stats.last_handled_by = callback;
+    }
+    kmutex_unlock(&state_ptr->stats_mutex);
+}
+
+static void event_stats_record_fire(u16 code, u32 listener_count, f64 elapsed, b8 handled) {
+    kmutex_lock(&state_ptr->stats_mutex);
+    event_code_stats* stats = &event_stats_get(code)->stats;
+    stats->fire_count++;
+    stats->handled_count += handled;
+    stats->listener_count = listener_count;
+    if (listener_count > stats->max_listener_count) {
+        stats->max_listener_count = listener_count;
+    }
+    stats->total_time += elapsed;
+    if (elapsed > stats->max_time) {
+        stats->max_time = elapsed;
+    }
+    kmutex_unlock(&state_ptr->stats_mutex);
+}
+
+/**
+ * @brief Frees all recorded statistics. Must be called with the stats mutex held.
+ */
+static void event_stats_clear() {
+    u64 count = darray_length(state_ptr->stats);
+    for (u64 i = 0; i < count; ++i) {
+        state_ptr->stats_index[state_ptr->stats[i].stats.code] = EVENT_STATS_INDEX_NONE;
+        darray_destroy(state_ptr->stats[i].listeners);
+    }
+    _darray_clear(state_ptr->stats);
+}
+
 void event_system_initialize(u64* memory_requirement, void* state) {
-    *memory_requirement = sizeof(event_system_state);
+    *memory_requirement = sizeof(event_system_state) + EVENT_PAYLOAD_ARENA_SIZE * 2;
     if (state == 0) {
         return;
     }
-    kzero_memory(state, sizeof(state));
+    kzero_memory(state, *memory_requirement);
     state_ptr = state;
+
+    // The payload arenas follow the state.
+    u8* arena_memory = (u8*)state + sizeof(event_system_state);
+    state_ptr->payload_arenas[0].memory = arena_memory;
+    state_ptr->payload_arenas[1].memory = arena_memory + EVENT_PAYLOAD_ARENA_SIZE;
+
+    if (!kmutex_create(&state_ptr->writer_mutex)) {
+        KERROR("Failed to create event system mutex.");
+    }
+    if (!kmutex_create(&state_ptr->stats_mutex)) {
+        KERROR("Failed to create event system stats mutex.");
+    }
+    state_ptr->stats = darray_create(event_code_stats_entry);
+    state_ptr->retired = darray_create(retired_block);
+    state_ptr->handles = darray_create(event_handle_slot);
+    state_ptr->free_handle = EVENT_HANDLE_FREE_LIST_END;
+    for (u64 i = 0; i < EVENT_QUEUE_CAPACITY; ++i) {
+        state_ptr->queue[i].sequence = i;
+    }
+}
+
+static void event_entry_destroy(event_code_entry* entry) {
+    if (entry->subscriptions) {
+        darray_destroy(entry->subscriptions);
+    }
+    if (entry->listeners) {
+        event_retire(entry->listeners, event_listener_list_size(entry->listeners->count));
+    }
 }
 
 void event_system_shutdown(void* state) {
     if (state_ptr) {
-        // Free the events arrays. And objects pointed to should be destroyed on their own.
-        for (u16 i = 0; i < MAX_MESSAGE_CODES; ++i) {
-            if (state_ptr->registered[i].events != 0) {
-                darray_destroy(state_ptr->registered[i].events);
-                state_ptr->registered[i].events = 0;
+        // Free the listener lists. And objects pointed to should be destroyed on their own.
+        for (u32 i = 0; i < EVENT_SYSTEM_CODE_COUNT; ++i) {
+            event_entry_destroy(&state_ptr->system_codes[i]);
+        }
+        event_code_table* table = state_ptr->user_codes;
+        if (table) {
+            for (u32 i = 0; i < table->capacity; ++i) {
+                if (table->slots[i].code != 0) {
+                    event_entry_destroy(&table->slots[i].entry);
+                }
             }
+            event_retire(table, event_code_table_size(table->capacity));
+        }
+
+        u64 retired_count = darray_length(state_ptr->retired);
+        for (u64 i = 0; i < retired_count; ++i) {
+            kfree(state_ptr->retired[i].block, state_ptr->retired[i].size, MEMORY_TAG_EVENT);
+        }
+        darray_destroy(state_ptr->retired);
+        darray_destroy(state_ptr->handles);
+
+        if (state_ptr->stats_index) {
+            event_stats_clear();
+            kfree(state_ptr->stats_index, EVENT_STATS_INDEX_SIZE, MEMORY_TAG_EVENT);
         }
+        darray_destroy(state_ptr->stats);
+
+        kmutex_destroy(&state_ptr->stats_mutex);
+        kmutex_destroy(&state_ptr->writer_mutex);
     }
     state_ptr = 0;
 }
 
-b8 event_register(u16 code, void* listener, PFN_on_event on_event) {
-    if (!state_ptr) {
-        return false;
+event_handle event_register(u16 code, void* listener, PFN_on_event on_event) {
+    return event_register_ordered(code, listener, on_event, 0);
+}
+
+event_handle event_register_ordered(u16 code, void* listener, PFN_on_event on_event, i32 order) {
+    if (!state_ptr || !on_event) {
+        return INVALID_EVENT_HANDLE;
     }
 
-    if (state_ptr->registered[code].events == 0) {
-        state_ptr->registered[code].events = darray_create(registered_event);
+    kmutex_lock(&state_ptr->writer_mutex);
+
+    event_code_entry* entry = event_entry_get_for_write(code, true);
+    if (!entry->subscriptions) {
+        entry->subscriptions = darray_create(event_subscription);
     }
 
-    u64 registered_count = darray_length(state_ptr->registered[code].events);
-    for (u64 i = 0; i < registered_count; ++i) {
-        if (state_ptr->registered[code].events[i].listener == listener) {
-            // TODO: warn
-            return false;
-        }
+    // Take a handle slot, reusing a free one where possible.
+    u32 handle_index = state_ptr->free_handle;
+    if (handle_index != EVENT_HANDLE_FREE_LIST_END) {
+        state_ptr->free_handle = state_ptr->handles[handle_index].index;
+    } else {
+        event_handle_slot new_slot = {0};
+        darray_push(state_ptr->handles, new_slot);
+        handle_index = (u32)darray_length(state_ptr->handles) - 1;
     }
+    event_handle_slot* handle = &state_ptr->handles[handle_index];
+    handle->code = code;
+    handle->index = (u32)darray_length(entry->subscriptions);
+
+    event_subscription subscription;
+    subscription.listener = listener;
+    subscription.callback = on_event;
+    subscription.order = order;
+    subscription.sequence = state_ptr->next_sequence++;
+    subscription.handle_index = handle_index;
+    darray_push(entry->subscriptions, subscription);
 
-    // If at this point, no duplicate was found. Proceed with registration.
-    registered_event event;
-    event.listener = listener;
-    event.callback = on_event;
-    darray_push(state_ptr->registered[code].events, event);
+    // The snapshot is rebuilt on the next fire, so registering many listeners at once costs one rebuild.
+    __atomic_store_n(&entry->dirty, true, __ATOMIC_RELEASE);
 
+    event_handle result = ((u64)handle->generation << 32) | (handle_index + 1);
+    kmutex_unlock(&state_ptr->writer_mutex);
+    return result;
+}
+
+b8 event_unregister_handle(event_handle handle) {
+    if (!state_ptr || handle == INVALID_EVENT_HANDLE) {
+        return false;
+    }
+
+    u32 handle_index = (u32)(handle & 0xFFFFFFFF) - 1;
+    u32 generation = (u32)(handle >> 32);
+
+    kmutex_lock(&state_ptr->writer_mutex);
+    b8 valid = handle_index < darray_length(state_ptr->handles) && state_ptr->handles[handle_index].generation == generation;
+    if (valid) {
+        event_remove_subscription(handle_index);
+    }
+    kmutex_unlock(&state_ptr->writer_mutex);
+    return valid;
+}
+
+b8 event_set_coalescing(u16 code, event_coalesce_policy policy, PFN_event_accumulate accumulate) {
+    if (!state_ptr) {
+        return false;
+    }
+    if (policy == EVENT_COALESCE_ACCUMULATE && !accumulate) {
+        KERROR("event_set_coalescing - Accumulating events of code %u requires an accumulate function.", code);
+        return false;
+    }
+
+    kmutex_lock(&state_ptr->writer_mutex);
+    event_code_entry* entry = event_entry_get_for_write(code, policy != EVENT_COALESCE_NONE);
+    if (entry) {
+        entry->accumulate = accumulate;
+        __atomic_store_n(&entry->coalesce, (u8)policy, __ATOMIC_RELEASE);
+    }
+    kmutex_unlock(&state_ptr->writer_mutex);
     return true;
 }
 
@@ -79,46 +638,364 @@ b8 event_unregister(u16 code, void* listener, PFN_on_event on_event) {
         return false;
     }
 
+    kmutex_lock(&state_ptr->writer_mutex);
+
     // On nothing is registered for the code, boot out.
-    if (state_ptr->registered[code].events == 0) {
+    event_code_entry* entry = event_entry_get_for_write(code, false);
+    if (!entry || !entry->subscriptions) {
         // TODO: warn
+        kmutex_unlock(&state_ptr->writer_mutex);
         return false;
     }
 
-    u64 registered_count = darray_length(state_ptr->registered[code].events);
-    for (u64 i = 0; i < registered_count; ++i) {
-        registered_event e = state_ptr->registered[code].events[i];
-        if (e.listener == listener && e.callback == on_event) {
-            // Found one, remove it
-            registered_event popped_event;
-            darray_pop_at(state_ptr->registered[code].events, i, &popped_event);
+    u32 count = (u32)darray_length(entry->subscriptions);
+    for (u32 i = 0; i < count; ++i) {
+        event_subscription* subscription = &entry->subscriptions[i];
+        if (subscription->listener == listener && subscription->callback == on_event) {
+            // Found one, remove it.
+            event_remove_subscription(subscription->handle_index);
+            kmutex_unlock(&state_ptr->writer_mutex);
             return true;
         }
     }
 
     // Not found.
+    kmutex_unlock(&state_ptr->writer_mutex);
     return false;
 }
 
 b8 event_fire(u16 code, void* sender, event_context context) {
+    KPROFILE_SCOPE("event_fire");
     if (!state_ptr) {
         return false;
     }
 
-    // If nothing is registered for the code, boot out.
-    if (state_ptr->registered[code].events == 0) {
+    // Announce the read before loading the list, so it can't be reclaimed underneath us.
+    __atomic_add_fetch(&state_ptr->active_readers, 1, __ATOMIC_SEQ_CST);
+
+    b8 handled = false;
+    event_code_entry* entry = event_entry_get(code);
+    if (entry && __atomic_load_n(&entry->dirty, __ATOMIC_ACQUIRE)) {
+        // Listeners have changed since the last fire. Bring the snapshot up to date, after
+        // stepping out of the reader count so the rebuild can reclaim what it replaces.
+        __atomic_sub_fetch(&state_ptr->active_readers, 1, __ATOMIC_SEQ_CST);
+        kmutex_lock(&state_ptr->writer_mutex);
+        entry = event_entry_get_for_write(code, false);
+        if (entry && entry->dirty) {
+            event_entry_rebuild(entry);
+        }
+        __atomic_add_fetch(&state_ptr->active_readers, 1, __ATOMIC_SEQ_CST);
+        kmutex_unlock(&state_ptr->writer_mutex);
+        entry = event_entry_get(code);
+    }
+
+    b8 instrumented = __atomic_load_n(&state_ptr->instrumentation_enabled, __ATOMIC_RELAXED);
+    f64 fire_start = instrumented ? platform_get_absolute_time() : 0;
+
+    event_listener_list* list = entry ? __atomic_load_n(&entry->listeners, __ATOMIC_SEQ_CST) : 0;
+    if (list) {
+        for (u32 i = 0; i < list->count; ++i) {
+            registered_event e = list->events[i];
+            f64 start = instrumented ? platform_get_absolute_time() : 0;
+            b8 result = e.callback(code, sender, e.listener, context);
+            if (instrumented) {
+                event_stats_record_listener(code, e.callback, platform_get_absolute_time() - start, result);
+            }
+            if (result) {
+                // Message has been handled, do not send to other listeners.
+                handled = true;
+                break;
+            }
+        }
+    }
+
+    if (instrumented) {
+        event_stats_record_fire(code, list ? list->count : 0, platform_get_absolute_time() - fire_start, handled);
+    }
+
+    __atomic_sub_fetch(&state_ptr->active_readers, 1, __ATOMIC_SEQ_CST);
+    return handled;
+}
+
+b8 event_post(u16 code, void* sender, event_context context) {
+    if (!state_ptr) {
         return false;
     }
 
-    u64 registered_count = darray_length(state_ptr->registered[code].events);
-    for (u64 i = 0; i < registered_count; ++i) {
-        registered_event e = state_ptr->registered[code].events[i];
-        if (e.callback(code, sender, e.listener, context)) {
-            // Message has been handled, do not send to other listeners.
-            return true;
+    // Claim a slot. A slot is free for position p once its sequence has come round to p.
+    u64 position = __atomic_load_n(&state_ptr->queue_tail, __ATOMIC_RELAXED);
+    queued_event_slot* slot;
+    for (;;) {
+        slot = &state_ptr->queue[position & (EVENT_QUEUE_CAPACITY - 1)];
+        u64 sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == position) {
+            if (__atomic_compare_exchange_n(&state_ptr->queue_tail, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // Lost the race; position now holds the current tail.
+        } else if (sequence < position) {
+            // The slot from the previous lap hasn't been dispatched yet, so the queue is full.
+            KWARN_CAT(LOG_CATEGORY_EVENTS, "event_post - Event queue is full, dropping event code %u.", code);
+            return false;
+        } else {
+            position = __atomic_load_n(&state_ptr->queue_tail, __ATOMIC_RELAXED);
         }
     }
 
-    // Not found.
-    return false;
-}
\ No newline at end of file
+    slot->event.code = code;
+    slot->event.sender = sender;
+    slot->event.context = context;
+    // Hand the slot to the consumer.
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+b8 event_post_payload(u16 code, void* sender, const void* payload, u64 size) {
+    if (!state_ptr || (size > 0 && !payload)) {
+        return false;
+    }
+
+    // Join the current arena. If a dispatch swaps arenas in the meantime, try again, so
+    // the dispatch knows every writer it has to wait for.
+    event_payload_arena* arena;
+    for (;;) {
+        u32 index = __atomic_load_n(&state_ptr->payload_arena_index, __ATOMIC_SEQ_CST);
+        arena = &state_ptr->payload_arenas[index];
+        __atomic_add_fetch(&arena->writers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&state_ptr->payload_arena_index, __ATOMIC_SEQ_CST) == index) {
+            break;
+        }
+        __atomic_sub_fetch(&arena->writers, 1, __ATOMIC_SEQ_CST);
+    }
+
+    u64 aligned_size = (size + EVENT_PAYLOAD_ALIGNMENT - 1) & ~((u64)EVENT_PAYLOAD_ALIGNMENT - 1);
+    u64 offset = __atomic_fetch_add(&arena->offset, aligned_size, __ATOMIC_RELAXED);
+    b8 result = false;
+    if (offset + aligned_size <= EVENT_PAYLOAD_ARENA_SIZE) {
+        kcopy_memory(arena->memory + offset, payload, size);
+
+        event_context context;
+        context.data.payload.data = arena->memory + offset;
+        context.data.payload.size = size;
+        result = event_post(code, sender, context);
+    } else {
+        KWARN_CAT(LOG_CATEGORY_EVENTS, "event_post_payload - Payload memory is used up for this frame, dropping event code %u (%llu bytes).", code, size);
+    }
+
+    __atomic_sub_fetch(&arena->writers, 1, __ATOMIC_SEQ_CST);
+    return result;
+}
+
+u32 event_dispatch_queued() {
+    if (!state_ptr) {
+        return 0;
+    }
+
+    // Send new payloads to the other arena, and wait for posts still writing to this one.
+    // After that, every payload event in this arena is in the queue ahead of end.
+    u32 arena_index = __atomic_load_n(&state_ptr->payload_arena_index, __ATOMIC_SEQ_CST);
+    event_payload_arena* arena = &state_ptr->payload_arenas[arena_index];
+    __atomic_store_n(&state_ptr->payload_arena_index, arena_index ^ 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&arena->writers, __ATOMIC_SEQ_CST) > 0) {
+        kthread_yield();
+    }
+
+    // Only what was posted before now, so events posted by a listener wait for the next dispatch.
+    u64 end = __atomic_load_n(&state_ptr->queue_tail, __ATOMIC_ACQUIRE);
+
+    // First pass: wait for every slot in the batch to be written, and work out which events
+    // of coalesced codes survive. Slots aren't released until delivered, so nothing can
+    // overwrite them in between.
+    coalesced_event coalesced[EVENT_MAX_COALESCED_CODES];
+    u32 coalesced_count = 0;
+    __atomic_add_fetch(&state_ptr->active_readers, 1, __ATOMIC_SEQ_CST);
+    for (u64 position = state_ptr->queue_head; position < end; ++position) {
+        queued_event_slot* slot = &state_ptr->queue[position & (EVENT_QUEUE_CAPACITY - 1)];
+        while (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != position + 1) {
+            // Claimed but not yet written. Producers write straight after claiming, so wait
+            // rather than leave it, and any payload it refers to, for the next dispatch.
+            kthread_yield();
+        }
+
+        event_code_entry* entry = event_entry_get(slot->event.code);
+        u8 policy = entry ? __atomic_load_n(&entry->coalesce, __ATOMIC_ACQUIRE) : EVENT_COALESCE_NONE;
+        if (policy == EVENT_COALESCE_NONE) {
+            continue;
+        }
+
+        coalesced_event* record = 0;
+        for (u32 i = 0; i < coalesced_count; ++i) {
+            if (coalesced[i].code == slot->event.code) {
+                record = &coalesced[i];
+                break;
+            }
+        }
+        if (!record) {
+            if (coalesced_count == EVENT_MAX_COALESCED_CODES) {
+                continue;
+            }
+            record = &coalesced[coalesced_count++];
+            record->code = slot->event.code;
+            record->policy = policy;
+            record->accumulate = entry->accumulate;
+            record->total = slot->event.context;
+        } else if (record->policy == EVENT_COALESCE_ACCUMULATE) {
+            record->accumulate(&record->total, slot->event.context);
+        }
+        record->last_position = position;
+    }
+    __atomic_sub_fetch(&state_ptr->active_readers, 1, __ATOMIC_SEQ_CST);
+
+    // Second pass: deliver. A coalesced code's events are delivered once, in place of the last one.
+    u32 count = 0;
+    while (state_ptr->queue_head < end) {
+        u64 position = state_ptr->queue_head;
+        queued_event_slot* slot = &state_ptr->queue[position & (EVENT_QUEUE_CAPACITY - 1)];
+        queued_event event = slot->event;
+        // Free the slot for the producer one lap ahead.
+        __atomic_store_n(&slot->sequence, position + EVENT_QUEUE_CAPACITY, __ATOMIC_RELEASE);
+        state_ptr->queue_head = position + 1;
+
+        b8 deliver = true;
+        for (u32 i = 0; i < coalesced_count; ++i) {
+            if (coalesced[i].code == event.code) {
+                deliver = coalesced[i].last_position == position;
+                if (deliver && coalesced[i].policy == EVENT_COALESCE_ACCUMULATE) {
+                    event.context = coalesced[i].total;
+                }
+                break;
+            }
+        }
+
+        if (deliver) {
+            event_fire(event.code, event.sender, event.context);
+            count++;
+        }
+    }
+
+    // Everything with a payload in this arena has now been delivered.
+    __atomic_store_n(&arena->offset, 0, __ATOMIC_RELEASE);
+
+    // A quiet point for the dispatching thread; free any listener lists left over from
+    // registrations made while events were in flight.
+    kmutex_lock(&state_ptr->writer_mutex);
+    event_reclaim_retired();
+    kmutex_unlock(&state_ptr->writer_mutex);
+
+    return count;
+}
+
+void event_instrumentation_enable(b8 enabled) {
+    if (!state_ptr) {
+        return;
+    }
+
+    kmutex_lock(&state_ptr->stats_mutex);
+    if (enabled && !state_ptr->stats_index) {
+        // One entry per possible code, so recording never has to search.
+        state_ptr->stats_index = kallocate(EVENT_STATS_INDEX_SIZE, MEMORY_TAG_EVENT);
+        kset_memory(state_ptr->stats_index, 0xFF, EVENT_STATS_INDEX_SIZE);
+    }
+    __atomic_store_n(&state_ptr->instrumentation_enabled, enabled, __ATOMIC_RELAXED);
+    kmutex_unlock(&state_ptr->stats_mutex);
+}
+
+b8 event_instrumentation_enabled() {
+    return state_ptr && __atomic_load_n(&state_ptr->instrumentation_enabled, __ATOMIC_RELAXED);
+}
+
+b8 event_get_code_stats(u16 code, event_code_stats* out_stats) {
+    if (!state_ptr || !out_stats) {
+        return false;
+    }
+
+    b8 found = false;
+    kmutex_lock(&state_ptr->stats_mutex);
+    if (state_ptr->stats_index && state_ptr->stats_index[code] != EVENT_STATS_INDEX_NONE) {
+        *out_stats = state_ptr->stats[state_ptr->stats_index[code]].stats;
+        found = true;
+    }
+    kmutex_unlock(&state_ptr->stats_mutex);
+    return found;
+}
+
+u32 event_get_listener_stats(u16 code, u32 max_count, event_listener_stats* out_stats) {
+    if (!state_ptr) {
+        return 0;
+    }
+
+    u32 count = 0;
+    kmutex_lock(&state_ptr->stats_mutex);
+    if (state_ptr->stats_index && state_ptr->stats_index[code] != EVENT_STATS_INDEX_NONE) {
+        event_code_stats_entry* entry = &state_ptr->stats[state_ptr->stats_index[code]];
+        count = (u32)darray_length(entry->listeners);
+        if (out_stats) {
+            kcopy_memory(out_stats, entry->listeners, sizeof(event_listener_stats) * (count < max_count ? count : max_count));
+        }
+    }
+    kmutex_unlock(&state_ptr->stats_mutex);
+    return count;
+}
+
+void event_reset_stats() {
+    if (!state_ptr) {
+        return;
+    }
+
+    kmutex_lock(&state_ptr->stats_mutex);
+    if (state_ptr->stats_index) {
+        event_stats_clear();
+    }
+    kmutex_unlock(&state_ptr->stats_mutex);
+}
+
+static int event_listener_stats_compare(const void* a, const void* b) {
+    const event_listener_stats* left = a;
+    const event_listener_stats* right = b;
+    // Slowest first.
+    return left->total_time > right->total_time ? -1 : (left->total_time < right->total_time ? 1 : 0);
+}
+
+b8 event_dump_stats(const char* path) {
+    if (!state_ptr) {
+        return false;
+    }
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &f)) {
+        KERROR("event_dump_stats - Unable to open '%s' for writing.", path);
+        return false;
+    }
+
+    char line[512];
+    b8 result = filesystem_write_line(&f, "code fires handled listeners max_listeners total_ms max_ms last_handled_by");
+
+    kmutex_lock(&state_ptr->stats_mutex);
+    u64 count = darray_length(state_ptr->stats);
+    for (u64 i = 0; i < count && result; ++i) {
+        event_code_stats_entry* entry = &state_ptr->stats[i];
+        event_code_stats* stats = &entry->stats;
+        string_format(line, "%u %llu %llu %u %u %.4f %.4f %p",
+                      stats->code, stats->fire_count, stats->handled_count, stats->listener_count,
+                      stats->max_listener_count, stats->total_time * 1000.0, stats->max_time * 1000.0,
+                      (void*)stats->last_handled_by);
+        result = filesystem_write_line(&f, line);
+
+        u32 listener_count = (u32)darray_length(entry->listeners);
+        qsort(entry->listeners, listener_count, sizeof(event_listener_stats), event_listener_stats_compare);
+        for (u32 j = 0; j < listener_count && result; ++j) {
+            event_listener_stats* listener = &entry->listeners[j];
+            string_format(line, "    listener %p calls %llu handled %llu total_ms %.4f max_ms %.4f",
+                          (void*)listener->callback, listener->call_count, listener->handled_count,
+                          listener->total_time * 1000.0, listener->max_time * 1000.0);
+            result = filesystem_write_line(&f, line);
+        }
+    }
+    kmutex_unlock(&state_ptr->stats_mutex);
+
+    filesystem_close(&f);
+    if (!result) {
+        KERROR("event_dump_stats - Failed writing to '%s'.", path);
+    }
+    return result;
+}
@@ -20,28 +20,83 @@ typedef struct event_context {
         u8 u8[16];
 
         char c[16];
+
+        // Events posted with event_post_payload. Valid until the dispatch delivering them finishes.
+        struct {
+            const void* data;
+            u64 size;
+        } payload;
     } data;
 } event_context;
 
 // Should return true if handled.
 typedef b8 (*PFN_on_event)(u16 code, void* sender, void* listener_inst, event_context data);
 
-void event_system_initialize();
-void event_system_shutdown();
+// Folds the data of a queued event into the running total for its code. See EVENT_COALESCE_ACCUMULATE.
+typedef void (*PFN_event_accumulate)(event_context* total, event_context next);
+
+/**
+ * How the queued events of a code are combined when dispatched. Coalesced events are
+ * delivered once per dispatch, in place of the last one queued; events fired immediately
+ * are never coalesced.
+ */
+typedef enum event_coalesce_policy {
+    // Every event is delivered.
+    EVENT_COALESCE_NONE,
+    // Only the last event is delivered, e.g. for positions or sizes.
+    EVENT_COALESCE_LAST_WINS,
+    // One event is delivered, with the data of all of them folded together by an
+    // accumulate function, e.g. for deltas.
+    EVENT_COALESCE_ACCUMULATE
+} event_coalesce_policy;
+
+void event_system_initialize(u64* memory_requirement, void* state);
+void event_system_shutdown(void* state);
+
+// Identifies a single registration, for unregistering it.
+typedef u64 event_handle;
+
+#define INVALID_EVENT_HANDLE 0
+
+/**
+ * Register to listen for when events are sent with the provided code. Each call adds a new
+ * registration, even for a listener/callback combo which is already registered. Listeners
+ * are invoked in the order they were registered. Safe to call from any thread, including
+ * from within a listener while events are being fired.
+ * @param code The event code to listen for.
+ * @param listener A pointer to a listener instance. Can be 0/NULL.
+ * @param on_event The callback function pointer to be invoked when the event code is fired.
+ * @returns A handle to the registration, or INVALID_EVENT_HANDLE on failure.
+ */
+KAPI event_handle event_register(u16 code, void* listener, PFN_on_event on_event);
 
 /**
- * Register to listen for when events are sent with the provided code. Events with duplicate
- * listener/callback combos will not be registered again and will cause this to return false.
+ * Register to listen for when events are sent with the provided code, at the given position
+ * in the dispatch order. Listeners with a lower order are invoked first; those with the same
+ * order are invoked in the order they were registered.
  * @param code The event code to listen for.
  * @param listener A pointer to a listener instance. Can be 0/NULL.
  * @param on_event The callback function pointer to be invoked when the event code is fired.
- * @returns true if the event is successfully registered; otherwise false.
+ * @param order The ordering key. event_register uses 0.
+ * @returns A handle to the registration, or INVALID_EVENT_HANDLE on failure.
  */
-KAPI b8 event_register(u16 code, void* listener, PFN_on_event on_event);
+KAPI event_handle event_register_ordered(u16 code, void* listener, PFN_on_event on_event, i32 order);
+
+/**
+ * Unregisters the registration the handle was returned for, in constant time. Safe to call
+ * from any thread. Note that an event already being fired on another thread may still reach
+ * the listener after this returns.
+ * @param handle The handle returned when registering.
+ * @returns true if the registration was removed; false if the handle is invalid or was already unregistered.
+ */
+KAPI b8 event_unregister_handle(event_handle handle);
 
 /**
  * Unregister from listening for when events are sent with the provided code. If no matching
- * registration is found, this function returns false.
+ * registration is found, this function returns false. Searches the code's listeners, so
+ * prefer event_unregister_handle where the handle is available. Safe to call from any thread,
+ * including from within a listener while events are being fired. Note that an event already
+ * being fired on another thread may still reach the listener after this returns.
  * @param code The event code to stop listening for.
  * @param listener A pointer to a listener instance. Can be 0/NULL.
  * @param on_event The callback function pointer to be unregistered.
@@ -49,6 +104,15 @@ KAPI b8 event_register(u16 code, void* listener, PFN_on_event on_event);
  */
 KAPI b8 event_unregister(u16 code, void* listener, PFN_on_event on_event);
 
+/**
+ * Sets how queued events of the given code are coalesced at dispatch.
+ * @param code The event code to set the policy for.
+ * @param policy The coalescing policy.
+ * @param accumulate The function which folds events together. Required for EVENT_COALESCE_ACCUMULATE; ignored otherwise.
+ * @returns true on success; otherwise false.
+ */
+KAPI b8 event_set_coalescing(u16 code, event_coalesce_policy policy, PFN_event_accumulate accumulate);
+
 /**
  * Fires an event to listeners of the given code. If an event handler returns 
  * true, the event is considered handled and is not passed on to any more listeners.
@@ -59,6 +123,113 @@ KAPI b8 event_unregister(u16 code, void* listener, PFN_on_event on_event);
  */
 KAPI b8 event_fire(u16 code, void* sender, event_context context);
 
+/**
+ * Posts an event to the queue, to be fired to listeners of the given code the next time
+ * queued events are dispatched rather than immediately. Events are dispatched in the order
+ * they were posted. Safe to call from any thread, and never blocks.
+ * @param code The event code to post.
+ * @param sender A pointer to the sender. Can be 0/NULL.
+ * @param data The event data.
+ * @returns true if the event was queued; otherwise false, such as when the queue is full.
+ */
+KAPI b8 event_post(u16 code, void* sender, event_context context);
+
+/**
+ * Posts an event carrying a variable-size payload. The payload is copied into memory owned
+ * by the event system, and listeners receive it in data.payload. It stays valid until the
+ * dispatch delivering the event finishes, so listeners must copy anything they want to keep.
+ * Safe to call from any thread, and never blocks.
+ * @param code The event code to post.
+ * @param sender A pointer to the sender. Can be 0/NULL.
+ * @param payload A pointer to the payload to copy.
+ * @param size The size of the payload in bytes.
+ * @returns true if the event was queued; otherwise false, such as when the payload memory
+ * for this frame is used up.
+ */
+KAPI b8 event_post_payload(u16 code, void* sender, const void* payload, u64 size);
+
+/**
+ * Fires every event posted before this call, in the order they were posted. Events posted
+ * by listeners during the dispatch are held for the next one. Events of codes with a
+ * coalescing policy are combined first (see event_set_coalescing). Listeners are invoked on the
+ * calling thread, which should always be the same one (the main thread).
+ * @returns The number of events fired, after coalescing.
+ */
+KAPI u32 event_dispatch_queued();
+
+// Timings recorded for one listener callback of an event code. Times are in seconds.
+typedef struct event_listener_stats {
+    PFN_on_event callback;
+    // The number of times the callback was invoked.
+    u64 call_count;
+    // The number of times the callback reported the event as handled.
+    u64 handled_count;
+    f64 total_time;
+    f64 max_time;
+} event_listener_stats;
+
+// Statistics recorded for an event code while instrumentation is enabled. Times are in seconds.
+typedef struct event_code_stats {
+    u16 code;
+    // The number of times the code was fired, including queued events when dispatched.
+    u64 fire_count;
+    // The number of fires which a listener handled.
+    u64 handled_count;
+    // The number of listeners registered at the last fire, and the most seen at once.
+    u32 listener_count;
+    u32 max_listener_count;
+    // Time spent in all listeners of a fire.
+    f64 total_time;
+    f64 max_time;
+    // The callback which last handled the code, if any.
+    PFN_on_event last_handled_by;
+    // The number of distinct listener callbacks with recorded stats.
+    u32 listener_stats_count;
+} event_code_stats;
+
+/**
+ * Turns event instrumentation on or off. While on, every fire records per-code and
+ * per-listener statistics; while off, it costs a single check per fire. Recorded
+ * statistics are kept when turned off. Off by default.
+ * @param enabled Indicates if instrumentation should be enabled.
+ */
+KAPI void event_instrumentation_enable(b8 enabled);
+
+/**
+ * @returns True if event instrumentation is enabled; otherwise false.
+ */
+KAPI b8 event_instrumentation_enabled();
+
+/**
+ * Obtains the statistics recorded for the given code.
+ * @param code The event code to obtain statistics for.
+ * @param out_stats A pointer to hold the statistics.
+ * @returns True if statistics have been recorded for the code; otherwise false.
+ */
+KAPI b8 event_get_code_stats(u16 code, event_code_stats* out_stats);
+
+/**
+ * Obtains the statistics recorded for each listener callback of the given code.
+ * @param code The event code to obtain listener statistics for.
+ * @param max_count The maximum number of entries to write to out_stats.
+ * @param out_stats An array of at least max_count entries to be filled. Can be 0/NULL to only obtain the count.
+ * @returns The number of listener callbacks with recorded statistics for the code.
+ */
+KAPI u32 event_get_listener_stats(u16 code, u32 max_count, event_listener_stats* out_stats);
+
+/**
+ * Clears all recorded statistics.
+ */
+KAPI void event_reset_stats();
+
+/**
+ * Writes all recorded statistics to a text file, one line per code followed by one per
+ * listener callback, slowest first.
+ * @param path The path of the file to write. Overwritten if it exists.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 event_dump_stats(const char* path);
+
 // System internal event codes. Application should use codes beyond 255.
 typedef enum system_event_code {
     // Shuts the application down on the next frame.
@@ -97,7 +268,7 @@ typedef enum system_event_code {
 
     // Mouse moved.
     /* Context usage:
-     * u8 z_delta = data.data.u8[0];
+     * i8 z_delta = data.data.i8[0];
      */
     EVENT_CODE_MOUSE_WHEEL = 0x07,
 
@@ -0,0 +1,42 @@
+#include "fixed_timestep.h"
+
+#include "core/kmemory.h"
+
+#define FIXED_TIMESTEP_DEFAULT_MAX_STEPS 5
+
+void fixed_timestep_create(f64 step_rate, u32 max_steps, fixed_timestep* out_timestep) {
+    kzero_memory(out_timestep, sizeof(fixed_timestep));
+    out_timestep->step = 1.0 / step_rate;
+    out_timestep->max_steps = max_steps ? max_steps : FIXED_TIMESTEP_DEFAULT_MAX_STEPS;
+}
+
+u32 fixed_timestep_advance(fixed_timestep* timestep, f64 delta) {
+    if (delta > 0) {
+        timestep->accumulator += delta;
+    }
+
+    u32 steps = (u32)(timestep->accumulator / timestep->step);
+    if (steps > timestep->max_steps) {
+        // Too far behind to catch up this frame. Drop the whole steps beyond the limit but keep
+        // the partial one, so the alpha carries on smoothly.
+        f64 dropped = (steps - timestep->max_steps) * timestep->step;
+        timestep->accumulator -= dropped;
+        timestep->dropped_time += dropped;
+        timestep->clamped_count++;
+        steps = timestep->max_steps;
+    }
+
+    timestep->accumulator -= steps * timestep->step;
+    if (timestep->accumulator < 0) {
+        // Only rounding error.
+        timestep->accumulator = 0;
+    }
+    timestep->step_count += steps;
+    return steps;
+}
+
+f32 fixed_timestep_alpha(const fixed_timestep* timestep) {
+    f32 alpha = (f32)(timestep->accumulator / timestep->step);
+    // Rounding can leave the accumulator a hair short of a whole step.
+    return alpha < 1.0f ? alpha : 0.99999f;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief Steps a simulation at a fixed rate, independent of the frame rate. Frame time is
+ * added to an accumulator which is spent in whole steps, with the remainder carried over to
+ * the next frame and given to rendering as an interpolation alpha between the last two steps.
+ */
+typedef struct fixed_timestep {
+    // The length of a step in seconds.
+    f64 step;
+    // The most steps taken in one frame. Time which would need more is dropped, so a slow
+    // frame can't leave the simulation further behind each frame than the last.
+    u32 max_steps;
+    // Frame time not yet spent on steps, in seconds. Always less than a step between frames.
+    f64 accumulator;
+
+    // Steps taken since creation.
+    u64 step_count;
+    // Frames which hit max_steps and dropped time.
+    u64 clamped_count;
+    // Seconds of frame time dropped by clamping.
+    f64 dropped_time;
+} fixed_timestep;
+
+/**
+ * @brief Creates a fixed timestep.
+ * @param step_rate The number of steps per second. Must be greater than 0.
+ * @param max_steps The most steps to take in one frame. 0 uses the default of 5.
+ * @param out_timestep A pointer to hold the timestep.
+ */
+KAPI void fixed_timestep_create(f64 step_rate, u32 max_steps, fixed_timestep* out_timestep);
+
+/**
+ * @brief Adds a frame's time to the accumulator and takes as many whole steps out of it as
+ * it holds, up to max_steps.
+ * @param timestep A pointer to the timestep.
+ * @param delta The time the frame took, in seconds.
+ * @returns The number of steps to run this frame, each of step seconds. May be 0.
+ */
+KAPI u32 fixed_timestep_advance(fixed_timestep* timestep, f64 delta);
+
+/**
+ * @brief Obtains how far the time left in the accumulator is through the next step, for
+ * rendering between the last two simulated states.
+ * @param timestep A pointer to the timestep.
+ * @returns The interpolation alpha, from 0 up to (but not including) 1.
+ */
+KAPI f32 fixed_timestep_alpha(const fixed_timestep* timestep);
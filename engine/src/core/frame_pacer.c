@@ -0,0 +1,75 @@
+#include "frame_pacer.h"
+
+#include "core/kmemory.h"
+#include "core/profiler.h"
+#include "math/kmath.h"
+#include "platform/platform.h"
+#include "platform/kthread.h"
+
+// Comfortably more than a sleep usually oversleeps by.
+#define FRAME_PACER_DEFAULT_SPIN_WINDOW 0.001
+
+void frame_pacer_create(f64 target_rate, f64 spin_window, frame_pacer* out_pacer) {
+    kzero_memory(out_pacer, sizeof(frame_pacer));
+    out_pacer->spin_window = spin_window > 0 ? spin_window : FRAME_PACER_DEFAULT_SPIN_WINDOW;
+    frame_pacer_set_target_rate(out_pacer, target_rate);
+}
+
+void frame_pacer_set_target_rate(frame_pacer* pacer, f64 target_rate) {
+    pacer->period = target_rate > 0 ? 1.0 / target_rate : 0;
+    // Start a new schedule.
+    pacer->next_deadline = 0;
+}
+
+void frame_pacer_wait(frame_pacer* pacer) {
+    if (pacer->period <= 0) {
+        return;
+    }
+    KPROFILE_SCOPE("frame_pacer_wait");
+
+    f64 now = platform_get_absolute_time();
+    if (pacer->next_deadline == 0) {
+        // The first frame only sets the schedule up.
+        pacer->next_deadline = now + pacer->period;
+        return;
+    }
+
+    f64 deadline = pacer->next_deadline;
+    if (now > deadline) {
+        // Missed it. Start again from now rather than rushing the next frames to catch up.
+        pacer->late_count++;
+        pacer->next_deadline = now + pacer->period;
+        return;
+    }
+
+    // Sleep through most of the wait, then spin out the rest.
+    if (deadline - now > pacer->spin_window) {
+        platform_sleep_until(deadline - pacer->spin_window);
+    }
+    while ((now = platform_get_absolute_time()) < deadline) {
+        kthread_yield();
+    }
+
+    f64 error = now - deadline;
+    pacer->wait_count++;
+    pacer->total_error += error;
+    pacer->total_error_squared += error * error;
+    if (error > pacer->max_error) {
+        pacer->max_error = error;
+    }
+
+    // Scheduled from the deadline rather than from now, so errors don't add up over time.
+    pacer->next_deadline = deadline + pacer->period;
+}
+
+void frame_pacer_get_stats(const frame_pacer* pacer, frame_pacer_stats* out_stats) {
+    kzero_memory(out_stats, sizeof(frame_pacer_stats));
+    out_stats->wait_count = pacer->wait_count;
+    out_stats->late_count = pacer->late_count;
+    out_stats->max_error = pacer->max_error;
+    if (pacer->wait_count > 0) {
+        out_stats->mean_error = pacer->total_error / pacer->wait_count;
+        f64 variance = pacer->total_error_squared / pacer->wait_count - out_stats->mean_error * out_stats->mean_error;
+        out_stats->jitter = variance > 0 ? ksqrt((f32)variance) : 0;
+    }
+}
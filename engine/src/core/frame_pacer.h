@@ -0,0 +1,64 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief Holds frames to a target rate. Each frame is given a deadline one period after the
+ * last, which the pacer sleeps towards before spinning out the final stretch, yielding as it
+ * does, to land on it precisely without keeping a core busy for the whole wait.
+ */
+typedef struct frame_pacer {
+    // The time between frames in seconds. 0 if unlimited.
+    f64 period;
+    // How much of the end of each wait is spun rather than slept, in seconds.
+    f64 spin_window;
+    // The deadline of the next frame. 0 until the first wait.
+    f64 next_deadline;
+
+    // How far past their deadlines waits ended, in seconds.
+    u64 wait_count;
+    f64 total_error;
+    f64 total_error_squared;
+    f64 max_error;
+    // Frames which weren't done until after their deadline, so weren't waited on.
+    u64 late_count;
+} frame_pacer;
+
+// The pacing error measured by a frame_pacer. All times are in seconds.
+typedef struct frame_pacer_stats {
+    u64 wait_count;
+    u64 late_count;
+    f64 mean_error;
+    // The standard deviation of the error.
+    f64 jitter;
+    f64 max_error;
+} frame_pacer_stats;
+
+/**
+ * @brief Creates a frame pacer.
+ * @param target_rate The number of frames per second to hold to. 0 doesn't limit the rate.
+ * @param spin_window How much of the end of each wait to spin for, in seconds. 0 uses the default of 1ms.
+ * @param out_pacer A pointer to hold the pacer.
+ */
+KAPI void frame_pacer_create(f64 target_rate, f64 spin_window, frame_pacer* out_pacer);
+
+/**
+ * @brief Changes the rate of a frame pacer, starting from the next frame.
+ * @param pacer A pointer to the pacer.
+ * @param target_rate The number of frames per second to hold to. 0 doesn't limit the rate.
+ */
+KAPI void frame_pacer_set_target_rate(frame_pacer* pacer, f64 target_rate);
+
+/**
+ * @brief Waits until the current frame's deadline, then sets the next. Frames finishing
+ * after their deadline aren't waited on, and the schedule starts again from them.
+ * @param pacer A pointer to the pacer.
+ */
+KAPI void frame_pacer_wait(frame_pacer* pacer);
+
+/**
+ * @brief Obtains the pacing error measured so far.
+ * @param pacer A pointer to the pacer.
+ * @param out_stats A pointer to hold the stats.
+ */
+KAPI void frame_pacer_get_stats(const frame_pacer* pacer, frame_pacer_stats* out_stats);
@@ -0,0 +1,179 @@
+#include "frame_stats.h"
+
+#include "core/logger.h"
+#include "core/kmemory.h"
+
+#include <stdlib.h>
+
+#define FRAME_STATS_DEFAULT_WINDOW_SIZE 600
+#define FRAME_STATS_DEFAULT_HITCH_THRESHOLD (1.0 / 30.0)
+
+typedef struct frame_stats_system_state {
+    frame_stats_config config;
+
+    // The timings of the frame in progress.
+    f64 current[FRAME_STAT_MAX];
+
+    // A ring of the last window_size frames for each timing. Follows the state in memory.
+    f64* samples[FRAME_STAT_MAX];
+    // Where sorted copies of the samples go to take percentiles. Follows the samples.
+    f64* sorted;
+    // The next sample to be overwritten.
+    u32 next_sample;
+    u32 sample_count;
+
+    u64 frame_count;
+    u64 hitch_count;
+    f64 worst_frame_time;
+    u64 worst_frame;
+} frame_stats_system_state;
+
+static frame_stats_system_state* state_ptr;
+
+static const char* stat_names[FRAME_STAT_MAX] = {"frame", "update", "render", "present"};
+
+static void frame_stats_resolve_config(const frame_stats_config* config, frame_stats_config* out_config) {
+    kzero_memory(out_config, sizeof(frame_stats_config));
+    if (config) {
+        *out_config = *config;
+    }
+    if (out_config->window_size == 0) {
+        out_config->window_size = FRAME_STATS_DEFAULT_WINDOW_SIZE;
+    }
+    if (out_config->hitch_threshold <= 0) {
+        out_config->hitch_threshold = FRAME_STATS_DEFAULT_HITCH_THRESHOLD;
+    }
+}
+
+b8 frame_stats_system_initialize(u64* memory_requirement, void* state, const frame_stats_config* config) {
+    frame_stats_config resolved;
+    frame_stats_resolve_config(config, &resolved);
+    // A ring per timing, plus room to sort one.
+    u64 samples_size = sizeof(f64) * resolved.window_size;
+    *memory_requirement = sizeof(frame_stats_system_state) + samples_size * (FRAME_STAT_MAX + 1);
+    if (state == 0) {
+        return true;
+    }
+
+    kzero_memory(state, *memory_requirement);
+    state_ptr = state;
+    state_ptr->config = resolved;
+    u8* block = (u8*)state + sizeof(frame_stats_system_state);
+    for (u32 i = 0; i < FRAME_STAT_MAX; ++i) {
+        state_ptr->samples[i] = (f64*)block;
+        block += samples_size;
+    }
+    state_ptr->sorted = (f64*)block;
+    return true;
+}
+
+void frame_stats_system_shutdown(void* state) {
+    if (!state_ptr) {
+        return;
+    }
+    frame_stats_log_summary();
+    state_ptr = 0;
+}
+
+void frame_stats_record(frame_stat stat, f64 seconds) {
+    if (state_ptr && stat < FRAME_STAT_MAX) {
+        state_ptr->current[stat] += seconds;
+    }
+}
+
+void frame_stats_frame_end(f64 frame_seconds) {
+    if (!state_ptr) {
+        return;
+    }
+
+    state_ptr->current[FRAME_STAT_FRAME] = frame_seconds;
+    for (u32 i = 0; i < FRAME_STAT_MAX; ++i) {
+        state_ptr->samples[i][state_ptr->next_sample] = state_ptr->current[i];
+    }
+    state_ptr->next_sample = (state_ptr->next_sample + 1) % state_ptr->config.window_size;
+    if (state_ptr->sample_count < state_ptr->config.window_size) {
+        state_ptr->sample_count++;
+    }
+
+    if (frame_seconds > state_ptr->worst_frame_time) {
+        state_ptr->worst_frame_time = frame_seconds;
+        state_ptr->worst_frame = state_ptr->frame_count;
+    }
+    if (frame_seconds > state_ptr->config.hitch_threshold) {
+        state_ptr->hitch_count++;
+        KWARN("Hitch on frame %llu: %.2fms (update %.2fms, render %.2fms, present %.2fms).",
+              state_ptr->frame_count,
+              frame_seconds * 1000.0,
+              state_ptr->current[FRAME_STAT_UPDATE] * 1000.0,
+              state_ptr->current[FRAME_STAT_RENDER] * 1000.0,
+              state_ptr->current[FRAME_STAT_PRESENT] * 1000.0);
+    }
+
+    state_ptr->frame_count++;
+    kzero_memory(state_ptr->current, sizeof(state_ptr->current));
+}
+
+static i32 frame_stats_sample_compare(const void* a, const void* b) {
+    f64 left = *(const f64*)a;
+    f64 right = *(const f64*)b;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+/**
+ * @brief Takes a percentile of sorted samples, using the nearest rank.
+ */
+static f64 frame_stats_percentile(const f64* sorted, u32 count, u32 percentile) {
+    u32 rank = (u32)(((u64)count * percentile + 99) / 100);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+b8 frame_stats_get(frame_stats_report* out_report) {
+    if (!state_ptr) {
+        return false;
+    }
+
+    kzero_memory(out_report, sizeof(frame_stats_report));
+    out_report->frame_count = state_ptr->frame_count;
+    out_report->window_count = state_ptr->sample_count;
+    out_report->hitch_count = state_ptr->hitch_count;
+    out_report->worst_frame_time = state_ptr->worst_frame_time;
+    out_report->worst_frame = state_ptr->worst_frame;
+
+    u32 count = state_ptr->sample_count;
+    if (count == 0) {
+        return true;
+    }
+    for (u32 i = 0; i < FRAME_STAT_MAX; ++i) {
+        // Order doesn't matter for the summary, so the ring can be copied as is.
+        kcopy_memory(state_ptr->sorted, state_ptr->samples[i], sizeof(f64) * count);
+        qsort(state_ptr->sorted, count, sizeof(f64), frame_stats_sample_compare);
+
+        frame_stat_summary* summary = &out_report->stats[i];
+        f64 total = 0;
+        for (u32 j = 0; j < count; ++j) {
+            total += state_ptr->sorted[j];
+        }
+        summary->mean = total / count;
+        summary->p50 = frame_stats_percentile(state_ptr->sorted, count, 50);
+        summary->p95 = frame_stats_percentile(state_ptr->sorted, count, 95);
+        summary->p99 = frame_stats_percentile(state_ptr->sorted, count, 99);
+        summary->max = state_ptr->sorted[count - 1];
+    }
+    return true;
+}
+
+void frame_stats_log_summary() {
+    frame_stats_report report;
+    if (!frame_stats_get(&report) || report.window_count == 0) {
+        return;
+    }
+
+    KINFO("Frame stats over the last %u of %llu frames; %llu hitches over %.2fms, worst frame %llu at %.2fms:",
+          report.window_count, report.frame_count, report.hitch_count, state_ptr->config.hitch_threshold * 1000.0,
+          report.worst_frame, report.worst_frame_time * 1000.0);
+    for (u32 i = 0; i < FRAME_STAT_MAX; ++i) {
+        const frame_stat_summary* summary = &report.stats[i];
+        KINFO("  %-8s mean %7.3fms  p50 %7.3fms  p95 %7.3fms  p99 %7.3fms  max %7.3fms",
+              stat_names[i], summary->mean * 1000.0, summary->p50 * 1000.0, summary->p95 * 1000.0, summary->p99 * 1000.0, summary->max * 1000.0);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "defines.h"
+
+// The timings kept for each frame.
+typedef enum frame_stat {
+    // The time the main loop spent on the frame, not counting any time given back to the OS.
+    FRAME_STAT_FRAME,
+    // The game's update.
+    FRAME_STAT_UPDATE,
+    // The game's render.
+    FRAME_STAT_RENDER,
+    // Drawing and presenting the frame.
+    FRAME_STAT_PRESENT,
+
+    FRAME_STAT_MAX
+} frame_stat;
+
+typedef struct frame_stats_config {
+    // The number of most recent frames percentiles are taken over. 0 uses the default of 600.
+    u32 window_size;
+    // Frames taking longer than this many seconds are hitches. 0 uses the default of 1/30th of a second.
+    f64 hitch_threshold;
+} frame_stats_config;
+
+// A summary of one timing over the window, in seconds.
+typedef struct frame_stat_summary {
+    f64 mean;
+    f64 p50;
+    f64 p95;
+    f64 p99;
+    f64 max;
+} frame_stat_summary;
+
+typedef struct frame_stats_report {
+    // Every frame ended since initialization.
+    u64 frame_count;
+    // The number of frames the summaries are taken over.
+    u32 window_count;
+    // Hitches since initialization.
+    u64 hitch_count;
+    // The longest frame since initialization, in seconds, and when it was.
+    f64 worst_frame_time;
+    u64 worst_frame;
+    frame_stat_summary stats[FRAME_STAT_MAX];
+} frame_stats_report;
+
+/**
+ * @brief Initializes frame stats. Call twice; once with state = 0 to get required memory size,
+ * then a second time passing allocated memory to state. The memory requirement depends on
+ * config, so the same config must be passed both times.
+ *
+ * @param memory_requirement A pointer to hold the required memory size of internal state.
+ * @param state 0 if just requesting memory requirement, otherwise allocated block of memory.
+ * @param config The configuration to use. Pass 0 to use the defaults.
+ * @returns True on success; otherwise false.
+ */
+b8 frame_stats_system_initialize(u64* memory_requirement, void* state, const frame_stats_config* config);
+
+/**
+ * @brief Shuts frame stats down, logging a summary of the run.
+ * @param state The state block of memory.
+ */
+void frame_stats_system_shutdown(void* state);
+
+/**
+ * @brief Records a timing for the current frame. Timings recorded more than once in a
+ * frame are added together.
+ * @param stat The timing to record.
+ * @param seconds The time taken, in seconds.
+ */
+KAPI void frame_stats_record(frame_stat stat, f64 seconds);
+
+/**
+ * @brief Ends the current frame, adding its timings to the window and checking it for a hitch.
+ * @param frame_seconds The time the frame took, in seconds.
+ */
+KAPI void frame_stats_frame_end(f64 frame_seconds);
+
+/**
+ * @brief Summarizes the timings of the frames in the window.
+ * @param out_report A pointer to hold the report.
+ * @returns True on success; otherwise false if frame stats aren't initialized.
+ */
+KAPI b8 frame_stats_get(frame_stats_report* out_report);
+
+/**
+ * @brief Logs a summary of the timings of the frames in the window.
+ */
+KAPI void frame_stats_log_summary();
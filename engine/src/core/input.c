@@ -2,27 +2,139 @@
 #include "core/event.h"
 #include "core/kmemory.h"
 #include "core/logger.h"
+#include "core/profiler.h"
+#include "containers/darray.h"
+#include "platform/platform.h"
+#include "platform/filesystem.h"
 
+#define KEYBOARD_STATE_WORDS 4
+
+// One bit per key, so whole-keyboard operations are a handful of word ops.
 typedef struct keyboard_state {
-    b8 keys[256];
+    u64 keys[KEYBOARD_STATE_WORDS];
 } keyboard_state;
 
 typedef struct mouse_state {
     i16 x;
     i16 y;
-    u8 buttons[BUTTON_MAX_BUTTONS];
+    // One bit per button.
+    u8 buttons;
 } mouse_state;
 
+#define KEY_WORD(key) ((key) >> 6)
+#define KEY_BIT(key) (1ull << ((key) & 63))
+
+// A binding compiled to the bits which must all be set for its action to be down.
+typedef struct input_action_binding {
+    u64 keys[KEYBOARD_STATE_WORDS];
+    u8 buttons;
+    u8 action;
+} input_action_binding;
+
+// Marks the end of a frame's input in a recording. Other records have an input_event_type.
+#define INPUT_RECORD_FRAME_END 0xFF
+
+// A single recorded input transition. Kept small, as there can be many per frame.
+typedef struct input_record {
+    // Seconds since recording started.
+    f32 time;
+    // An input_event_type, or INPUT_RECORD_FRAME_END.
+    u8 type;
+    u8 pressed;
+    // The key or button, or the wheel delta.
+    i16 code;
+    i16 x;
+    i16 y;
+} input_record;
+
+// "KINR"
+#define INPUT_RECORDING_MAGIC 0x524E494B
+#define INPUT_RECORDING_VERSION 2
+
+// Written at the start of a recording, followed by its input_records.
+typedef struct input_recording_header {
+    u32 magic;
+    u32 version;
+} input_recording_header;
+
+typedef struct input_recorder {
+    b8 active;
+    file_handle file;
+    // platform_get_ticks when recording started. Records are timed in seconds from it.
+    u64 start_ticks;
+    // Records of the current frame, written out when it ends. darray
+    input_record* pending;
+} input_recorder;
+
+typedef struct input_replayer {
+    b8 active;
+    // Set while feeding recorded input, which is let through in place of live input.
+    b8 feeding;
+    // The whole recording, as read from the file.
+    u8* data;
+    u64 data_size;
+    input_record* records;
+    u64 record_count;
+    // The next record to be fed.
+    u64 next;
+    f64 fixed_delta;
+} input_replayer;
+
 typedef struct input_state {
     keyboard_state keyboard_current;
     keyboard_state keyboard_previous;
     mouse_state mouse_current;
     mouse_state mouse_previous;
+    input_recorder recorder;
+    input_replayer replayer;
+
+    // The most recent input events, oldest overwritten first.
+    input_event events[INPUT_EVENT_BUFFER_SIZE];
+    // The total number of events ever buffered; the next is written at events_written % INPUT_EVENT_BUFFER_SIZE.
+    u64 events_written;
+    // The value of events_written when the frame started.
+    u64 frame_events_start;
+
+    input_action_binding bindings[INPUT_MAX_ACTION_BINDINGS];
+    u32 binding_count;
+    // The actions down, one bit per action, as of the current and previous states.
+    u64 actions_current;
+    u64 actions_previous;
+    // Set when actions_current needs to be evaluated again.
+    b8 actions_dirty;
 } input_state;
 
 // Internal input state pointer
 static input_state* state_ptr;
 
+// Evaluates which actions are down for the given state, one bit per action.
+static u64 input_actions_evaluate(const keyboard_state* keyboard, const mouse_state* mouse) {
+    u64 actions = 0;
+    for (u32 i = 0; i < state_ptr->binding_count; ++i) {
+        const input_action_binding* binding = &state_ptr->bindings[i];
+        u64 missing = (u64)(binding->buttons & ~mouse->buttons);
+        for (u32 w = 0; w < KEYBOARD_STATE_WORDS; ++w) {
+            missing |= binding->keys[w] & ~keyboard->keys[w];
+        }
+        actions |= (u64)(missing == 0) << binding->action;
+    }
+    return actions;
+}
+
+static u64 input_actions_current() {
+    if (state_ptr->actions_dirty) {
+        state_ptr->actions_current = input_actions_evaluate(&state_ptr->keyboard_current, &state_ptr->mouse_current);
+        state_ptr->actions_dirty = false;
+    }
+    return state_ptr->actions_current;
+}
+
+// Sums mouse wheel deltas, clamped to the range of the event's i8.
+static void input_accumulate_wheel(event_context* total, event_context next) {
+    i32 z_delta = (i32)total->data.i8[0] + (i32)next.data.i8[0];
+    total->data.i8[0] = (i8)(z_delta < -128 ? -128 : (z_delta > 127 ? 127 : z_delta));
+}
+
 void input_system_initialize(u64* memory_requirement, void* state) {
     *memory_requirement = sizeof(input_state);
     if (state == 0) {
@@ -31,68 +143,200 @@ void input_system_initialize(u64* memory_requirement, void* state) {
     kzero_memory(state, sizeof(input_state));
     state_ptr = state;
 
+    // The platform can report many moves and wheel steps per frame. Listeners only need
+    // the latest position and the total scroll.
+    event_set_coalescing(EVENT_CODE_MOUSE_MOVED, EVENT_COALESCE_LAST_WINS, 0);
+    event_set_coalescing(EVENT_CODE_MOUSE_WHEEL, EVENT_COALESCE_ACCUMULATE, input_accumulate_wheel);
+
     KINFO("Input subsystem initialized.");
 }
 
+static void input_replay_end() {
+    input_replayer* replayer = &state_ptr->replayer;
+    if (replayer->data) {
+        kfree(replayer->data, replayer->data_size, MEMORY_TAG_STRING);
+    }
+    kzero_memory(replayer, sizeof(input_replayer));
+}
+
 void input_system_shutdown(void* state) {
-    // TODO: Add shutdown routines when needed.
+    if (state_ptr) {
+        input_recording_stop();
+        input_replay_end();
+    }
     state_ptr = 0;
 }
 
+static void input_recorder_push(u64 ticks, u8 type, b8 pressed, i16 code, i16 x, i16 y) {
+    input_record record;
+    record.time = (f32)platform_ticks_to_seconds(ticks - state_ptr->recorder.start_ticks);
+    record.type = type;
+    record.pressed = pressed;
+    record.code = code;
+    record.x = x;
+    record.y = y;
+    darray_push(state_ptr->recorder.pending, record);
+}
+
+/**
+ * @brief Accepts input if it is live and nothing is being replayed, or if it is
+ * being fed from a replay. Accepted input is timestamped into the event buffer, and
+ * recorded if recording.
+ */
+static b8 input_accept(input_event_type type, b8 pressed, i16 code, i16 x, i16 y) {
+    if (!state_ptr || (state_ptr->replayer.active && !state_ptr->replayer.feeding)) {
+        return false;
+    }
+
+    u64 ticks = platform_get_ticks();
+    input_event* event = &state_ptr->events[state_ptr->events_written++ & (INPUT_EVENT_BUFFER_SIZE - 1)];
+    event->ticks = ticks;
+    event->type = (u8)type;
+    event->pressed = pressed;
+    event->code = code;
+    event->x = x;
+    event->y = y;
+
+    if (state_ptr->recorder.active) {
+        input_recorder_push(ticks, (u8)type, pressed, code, x, y);
+    }
+    return true;
+}
+
+// Writes out the records of the current frame.
+static void input_recorder_flush() {
+    input_recorder* recorder = &state_ptr->recorder;
+    u64 count = darray_length(recorder->pending);
+    if (count == 0) {
+        return;
+    }
+
+    u64 written = 0;
+    if (!filesystem_write(&recorder->file, sizeof(input_record) * count, recorder->pending, &written)) {
+        KERROR("Failed to write input recording; recording stopped.");
+        input_recording_stop();
+        return;
+    }
+    _darray_clear(recorder->pending);
+}
+
+// Feeds the recorded input of the next frame through input_process_*.
+static void input_replay_feed_frame() {
+    input_replayer* replayer = &state_ptr->replayer;
+    replayer->feeding = true;
+    while (replayer->next < replayer->record_count) {
+        input_record* record = &replayer->records[replayer->next++];
+        switch (record->type) {
+            case INPUT_EVENT_KEY:
+                input_process_key((keys)record->code, record->pressed);
+                break;
+            case INPUT_EVENT_BUTTON:
+                input_process_button((buttons)record->code, record->pressed);
+                break;
+            case INPUT_EVENT_MOUSE_MOVE:
+                input_process_mouse_move(record->x, record->y);
+                break;
+            case INPUT_EVENT_MOUSE_WHEEL:
+                input_process_mouse_wheel((i8)record->code);
+                break;
+            case INPUT_RECORD_FRAME_END:
+            default:
+                replayer->feeding = false;
+                return;
+        }
+    }
+    replayer->feeding = false;
+}
+
 void input_update(f64 delta_time) {
+    KPROFILE_SCOPE("input_update");
     if (!state_ptr) {
         return;
     }
 
     // Copy current states to previous states.
-    kcopy_memory(&state_ptr->keyboard_previous, &state_ptr->keyboard_current, sizeof(keyboard_state));
-    kcopy_memory(&state_ptr->mouse_previous, &state_ptr->mouse_current, sizeof(mouse_state));
+    state_ptr->keyboard_previous = state_ptr->keyboard_current;
+    state_ptr->mouse_previous = state_ptr->mouse_current;
+    state_ptr->actions_previous = input_actions_current();
+    state_ptr->frame_events_start = state_ptr->events_written;
+
+    if (state_ptr->recorder.active) {
+        input_recorder_push(platform_get_ticks(), INPUT_RECORD_FRAME_END, false, 0, 0, 0);
+        input_recorder_flush();
+    }
+
+    // Next frame's input, in place of what the platform would report while pumping messages.
+    if (state_ptr->replayer.active) {
+        if (state_ptr->replayer.next < state_ptr->replayer.record_count) {
+            input_replay_feed_frame();
+        } else {
+            KINFO("Input replay finished.");
+            input_replay_end();
+            event_context context = {0};
+            event_post(EVENT_CODE_APPLICATION_QUIT, 0, context);
+        }
+    }
 }
 
 void input_process_key(keys key, b8 pressed) {
+    if (key >= KEYBOARD_STATE_WORDS * 64 || !input_accept(INPUT_EVENT_KEY, pressed, (i16)key, 0, 0)) {
+        return;
+    }
+
     // Only handle this if the state actually changed.
-    if (state_ptr && state_ptr->keyboard_current.keys[key] != pressed) {
+    u64* word = &state_ptr->keyboard_current.keys[KEY_WORD(key)];
+    if (((*word & KEY_BIT(key)) != 0) != pressed) {
         // Update internal state_ptr->
-        state_ptr->keyboard_current.keys[key] = pressed;
+        *word ^= KEY_BIT(key);
+        state_ptr->actions_dirty = true;
 
         if (key == KEY_LALT) {
-            KINFO("Left alt %s.", pressed ? "pressed" : "released");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Left alt %s.", pressed ? "pressed" : "released");
         } else if (key == KEY_RALT) {
-            KINFO("Right alt %s.", pressed ? "pressed" : "released");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Right alt %s.", pressed ? "pressed" : "released");
         }
 
         if (key == KEY_LCONTROL) {
-            KINFO("Left ctrl %s.", pressed ? "pressed" : "released");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Left ctrl %s.", pressed ? "pressed" : "released");
         } else if (key == KEY_RCONTROL) {
-            KINFO("Right ctrl %s.", pressed ? "pressed" : "released");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Right ctrl %s.", pressed ? "pressed" : "released");
         }
 
         if (key == KEY_LSHIFT) {
-            KINFO("Left shift %s.", pressed ? "pressed" : "released");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Left shift %s.", pressed ? "pressed" : "released");
         } else if (key == KEY_RSHIFT) {
-            KINFO("Right shift %s.", pressed ? "pressed" : "released");
+            KDEBUG_CAT(LOG_CATEGORY_INPUT, "Right shift %s.", pressed ? "pressed" : "released");
         }
 
-        // Fire off an event for immediate processing.
+        // Post an event, dispatched along with the rest of the frame's input.
         event_context context;
         context.data.u16[0] = key;
-        event_fire(pressed ? EVENT_CODE_KEY_PRESSED : EVENT_CODE_KEY_RELEASED, 0, context);
+        event_post(pressed ? EVENT_CODE_KEY_PRESSED : EVENT_CODE_KEY_RELEASED, 0, context);
     }
 }
 
 void input_process_button(buttons button, b8 pressed) {
+    if (button >= BUTTON_MAX_BUTTONS || !input_accept(INPUT_EVENT_BUTTON, pressed, (i16)button, 0, 0)) {
+        return;
+    }
+
     // If the state changed, fire an event.
-    if (state_ptr->mouse_current.buttons[button] != pressed) {
-        state_ptr->mouse_current.buttons[button] = pressed;
+    if (((state_ptr->mouse_current.buttons & (1 << button)) != 0) != pressed) {
+        state_ptr->mouse_current.buttons ^= (u8)(1 << button);
+        state_ptr->actions_dirty = true;
 
-        // Fire the event.
+        // Post the event.
         event_context context;
         context.data.u16[0] = button;
-        event_fire(pressed ? EVENT_CODE_BUTTON_PRESSED : EVENT_CODE_BUTTON_RELEASED, 0, context);
+        event_post(pressed ? EVENT_CODE_BUTTON_PRESSED : EVENT_CODE_BUTTON_RELEASED, 0, context);
     }
 }
 
 void input_process_mouse_move(i16 x, i16 y) {
+    if (!input_accept(INPUT_EVENT_MOUSE_MOVE, false, 0, x, y)) {
+        return;
+    }
+
     // Only process if actually different
     if (state_ptr->mouse_current.x != x || state_ptr->mouse_current.y != y) {
         // NOTE: Enable this if debugging.
@@ -102,49 +346,53 @@ void input_process_mouse_move(i16 x, i16 y) {
         state_ptr->mouse_current.x = x;
         state_ptr->mouse_current.y = y;
 
-        // Fire the event.
+        // Post the event.
         event_context context;
         context.data.u16[0] = x;
         context.data.u16[1] = y;
-        event_fire(EVENT_CODE_MOUSE_MOVED, 0, context);
+        event_post(EVENT_CODE_MOUSE_MOVED, 0, context);
     }
 }
 
 void input_process_mouse_wheel(i8 z_delta) {
+    if (!input_accept(INPUT_EVENT_MOUSE_WHEEL, false, z_delta, 0, 0)) {
+        return;
+    }
+
     // NOTE: no internal state to update.
 
-    // Fire the event.
-    event_context context;
-    context.data.u8[0] = z_delta;
-    event_fire(EVENT_CODE_MOUSE_WHEEL, 0, context);
+    // Post the event.
+    event_context context = {0};
+    context.data.i8[0] = z_delta;
+    event_post(EVENT_CODE_MOUSE_WHEEL, 0, context);
 }
 
 b8 input_is_key_down(keys key) {
     if (!state_ptr) {
         return false;
     }
-    return state_ptr->keyboard_current.keys[key] == true;
+    return (state_ptr->keyboard_current.keys[KEY_WORD(key)] & KEY_BIT(key)) != 0;
 }
 
 b8 input_is_key_up(keys key) {
     if (!state_ptr) {
         return true;
     }
-    return state_ptr->keyboard_current.keys[key] == false;
+    return (state_ptr->keyboard_current.keys[KEY_WORD(key)] & KEY_BIT(key)) == 0;
 }
 
 b8 input_was_key_down(keys key) {
     if (!state_ptr) {
         return false;
     }
-    return state_ptr->keyboard_previous.keys[key] == true;
+    return (state_ptr->keyboard_previous.keys[KEY_WORD(key)] & KEY_BIT(key)) != 0;
 }
 
 b8 input_was_key_up(keys key) {
     if (!state_ptr) {
         return true;
     }
-    return state_ptr->keyboard_previous.keys[key] == false;
+    return (state_ptr->keyboard_previous.keys[KEY_WORD(key)] & KEY_BIT(key)) == 0;
 }
 
 // mouse input
@@ -152,28 +400,28 @@ b8 input_is_button_down(buttons button) {
     if (!state_ptr) {
         return false;
     }
-    return state_ptr->mouse_current.buttons[button] == true;
+    return (state_ptr->mouse_current.buttons & (1 << button)) != 0;
 }
 
 b8 input_is_button_up(buttons button) {
     if (!state_ptr) {
         return true;
     }
-    return state_ptr->mouse_current.buttons[button] == false;
+    return (state_ptr->mouse_current.buttons & (1 << button)) == 0;
 }
 
 b8 input_was_button_down(buttons button) {
     if (!state_ptr) {
         return false;
     }
-    return state_ptr->mouse_previous.buttons[button] == true;
+    return (state_ptr->mouse_previous.buttons & (1 << button)) != 0;
 }
 
 b8 input_was_button_up(buttons button) {
     if (!state_ptr) {
         return true;
     }
-    return state_ptr->mouse_previous.buttons[button] == false;
+    return (state_ptr->mouse_previous.buttons & (1 << button)) == 0;
 }
 
 void input_get_mouse_position(i32* x, i32* y) {
@@ -194,4 +442,227 @@ void input_get_previous_mouse_position(i32* x, i32* y) {
     }
     *x = state_ptr->mouse_previous.x;
     *y = state_ptr->mouse_previous.y;
-}
\ No newline at end of file
+}
+
+b8 input_recording_start(const char* path) {
+    if (!state_ptr) {
+        return false;
+    }
+    input_recording_stop();
+
+    input_recorder* recorder = &state_ptr->recorder;
+    if (!filesystem_open(path, FILE_MODE_WRITE, true, &recorder->file)) {
+        KERROR("input_recording_start - Unable to open '%s' for writing.", path);
+        return false;
+    }
+
+    input_recording_header header;
+    header.magic = INPUT_RECORDING_MAGIC;
+    header.version = INPUT_RECORDING_VERSION;
+    u64 written = 0;
+    if (!filesystem_write(&recorder->file, sizeof(input_recording_header), &header, &written)) {
+        KERROR("input_recording_start - Unable to write to '%s'.", path);
+        filesystem_close(&recorder->file);
+        return false;
+    }
+
+    recorder->pending = darray_create(input_record);
+    recorder->start_ticks = platform_get_ticks();
+    recorder->active = true;
+    KINFO("Recording input to '%s'.", path);
+    return true;
+}
+
+void input_recording_stop() {
+    if (!state_ptr || !state_ptr->recorder.active) {
+        return;
+    }
+
+    input_recorder* recorder = &state_ptr->recorder;
+    // Cleared first, as a failed flush stops the recording too.
+    recorder->active = false;
+    u64 count = darray_length(recorder->pending);
+    u64 written = 0;
+    if (count > 0 && !filesystem_write(&recorder->file, sizeof(input_record) * count, recorder->pending, &written)) {
+        KERROR("Failed to write the end of the input recording.");
+    }
+    filesystem_close(&recorder->file);
+    darray_destroy(recorder->pending);
+    kzero_memory(recorder, sizeof(input_recorder));
+}
+
+b8 input_is_recording() {
+    return state_ptr && state_ptr->recorder.active;
+}
+
+b8 input_replay_start(const char* path, f64 fixed_delta) {
+    if (!state_ptr) {
+        return false;
+    }
+    input_recording_stop();
+    input_replay_end();
+
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, true, &f)) {
+        KERROR("input_replay_start - Unable to open '%s'.", path);
+        return false;
+    }
+    input_replayer* replayer = &state_ptr->replayer;
+    b8 read = filesystem_read_all_bytes(&f, &replayer->data, &replayer->data_size);
+    filesystem_close(&f);
+
+    input_recording_header* header = (input_recording_header*)replayer->data;
+    if (!read || replayer->data_size < sizeof(input_recording_header) ||
+        header->magic != INPUT_RECORDING_MAGIC || header->version != INPUT_RECORDING_VERSION ||
+        (replayer->data_size - sizeof(input_recording_header)) % sizeof(input_record) != 0) {
+        KERROR("input_replay_start - '%s' is not a valid input recording.", path);
+        input_replay_end();
+        return false;
+    }
+    replayer->records = (input_record*)(replayer->data + sizeof(input_recording_header));
+    replayer->record_count = (replayer->data_size - sizeof(input_recording_header)) / sizeof(input_record);
+
+    u64 frame_count = 0;
+    f32 end_time = 0;
+    for (u64 i = 0; i < replayer->record_count; ++i) {
+        if (replayer->records[i].type == INPUT_RECORD_FRAME_END) {
+            frame_count++;
+            end_time = replayer->records[i].time;
+        }
+    }
+    if (fixed_delta <= 0) {
+        fixed_delta = (frame_count > 0 && end_time > 0) ? end_time / frame_count : 1.0 / 60;
+    }
+    replayer->fixed_delta = fixed_delta;
+    replayer->active = true;
+    KINFO("Replaying %llu frames of input from '%s' at %.3fms per frame.", frame_count, path, fixed_delta * 1000.0);
+
+    // The first frame's input is already due.
+    input_replay_feed_frame();
+    return true;
+}
+
+b8 input_is_replaying() {
+    return state_ptr && state_ptr->replayer.active;
+}
+
+f64 input_replay_frame_delta() {
+    return input_is_replaying() ? state_ptr->replayer.fixed_delta : 0;
+}
+
+b8 input_action_bind(u8 action, u32 key_count, const keys* keys, u32 button_count, const buttons* buttons) {
+    if (!state_ptr) {
+        return false;
+    }
+    if (action >= INPUT_MAX_ACTIONS) {
+        KERROR("input_action_bind - Action %u is out of range; must be under %u.", action, INPUT_MAX_ACTIONS);
+        return false;
+    }
+    if (key_count + button_count == 0) {
+        KERROR("input_action_bind - A binding needs at least one key or button.");
+        return false;
+    }
+    if (state_ptr->binding_count == INPUT_MAX_ACTION_BINDINGS) {
+        KERROR("input_action_bind - No more than %u bindings are supported.", INPUT_MAX_ACTION_BINDINGS);
+        return false;
+    }
+
+    input_action_binding binding = {0};
+    binding.action = action;
+    for (u32 i = 0; i < key_count; ++i) {
+        if (keys[i] >= KEYBOARD_STATE_WORDS * 64) {
+            KERROR("input_action_bind - Invalid key %u.", keys[i]);
+            return false;
+        }
+        binding.keys[KEY_WORD(keys[i])] |= KEY_BIT(keys[i]);
+    }
+    for (u32 i = 0; i < button_count; ++i) {
+        if (buttons[i] >= BUTTON_MAX_BUTTONS) {
+            KERROR("input_action_bind - Invalid button %u.", buttons[i]);
+            return false;
+        }
+        binding.buttons |= (u8)(1 << buttons[i]);
+    }
+    state_ptr->bindings[state_ptr->binding_count++] = binding;
+
+    // Re-evaluate both states, so a binding made mid-frame doesn't read as a press or release.
+    state_ptr->actions_previous = input_actions_evaluate(&state_ptr->keyboard_previous, &state_ptr->mouse_previous);
+    state_ptr->actions_dirty = true;
+    return true;
+}
+
+b8 input_action_bind_key(u8 action, keys key) {
+    return input_action_bind(action, 1, &key, 0, 0);
+}
+
+b8 input_action_bind_button(u8 action, buttons button) {
+    return input_action_bind(action, 0, 0, 1, &button);
+}
+
+void input_action_unbind(u8 action) {
+    if (!state_ptr) {
+        return;
+    }
+
+    u32 kept = 0;
+    for (u32 i = 0; i < state_ptr->binding_count; ++i) {
+        if (state_ptr->bindings[i].action != action) {
+            state_ptr->bindings[kept++] = state_ptr->bindings[i];
+        }
+    }
+    state_ptr->binding_count = kept;
+    state_ptr->actions_previous = input_actions_evaluate(&state_ptr->keyboard_previous, &state_ptr->mouse_previous);
+    state_ptr->actions_dirty = true;
+}
+
+u64 input_actions_down() {
+    return state_ptr ? input_actions_current() : 0;
+}
+
+u64 input_actions_pressed() {
+    return state_ptr ? input_actions_current() & ~state_ptr->actions_previous : 0;
+}
+
+u64 input_actions_released() {
+    return state_ptr ? ~input_actions_current() & state_ptr->actions_previous : 0;
+}
+
+b8 input_action_is_down(u8 action) {
+    return action < INPUT_MAX_ACTIONS && ((input_actions_down() >> action) & 1);
+}
+
+b8 input_action_was_pressed(u8 action) {
+    return action < INPUT_MAX_ACTIONS && ((input_actions_pressed() >> action) & 1);
+}
+
+b8 input_action_was_released(u8 action) {
+    return action < INPUT_MAX_ACTIONS && ((input_actions_released() >> action) & 1);
+}
+
+input_event_iterator input_events_this_frame() {
+    input_event_iterator iterator = {0};
+    if (state_ptr) {
+        iterator.position = state_ptr->frame_events_start;
+        iterator.end = state_ptr->events_written;
+    }
+    return iterator;
+}
+
+b8 input_events_next(input_event_iterator* iterator, input_event* out_event) {
+    if (!state_ptr || iterator->position >= iterator->end) {
+        return false;
+    }
+
+    // Skip anything overwritten since the iterator was created.
+    u64 oldest = state_ptr->events_written > INPUT_EVENT_BUFFER_SIZE ? state_ptr->events_written - INPUT_EVENT_BUFFER_SIZE : 0;
+    if (iterator->position < oldest) {
+        iterator->dropped += oldest - iterator->position;
+        iterator->position = oldest;
+        if (iterator->position >= iterator->end) {
+            return false;
+        }
+    }
+
+    *out_event = state_ptr->events[iterator->position++ & (INPUT_EVENT_BUFFER_SIZE - 1)];
+    return true;
+}
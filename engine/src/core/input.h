@@ -171,4 +171,149 @@ KAPI void input_get_previous_mouse_position(i32* x, i32* y);
 
 void input_process_button(buttons button, b8 pressed);
 void input_process_mouse_move(i16 x, i16 y);
-void input_process_mouse_wheel(i8 z_delta);
\ No newline at end of file
+void input_process_mouse_wheel(i8 z_delta);
+
+typedef enum input_event_type {
+    INPUT_EVENT_KEY,
+    INPUT_EVENT_BUTTON,
+    INPUT_EVENT_MOUSE_MOVE,
+    INPUT_EVENT_MOUSE_WHEEL
+} input_event_type;
+
+/**
+ * @brief A single input as reported to input_process_*, including repeats and moves which
+ * don't change the state, with the time it was processed.
+ */
+typedef struct input_event {
+    // platform_get_ticks when the input was processed.
+    u64 ticks;
+    // An input_event_type.
+    u8 type;
+    // For keys and buttons.
+    b8 pressed;
+    // The key or button, or the wheel delta.
+    i16 code;
+    // For mouse moves.
+    i16 x;
+    i16 y;
+} input_event;
+
+// The number of input events kept. Older events are overwritten. Must be a power of 2.
+#define INPUT_EVENT_BUFFER_SIZE 1024
+
+// Iterates a range of buffered input events. See input_events_this_frame.
+typedef struct input_event_iterator {
+    u64 position;
+    u64 end;
+    // The number of events in the range which were overwritten before being reached.
+    u64 dropped;
+} input_event_iterator;
+
+/**
+ * @brief Obtains an iterator over every input event processed since the last input_update,
+ * oldest first. Useful for measuring latency, or for integrating high-frequency input such
+ * as mouse motion instead of sampling the latest state. Valid until the next input_update.
+ */
+KAPI input_event_iterator input_events_this_frame();
+
+/**
+ * @brief Advances an input event iterator.
+ * @param iterator A pointer to the iterator.
+ * @param out_event A pointer to hold the next event.
+ * @returns True if an event was obtained; false once the end is reached.
+ */
+KAPI b8 input_events_next(input_event_iterator* iterator, input_event* out_event);
+
+// The number of distinct actions, which are identified by 0 to INPUT_MAX_ACTIONS - 1.
+#define INPUT_MAX_ACTIONS 64
+// The total number of bindings across all actions.
+#define INPUT_MAX_ACTION_BINDINGS 128
+
+/**
+ * @brief Binds an action to a chord of keys and buttons, all of which must be held for the
+ * action to be down. An action may have several bindings, and is down while any of them is
+ * held. A chord doesn't suppress its subsets; binding Ctrl+S and S means both are down on Ctrl+S.
+ * @param action The action to bind, below INPUT_MAX_ACTIONS. Defined by game code.
+ * @param key_count The number of keys in the chord.
+ * @param keys An array of key_count keys. Can be 0/NULL if key_count is 0.
+ * @param button_count The number of mouse buttons in the chord.
+ * @param buttons An array of button_count buttons. Can be 0/NULL if button_count is 0.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 input_action_bind(u8 action, u32 key_count, const keys* keys, u32 button_count, const buttons* buttons);
+
+/**
+ * @brief Binds an action to a single key. See input_action_bind.
+ */
+KAPI b8 input_action_bind_key(u8 action, keys key);
+
+/**
+ * @brief Binds an action to a single mouse button. See input_action_bind.
+ */
+KAPI b8 input_action_bind_button(u8 action, buttons button);
+
+/**
+ * @brief Removes all bindings of an action.
+ */
+KAPI void input_action_unbind(u8 action);
+
+/**
+ * @returns A mask of the actions currently down, with bit n set for action n.
+ */
+KAPI u64 input_actions_down();
+
+/**
+ * @returns A mask of the actions which went down this frame, with bit n set for action n.
+ */
+KAPI u64 input_actions_pressed();
+
+/**
+ * @returns A mask of the actions which went up this frame, with bit n set for action n.
+ */
+KAPI u64 input_actions_released();
+
+KAPI b8 input_action_is_down(u8 action);
+KAPI b8 input_action_was_pressed(u8 action);
+KAPI b8 input_action_was_released(u8 action);
+
+/**
+ * @brief Starts recording input to a file, for later replay. Every input transition is
+ * written along with its time since recording started, grouped by frame. Stops any
+ * recording already in progress.
+ * @param path The path of the file to record to. Overwritten if it exists.
+ * @returns True if recording started; otherwise false.
+ */
+KAPI b8 input_recording_start(const char* path);
+
+/**
+ * @brief Stops recording input, writing out anything not yet written.
+ */
+KAPI void input_recording_stop();
+
+/**
+ * @returns True if input is being recorded; otherwise false.
+ */
+KAPI b8 input_is_recording();
+
+/**
+ * @brief Starts replaying input recorded with input_recording_start. Each frame's recorded
+ * input is fed through input_process_* in place of live input, which is ignored until the
+ * replay ends. The first frame's input is fed immediately; the rest as each frame ends.
+ * An EVENT_CODE_APPLICATION_QUIT is posted once the recording runs out, so a replayed
+ * session ends the same way every time.
+ * @param path The path of the recording to replay.
+ * @param fixed_delta The delta time in seconds to use for every replayed frame. Pass 0 to use
+ * the average frame time of the recording.
+ * @returns True if the replay started; otherwise false.
+ */
+KAPI b8 input_replay_start(const char* path, f64 fixed_delta);
+
+/**
+ * @returns True if recorded input is being replayed; otherwise false.
+ */
+KAPI b8 input_is_replaying();
+
+/**
+ * @returns The fixed delta time in seconds of each replayed frame, or 0 if not replaying.
+ */
+KAPI f64 input_replay_frame_delta();
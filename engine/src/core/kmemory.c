@@ -24,6 +24,9 @@ static const char* memory_tag_strings[MEMORY_TAG_MAX_TAGS] = {
     "STRING     ",
     "APPLICATION",
     "JOB        ",
+    "EVENT      ",
+    "LOGGER     ",
+    "PROFILER   ",
     "TEXTURE    ",
     "MAT_INST   ",
     "RENDERER   ",
@@ -58,7 +61,7 @@ void memory_system_shutdown(void* state) {
 
 void* kallocate(u64 size, memory_tag tag) {
     if (tag == MEMORY_TAG_UNKNOWN) {
-        KWARN("kallocate called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
+        KWARN_CAT(LOG_CATEGORY_MEMORY, "kallocate called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
     }
 
     if (state_ptr) {
@@ -75,7 +78,7 @@ void* kallocate(u64 size, memory_tag tag) {
 
 void kfree(void* block, u64 size, memory_tag tag) {
     if (tag == MEMORY_TAG_UNKNOWN) {
-        KWARN("kfree called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
+        KWARN_CAT(LOG_CATEGORY_MEMORY, "kfree called using MEMORY_TAG_UNKNOWN. Re-class this allocation.");
     }
     if (state_ptr) {
         state_ptr->stats.total_allocated -= size;
@@ -135,4 +138,15 @@ u64 get_memory_alloc_count() {
         return state_ptr->alloc_count;
     }
     return 0;
-}
\ No newline at end of file
+}
+
+u64 get_memory_tag_usage(memory_tag tag) {
+    if (state_ptr && tag < MEMORY_TAG_MAX_TAGS) {
+        return state_ptr->stats.tagged_allocations[tag];
+    }
+    return 0;
+}
+
+const char* get_memory_tag_name(memory_tag tag) {
+    return tag < MEMORY_TAG_MAX_TAGS ? memory_tag_strings[tag] : "";
+}
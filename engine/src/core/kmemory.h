@@ -14,6 +14,9 @@ typedef enum memory_tag {
     MEMORY_TAG_STRING,
     MEMORY_TAG_APPLICATION,
     MEMORY_TAG_JOB,
+    MEMORY_TAG_EVENT,
+    MEMORY_TAG_LOGGER,
+    MEMORY_TAG_PROFILER,
     MEMORY_TAG_TEXTURE,
     MEMORY_TAG_MATERIAL_INSTANCE,
     MEMORY_TAG_RENDERER,
@@ -41,4 +44,15 @@ KAPI void* kset_memory(void* dest, i32 value, u64 size);
 
 KAPI char* get_memory_usage_str();
 
-KAPI u64 get_memory_alloc_count();
\ No newline at end of file
+KAPI u64 get_memory_alloc_count();
+
+/**
+ * @brief Obtains the number of bytes currently allocated with a tag.
+ * @returns The number of bytes, or 0 if the memory system isn't initialized.
+ */
+KAPI u64 get_memory_tag_usage(memory_tag tag);
+
+/**
+ * @brief Obtains the display name of a tag, padded with spaces to the same length as the others.
+ */
+KAPI const char* get_memory_tag_name(memory_tag tag);
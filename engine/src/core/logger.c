@@ -1,74 +1,843 @@
 #include "logger.h"
+#include "logger_deferred.h"
 #include "asserts.h"
 #include "platform/platform.h"
+#include "platform/kmutex.h"
+#include "platform/ksemaphore.h"
+#include "platform/kthread.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "platform/filesystem.h"
 
 // TODO: temporary
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdlib.h>
+
+// Technically imposes a 32k character limit on a single log entry, but...
+// DON'T DO THAT!
+#define LOG_MESSAGE_MAX 32000
+// Room for the level prefix and newline around a message.
+#define LOG_LINE_MAX (LOG_MESSAGE_MAX + 16)
+
+// The most threads which may log asynchronously. Any beyond this write out directly.
+#define LOGGER_MAX_THREADS 64
+#define LOGGER_DEFAULT_THREAD_BUFFER_SIZE (64 * 1024)
+// How often the writer drains the buffers when nothing asks it to sooner.
+#define LOGGER_WRITER_INTERVAL_MS 5
+
+#define LOGGER_DEFAULT_FILE_BUFFER_SIZE (64 * 1024)
+#define LOGGER_DEFAULT_FILE_FLUSH_INTERVAL 1.0f
+// Longer than any rotated file name, which is the path plus a backup number.
+#define LOGGER_MAX_PATH 512
+
+typedef enum log_entry_kind {
+    // Fills the end of a buffer which an entry didn't fit into.
+    LOG_ENTRY_PADDING,
+    // A formatted, null-terminated message.
+    LOG_ENTRY_TEXT,
+    // A log_deferred_payload, followed by the arguments to format it with.
+    LOG_ENTRY_DEFERRED
+} log_entry_kind;
+
+// Precedes each entry in a thread buffer. Entries are 8-byte aligned.
+typedef struct log_entry_header {
+    // The size of the entry in bytes, including this header and any alignment.
+    u32 size;
+    u8 kind;
+    u8 level;
+    u16 reserved;
+    // Taken from a shared counter, so the writer can put entries from all threads back in order.
+    u64 sequence;
+} log_entry_header;
+
+/**
+ * A single-producer, single-consumer ring of log entries. Only the owning thread writes
+ * entries and only the writer thread reads them, so neither needs a lock.
+ */
+// The start of a deferred entry.
+typedef struct log_deferred_payload {
+    u32 format_id;
+    u32 args_size;
+    // When the message was logged, as it is formatted later.
+    f64 time;
+} log_deferred_payload;
+
+typedef struct log_thread_buffer {
+    // The total number of bytes ever written. Only advanced by the owning thread.
+    volatile u64 write;
+    // The total number of bytes ever read. Only advanced by the writer thread.
+    volatile u64 read;
+    // Always a power of 2.
+    u64 capacity;
+    u8* data;
+    // Where the owning thread formats messages before queueing them.
+    char* scratch;
+} log_thread_buffer;
+
+typedef struct log_thread_context {
+    log_thread_buffer* buffer;
+    // The logger initialization the buffer belongs to, so a restarted logger isn't handed a freed buffer.
+    u32 generation;
+} log_thread_context;
 
 typedef struct logger_system_state {
     b8 initialized;
+    logger_config config;
+    u32 generation;
+
+    // Serializes writing out, which is done by the writer thread and by threads writing out directly.
+    kmutex output_mutex;
+
+    // The log file, if any. Guarded by output_mutex, like everything else written out.
+    // NOTE: Uses stdio directly rather than the filesystem layer, which logs its own errors
+    // and so would re-enter the logger while the output mutex is held.
+    FILE* file;
+    // Lines not yet written to the file. Follows the state in memory.
+    char* file_buffer;
+    u64 file_buffer_used;
+    // The size of the current file, for rotation.
+    u64 file_size;
+    f64 file_last_flush;
+
+    // The binary log, if any. Only written by the writer thread.
+    FILE* binary_file;
+    // A bit per format ID, set once the format has been written to the binary log.
+    u8 binary_formats_written[(LOG_MAX_FORMATS + 7) / 8];
+    f64 binary_last_flush;
+
+    log_thread_buffer* volatile buffers[LOGGER_MAX_THREADS];
+    volatile u32 buffer_count;
+    volatile u64 next_sequence;
+    kthread writer;
+    ksemaphore writer_wake;
+    volatile b8 writer_running;
+    // Where the writer composes lines. Only used by the writer.
+    char writer_line[LOG_LINE_MAX];
 } logger_system_state;
 
 static logger_system_state* state_ptr;
 
-b8 initialize_logging(u64* memory_requirement, void* state) {
-    *memory_requirement = sizeof(logger_system_state);
+// Bumped on every initialization.
+static u32 logger_generation;
+
+static KTHREAD_LOCAL log_thread_context thread_context;
+
+// NOTE: Logging happens on fibers too.
+KTHREAD_LOCAL_ACCESSOR(log_thread_context, log_thread_context_get, thread_context)
+
+static const char* level_strings[6] = {"[FATAL]: ", "[ERROR]: ", "[WARN]:  ", "[INFO]:  ", "[DEBUG]: ", "[TRACE]: "};
+
+// Names accepted by log_category_levels_parse.
+static const char* level_names[6] = {"fatal", "error", "warn", "info", "debug", "trace"};
+static const char* category_names[LOG_CATEGORY_MAX_COUNT] = {"renderer", "input", "events", "memory", "game"};
+
+u8 log_category_levels[LOG_CATEGORY_MAX_COUNT] = {
+    LOG_CATEGORY_DEFAULT_LEVEL,
+    LOG_CATEGORY_DEFAULT_LEVEL,
+    LOG_CATEGORY_DEFAULT_LEVEL,
+    LOG_CATEGORY_DEFAULT_LEVEL,
+    LOG_CATEGORY_DEFAULT_LEVEL};
+
+u8 log_deferred_level = LOG_DEFERRED_DEFAULT_LEVEL;
+
+static u32 logger_writer_thread(void* params);
+static void logger_drain();
+
+static void logger_resolve_config(const logger_config* config, logger_config* out_config) {
+    kzero_memory(out_config, sizeof(logger_config));
+    if (config) {
+        *out_config = *config;
+    }
+    // Round up to a power of 2, no smaller than the default.
+    u32 size = LOGGER_DEFAULT_THREAD_BUFFER_SIZE;
+    while (size < out_config->thread_buffer_size) {
+        size <<= 1;
+    }
+    out_config->thread_buffer_size = size;
+    if (out_config->file_buffer_size == 0) {
+        out_config->file_buffer_size = LOGGER_DEFAULT_FILE_BUFFER_SIZE;
+    }
+    if (out_config->file_flush_interval <= 0) {
+        out_config->file_flush_interval = LOGGER_DEFAULT_FILE_FLUSH_INTERVAL;
+    }
+}
+
+/**
+ * @brief Shifts path.1 to path.N along by one, dropping the last, and moves path to path.1.
+ * With no backups kept, path is just removed.
+ */
+static void log_file_rotate(const char* path, u32 max_backups) {
+    char from[LOGGER_MAX_PATH];
+    char to[LOGGER_MAX_PATH];
+    if (max_backups == 0) {
+        remove(path);
+        return;
+    }
+    snprintf(to, LOGGER_MAX_PATH, "%s.%u", path, max_backups);
+    remove(to);
+    for (u32 i = max_backups - 1; i > 0; --i) {
+        snprintf(from, LOGGER_MAX_PATH, "%s.%u", path, i);
+        snprintf(to, LOGGER_MAX_PATH, "%s.%u", path, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, LOGGER_MAX_PATH, "%s.1", path);
+    rename(path, to);
+}
+
+/**
+ * @brief Writes the file buffer out, first rotating the file if it would grow too large.
+ * Must be called with the output mutex held.
+ */
+static void log_file_flush() {
+    if (!state_ptr->file) {
+        return;
+    }
+    state_ptr->file_last_flush = platform_get_absolute_time();
+    if (state_ptr->file_buffer_used == 0) {
+        return;
+    }
+
+    u64 max_size = state_ptr->config.file_max_size;
+    if (max_size && state_ptr->file_size > 0 && state_ptr->file_size + state_ptr->file_buffer_used > max_size) {
+        fclose(state_ptr->file);
+        log_file_rotate(state_ptr->config.file_path, state_ptr->config.file_max_backups);
+        state_ptr->file = fopen(state_ptr->config.file_path, "wb");
+        state_ptr->file_size = 0;
+        if (!state_ptr->file) {
+            platform_console_write_error("Failed to reopen the log file after rotating it; file logging stopped.\n", LOG_LEVEL_ERROR);
+            state_ptr->file_buffer_used = 0;
+            return;
+        }
+    }
+
+    fwrite(state_ptr->file_buffer, 1, state_ptr->file_buffer_used, state_ptr->file);
+    fflush(state_ptr->file);
+    state_ptr->file_size += state_ptr->file_buffer_used;
+    state_ptr->file_buffer_used = 0;
+}
+
+/**
+ * @brief Adds a line to the file buffer, writing it out as needed.
+ * Must be called with the output mutex held.
+ */
+static void log_file_write(log_level level, const char* line, u64 length) {
+    if (state_ptr->file_buffer_used + length > state_ptr->config.file_buffer_size) {
+        log_file_flush();
+        if (!state_ptr->file) {
+            return;
+        }
+    }
+    if (length > state_ptr->config.file_buffer_size) {
+        // Bigger than the buffer; straight out.
+        fwrite(line, 1, length, state_ptr->file);
+        fflush(state_ptr->file);
+        state_ptr->file_size += length;
+    } else {
+        memcpy(state_ptr->file_buffer + state_ptr->file_buffer_used, line, length);
+        state_ptr->file_buffer_used += length;
+    }
+
+    if (level <= state_ptr->config.file_flush_level ||
+        platform_get_absolute_time() - state_ptr->file_last_flush >= state_ptr->config.file_flush_interval) {
+        log_file_flush();
+    }
+}
+
+/**
+ * @brief Composes a line from a level and a message.
+ * @returns The length of the line.
+ */
+static u64 log_compose_line(char* dest, log_level level, const char* message) {
+    u64 prefix_length = strlen(level_strings[level]);
+    u64 message_length = strlen(message);
+    memcpy(dest, level_strings[level], prefix_length);
+    memcpy(dest + prefix_length, message, message_length);
+    dest[prefix_length + message_length] = '\n';
+    dest[prefix_length + message_length + 1] = 0;
+    return prefix_length + message_length + 1;
+}
+
+/**
+ * @brief Composes a line from a deferred entry, formatting its message.
+ * @returns The length of the line.
+ */
+static u64 log_compose_deferred_line(char* dest, log_level level, const log_deferred_payload* payload) {
+    u64 prefix_length = strlen(level_strings[level]);
+    memcpy(dest, level_strings[level], prefix_length);
+    const log_format* format = log_format_get(payload->format_id);
+    u64 message_length = format ? log_deferred_format(dest + prefix_length, LOG_MESSAGE_MAX, format->format, (const u8*)(payload + 1), payload->args_size) : 0;
+    dest[prefix_length + message_length] = '\n';
+    dest[prefix_length + message_length + 1] = 0;
+    return prefix_length + message_length + 1;
+}
+
+/**
+ * @brief Writes a deferred entry to the binary log, preceded by its format the first time
+ * the format is seen. Only called by the writer thread, or once it has stopped.
+ */
+static void log_binary_write(const log_deferred_payload* payload) {
+    FILE* file = state_ptr->binary_file;
+    u32 id = payload->format_id;
+    const log_format* format = log_format_get(id);
+    if (!format) {
+        return;
+    }
+
+    u8 bit = (u8)(1 << ((id - 1) & 7));
+    if (!(state_ptr->binary_formats_written[(id - 1) >> 3] & bit)) {
+        state_ptr->binary_formats_written[(id - 1) >> 3] |= bit;
+        u8 type = LOG_BINARY_RECORD_FORMAT;
+        u64 file_length = strlen(format->file);
+        u64 format_length = strlen(format->format);
+        u16 file_length16 = (u16)(file_length < 1023 ? file_length : 1023);
+        u16 format_length16 = (u16)(format_length < 0xFFFF ? format_length : 0xFFFF);
+        fwrite(&type, sizeof(type), 1, file);
+        fwrite(&id, sizeof(id), 1, file);
+        fwrite(&format->level, sizeof(format->level), 1, file);
+        fwrite(&format->line, sizeof(format->line), 1, file);
+        fwrite(&file_length16, sizeof(file_length16), 1, file);
+        // Keep the end of the path, which is the useful part.
+        fwrite(format->file + (file_length - file_length16), 1, file_length16, file);
+        fwrite(&format_length16, sizeof(format_length16), 1, file);
+        fwrite(format->format, 1, format_length16, file);
+    }
+
+    u8 type = LOG_BINARY_RECORD_MESSAGE;
+    fwrite(&type, sizeof(type), 1, file);
+    fwrite(&id, sizeof(id), 1, file);
+    fwrite(&payload->time, sizeof(payload->time), 1, file);
+    fwrite(&payload->args_size, sizeof(payload->args_size), 1, file);
+    fwrite(payload + 1, 1, payload->args_size, file);
+}
+
+static void log_binary_flush() {
+    fflush(state_ptr->binary_file);
+    state_ptr->binary_last_flush = platform_get_absolute_time();
+}
+
+static void log_write_line(log_level level, const char* line, u64 length) {
+    if (!state_ptr) {
+        // Before initialization or after shutdown, there is only the console.
+        if (level < LOG_LEVEL_WARN) {
+            platform_console_write_error(line, level);
+        } else {
+            platform_console_write(line, level);
+        }
+        return;
+    }
+
+    kmutex_lock(&state_ptr->output_mutex);
+
+    // Platform-specific output.
+    if (!state_ptr->config.console_disabled) {
+        if (level < LOG_LEVEL_WARN) {
+            platform_console_write_error(line, level);
+        } else {
+            platform_console_write(line, level);
+        }
+    }
+
+    if (state_ptr->file) {
+        log_file_write(level, line, length);
+    }
+
+    kmutex_unlock(&state_ptr->output_mutex);
+}
+
+b8 initialize_logging(u64* memory_requirement, void* state, const logger_config* config) {
+    logger_config resolved;
+    logger_resolve_config(config, &resolved);
+    // The file buffer follows the state.
+    *memory_requirement = sizeof(logger_system_state) + (resolved.file_path ? resolved.file_buffer_size : 0);
     if (state == 0) {
         return true;
     }
 
-    state_ptr = state;
-    state_ptr->initialized = true;
+    kzero_memory(state, *memory_requirement);
+    logger_system_state* new_state = state;
+    new_state->config = resolved;
+    new_state->generation = ++logger_generation;
 
-    // TODO: Remove this
-    KFATAL("A test message: %f", 3.14f);
-    KERROR("A test message: %f", 3.14f);
-    KWARN("A test message: %f", 3.14f);
-    KINFO("A test message: %f", 3.14f);
-    KDEBUG("A test message: %f", 3.14f);
-    KTRACE("A test message: %f", 3.14f);
+    if (!kmutex_create(&new_state->output_mutex)) {
+        platform_console_write_error("Failed to create logger mutex.\n", LOG_LEVEL_ERROR);
+        return false;
+    }
+
+    if (resolved.file_path) {
+        if (string_length(resolved.file_path) + 12 > LOGGER_MAX_PATH) {
+            platform_console_write_error("Log file path is too long; not logging to file.\n", LOG_LEVEL_ERROR);
+        } else {
+            // Keep the previous run's log.
+            if (filesystem_exists(resolved.file_path)) {
+                log_file_rotate(resolved.file_path, resolved.file_max_backups);
+            }
+            new_state->file = fopen(resolved.file_path, "wb");
+            if (!new_state->file) {
+                platform_console_write_error("Failed to open the log file; not logging to file.\n", LOG_LEVEL_ERROR);
+            }
+        }
+        new_state->file_buffer = (char*)state + sizeof(logger_system_state);
+        new_state->file_last_flush = platform_get_absolute_time();
+    }
+    if (resolved.async && resolved.binary_file_path) {
+        if (filesystem_exists(resolved.binary_file_path)) {
+            log_file_rotate(resolved.binary_file_path, resolved.file_max_backups);
+        }
+        new_state->binary_file = fopen(resolved.binary_file_path, "wb");
+        if (new_state->binary_file) {
+            static char binary_file_buffer[LOGGER_DEFAULT_FILE_BUFFER_SIZE];
+            setvbuf(new_state->binary_file, binary_file_buffer, _IOFBF, sizeof(binary_file_buffer));
+            u32 header[2] = {LOG_BINARY_MAGIC, LOG_BINARY_VERSION};
+            fwrite(header, sizeof(header), 1, new_state->binary_file);
+            new_state->binary_last_flush = platform_get_absolute_time();
+        } else {
+            platform_console_write_error("Failed to open the binary log file; deferred messages will be written as text.\n", LOG_LEVEL_ERROR);
+        }
+    }
+    if (new_state->config.async && !ksemaphore_create(&new_state->writer_wake, 1, 0)) {
+        platform_console_write_error("Failed to create logger semaphore; logging synchronously.\n", LOG_LEVEL_ERROR);
+        new_state->config.async = false;
+    }
+
+    for (u32 i = 0; i < LOG_CATEGORY_MAX_COUNT; ++i) {
+        log_category_levels[i] = LOG_CATEGORY_DEFAULT_LEVEL;
+    }
+    log_deferred_level = LOG_DEFERRED_DEFAULT_LEVEL;
+    if (resolved.category_levels && !log_category_levels_parse(resolved.category_levels)) {
+        platform_console_write_error("Some of the configured log category levels weren't understood.\n", LOG_LEVEL_ERROR);
+    }
+    // Lets one machine turn a category up without a rebuild.
+    const char* env_levels = getenv(LOG_CATEGORY_LEVELS_ENV);
+    if (env_levels && !log_category_levels_parse(env_levels)) {
+        platform_console_write_error("Some of the log category levels in " LOG_CATEGORY_LEVELS_ENV " weren't understood.\n", LOG_LEVEL_ERROR);
+    }
+
+    new_state->initialized = true;
+    new_state->writer_running = new_state->config.async;
+    state_ptr = new_state;
+
+    // Started once the state is in place, as the writer works from it.
+    if (new_state->config.async && !kthread_create(logger_writer_thread, 0, false, &new_state->writer)) {
+        platform_console_write_error("Failed to create logger thread; logging synchronously.\n", LOG_LEVEL_ERROR);
+        __atomic_store_n(&new_state->writer_running, false, __ATOMIC_RELEASE);
+        // Anything logged by other threads in the meantime.
+        logger_drain();
+        ksemaphore_destroy(&new_state->writer_wake);
+        new_state->config.async = false;
+    }
 
-    // TODO: create log file.
     return true;
 }
 
+/**
+ * @brief Writes out everything queued in the thread buffers, merged back into the order it
+ * was logged in. Only called by the writer thread, or once it has stopped.
+ */
+static void logger_drain() {
+    u32 count = __atomic_load_n(&state_ptr->buffer_count, __ATOMIC_ACQUIRE);
+    if (count > LOGGER_MAX_THREADS) {
+        count = LOGGER_MAX_THREADS;
+    }
+
+    log_thread_buffer* buffers[LOGGER_MAX_THREADS];
+    u64 reads[LOGGER_MAX_THREADS];
+    u64 writes[LOGGER_MAX_THREADS];
+    for (u32 i = 0; i < count; ++i) {
+        // May still be 0 while being registered.
+        buffers[i] = __atomic_load_n(&state_ptr->buffers[i], __ATOMIC_ACQUIRE);
+        reads[i] = buffers[i] ? buffers[i]->read : 0;
+        writes[i] = buffers[i] ? __atomic_load_n(&buffers[i]->write, __ATOMIC_ACQUIRE) : 0;
+    }
+
+    for (;;) {
+        // The earliest entry at the head of any buffer.
+        log_entry_header* next = 0;
+        u32 next_index = 0;
+        for (u32 i = 0; i < count; ++i) {
+            log_entry_header* header = 0;
+            while (reads[i] < writes[i]) {
+                header = (log_entry_header*)(buffers[i]->data + (reads[i] & (buffers[i]->capacity - 1)));
+                if (header->kind != LOG_ENTRY_PADDING) {
+                    break;
+                }
+                reads[i] += header->size;
+                header = 0;
+            }
+            if (!header) {
+                continue;
+            }
+            if (!next || header->sequence < next->sequence) {
+                next = header;
+                next_index = i;
+            }
+        }
+        if (!next) {
+            break;
+        }
+
+        if (next->kind == LOG_ENTRY_DEFERRED) {
+            const log_deferred_payload* payload = (const log_deferred_payload*)(next + 1);
+            if (state_ptr->binary_file) {
+                log_binary_write(payload);
+                if (next->level == LOG_LEVEL_FATAL) {
+                    log_binary_flush();
+                }
+            } else {
+                u64 length = log_compose_deferred_line(state_ptr->writer_line, next->level, payload);
+                log_write_line(next->level, state_ptr->writer_line, length);
+            }
+        } else {
+            u64 length = log_compose_line(state_ptr->writer_line, next->level, (const char*)(next + 1));
+            log_write_line(next->level, state_ptr->writer_line, length);
+        }
+        reads[next_index] += next->size;
+    }
+
+    // Hand the space back to the owning threads.
+    for (u32 i = 0; i < count; ++i) {
+        if (buffers[i]) {
+            __atomic_store_n(&buffers[i]->read, reads[i], __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static u32 logger_writer_thread(void* params) {
+    while (__atomic_load_n(&state_ptr->writer_running, __ATOMIC_ACQUIRE)) {
+        ksemaphore_wait(&state_ptr->writer_wake, LOGGER_WRITER_INTERVAL_MS);
+        logger_drain();
+
+        // Don't leave lines sitting in the file buffer through a quiet spell.
+        if (state_ptr->file) {
+            kmutex_lock(&state_ptr->output_mutex);
+            if (platform_get_absolute_time() - state_ptr->file_last_flush >= state_ptr->config.file_flush_interval) {
+                log_file_flush();
+            }
+            kmutex_unlock(&state_ptr->output_mutex);
+        }
+        if (state_ptr->binary_file && platform_get_absolute_time() - state_ptr->binary_last_flush >= state_ptr->config.file_flush_interval) {
+            log_binary_flush();
+        }
+    }
+    // Opened if anything profiled with counters ran on this thread.
+    platform_perf_counters_close();
+    return 0;
+}
+
 void shutdown_logging(void* state) {
-    // TODO: cleanup logging/write queued entries.
+    if (!state_ptr) {
+        return;
+    }
+
+    logger_system_state* old_state = state_ptr;
+    if (old_state->config.async) {
+        // Stop the writer, then write out whatever it didn't get to.
+        __atomic_store_n(&old_state->writer_running, false, __ATOMIC_RELEASE);
+        ksemaphore_signal(&old_state->writer_wake);
+        kthread_wait(&old_state->writer);
+        logger_drain();
+        ksemaphore_destroy(&old_state->writer_wake);
+    }
+
+    if (old_state->file) {
+        log_file_flush();
+        fclose(old_state->file);
+        old_state->file = 0;
+    }
+    if (old_state->binary_file) {
+        fclose(old_state->binary_file);
+        old_state->binary_file = 0;
+    }
+
+    // From here on, logging writes out directly.
     state_ptr = 0;
+
+    for (u32 i = 0; i < old_state->buffer_count && i < LOGGER_MAX_THREADS; ++i) {
+        log_thread_buffer* buffer = old_state->buffers[i];
+        if (buffer) {
+            kfree(buffer, sizeof(log_thread_buffer) + LOG_MESSAGE_MAX + buffer->capacity, MEMORY_TAG_LOGGER);
+        }
+    }
+    kmutex_destroy(&old_state->output_mutex);
 }
 
-void log_output(log_level level, const char* message, ...) {
-    const char* level_strings[6] = {"[FATAL]: ", "[ERROR]: ", "[WARN]:  ", "[INFO]:  ", "[DEBUG]: ", "[TRACE]: "};
-    b8 is_error = level < LOG_LEVEL_WARN;
+/**
+ * @brief Obtains the calling thread's buffer, creating it on the thread's first message.
+ * @returns The buffer, or 0 if the thread must write out directly.
+ */
+static log_thread_buffer* logger_thread_buffer_get() {
+    log_thread_context* context = log_thread_context_get();
+    if (context->generation == state_ptr->generation) {
+        return context->buffer;
+    }
+
+    context->generation = state_ptr->generation;
+    context->buffer = 0;
+    u32 index = __atomic_fetch_add(&state_ptr->buffer_count, 1, __ATOMIC_ACQ_REL);
+    if (index >= LOGGER_MAX_THREADS) {
+        return 0;
+    }
+
+    u64 capacity = state_ptr->config.thread_buffer_size;
+    log_thread_buffer* buffer = kallocate(sizeof(log_thread_buffer) + LOG_MESSAGE_MAX + capacity, MEMORY_TAG_LOGGER);
+    buffer->capacity = capacity;
+    buffer->scratch = (char*)(buffer + 1);
+    // NOTE: The data follows the scratch space; both sizes keep it 8-byte aligned.
+    buffer->data = (u8*)buffer->scratch + LOG_MESSAGE_MAX;
+    __atomic_store_n(&state_ptr->buffers[index], buffer, __ATOMIC_RELEASE);
+    context->buffer = buffer;
+    return buffer;
+}
+
+/**
+ * @brief Queues an entry on the owning thread's buffer, waiting for the writer to make
+ * room if it is full. Entries may be at most half the buffer's capacity.
+ */
+static void log_buffer_push(log_thread_buffer* buffer, log_level level, log_entry_kind kind, const void* data, u32 size) {
+    u64 entry_size = (sizeof(log_entry_header) + size + 7) & ~7ull;
+    u64 write = buffer->write;
+    u64 offset;
+    u64 contiguous;
+    u64 used;
+    for (;;) {
+        used = write - __atomic_load_n(&buffer->read, __ATOMIC_ACQUIRE);
+        offset = write & (buffer->capacity - 1);
+        contiguous = buffer->capacity - offset;
+        // An entry never wraps; if it doesn't fit before the end, the end is padded out.
+        u64 needed = entry_size + (contiguous < entry_size ? contiguous : 0);
+        if (buffer->capacity - used >= needed) {
+            break;
+        }
+        // Full. Get the writer to drain it.
+        ksemaphore_signal(&state_ptr->writer_wake);
+        kthread_yield();
+    }
+
+    if (contiguous < entry_size) {
+        log_entry_header* padding = (log_entry_header*)(buffer->data + offset);
+        padding->size = (u32)contiguous;
+        padding->kind = LOG_ENTRY_PADDING;
+        write += contiguous;
+        used += contiguous;
+        offset = 0;
+    }
+
+    log_entry_header* header = (log_entry_header*)(buffer->data + offset);
+    header->size = (u32)entry_size;
+    header->kind = (u8)kind;
+    header->level = (u8)level;
+    header->reserved = 0;
+    header->sequence = __atomic_fetch_add(&state_ptr->next_sequence, 1, __ATOMIC_RELAXED);
+    memcpy(header + 1, data, size);
+    // Publish the entry to the writer.
+    __atomic_store_n(&buffer->write, write + entry_size, __ATOMIC_RELEASE);
+
+    // Past half full, wake the writer rather than wait for its interval.
+    if ((used + entry_size) * 2 > buffer->capacity) {
+        ksemaphore_signal(&state_ptr->writer_wake);
+    }
+}
+
+void logger_flush() {
+    if (!state_ptr || !state_ptr->config.async || !__atomic_load_n(&state_ptr->writer_running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    // Everything written to each buffer up to now must be read, which the writer only
+    // does once it has been written out.
+    u64 targets[LOGGER_MAX_THREADS];
+    u32 count = __atomic_load_n(&state_ptr->buffer_count, __ATOMIC_ACQUIRE);
+    if (count > LOGGER_MAX_THREADS) {
+        count = LOGGER_MAX_THREADS;
+    }
+    for (u32 i = 0; i < count; ++i) {
+        log_thread_buffer* buffer = __atomic_load_n(&state_ptr->buffers[i], __ATOMIC_ACQUIRE);
+        targets[i] = buffer ? __atomic_load_n(&buffer->write, __ATOMIC_ACQUIRE) : 0;
+    }
+
+    ksemaphore_signal(&state_ptr->writer_wake);
+    for (u32 i = 0; i < count; ++i) {
+        log_thread_buffer* buffer = __atomic_load_n(&state_ptr->buffers[i], __ATOMIC_ACQUIRE);
+        while (buffer && __atomic_load_n(&buffer->read, __ATOMIC_ACQUIRE) < targets[i]) {
+            kthread_yield();
+        }
+    }
+}
+
+/**
+ * @brief Obtains the calling thread's buffer if logging asynchronously.
+ * @returns The buffer, or 0 if the message must be written out directly.
+ */
+static log_thread_buffer* log_async_buffer_get() {
+    if (state_ptr && state_ptr->config.async && __atomic_load_n(&state_ptr->writer_running, __ATOMIC_ACQUIRE)) {
+        return logger_thread_buffer_get();
+    }
+    return 0;
+}
+
+/**
+ * @brief Formats a message straight away, then queues it or writes it out.
+ * Consumes arg_ptr.
+ */
+static void log_output_formatted(log_level level, const char* message, __builtin_va_list arg_ptr) {
+    log_thread_buffer* buffer = log_async_buffer_get();
+    if (buffer) {
+        // Only format here; the writer adds the prefix and writes it out.
+        i32 length = vsnprintf(buffer->scratch, LOG_MESSAGE_MAX, message, arg_ptr);
+        if (length < 0) {
+            length = 0;
+            buffer->scratch[0] = 0;
+        } else if (length >= LOG_MESSAGE_MAX) {
+            length = LOG_MESSAGE_MAX - 1;
+        }
+        log_buffer_push(buffer, level, LOG_ENTRY_TEXT, buffer->scratch, (u32)length + 1);
+
+        if (level == LOG_LEVEL_FATAL) {
+            // The application may be about to go down; make sure this is seen.
+            logger_flush();
+        }
+        return;
+    }
+
+    // Format straight after the prefix, leaving room for the newline.
+    char out_line[LOG_LINE_MAX];
+    u64 prefix_length = strlen(level_strings[level]);
+    memcpy(out_line, level_strings[level], prefix_length);
+    i32 length = vsnprintf(out_line + prefix_length, LOG_MESSAGE_MAX, message, arg_ptr);
+    if (length < 0) {
+        length = 0;
+    } else if (length >= LOG_MESSAGE_MAX) {
+        length = LOG_MESSAGE_MAX - 1;
+    }
+    out_line[prefix_length + length] = '\n';
+    out_line[prefix_length + length + 1] = 0;
+    log_write_line(level, out_line, prefix_length + length + 1);
+}
+
+void log_category_level_set(log_category category, log_level level) {
+    if (category < LOG_CATEGORY_MAX_COUNT) {
+        log_category_levels[category] = (u8)level;
+    }
+}
 
-    // Technically imposes a 32k character limit on a single log entry, but...
-    // DON'T DO THAT!
-    const i32 msg_length = 32000;
-    char out_message[msg_length];
-    memset(out_message, 0, sizeof(out_message));
+void log_deferred_level_set(log_level level) {
+    log_deferred_level = (u8)level;
+}
 
-    // Format original message.
+/**
+ * @brief Finds a name in a list, ignoring case.
+ * @returns The index of the name, or -1 if it isn't there.
+ */
+static i32 log_name_find(const char* name, u64 length, const char** names, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        u64 j = 0;
+        while (j < length && names[i][j] && (name[j] | 0x20) == names[i][j]) {
+            ++j;
+        }
+        if (j == length && names[i][j] == 0) {
+            return (i32)i;
+        }
+    }
+    return -1;
+}
+
+b8 log_category_levels_parse(const char* levels) {
+    b8 result = true;
+    const char* cursor = levels;
+    while (*cursor) {
+        // One category=level pair, up to the next comma.
+        const char* end = cursor;
+        while (*end && *end != ',') {
+            ++end;
+        }
+        const char* equals = cursor;
+        while (equals < end && *equals != '=') {
+            ++equals;
+        }
+
+        const char* name = cursor;
+        const char* name_end = equals;
+        const char* value = equals + 1;
+        const char* value_end = end;
+        while (name < name_end && *name == ' ') ++name;
+        while (name_end > name && name_end[-1] == ' ') --name_end;
+        while (value < value_end && *value == ' ') ++value;
+        while (value_end > value && value_end[-1] == ' ') --value_end;
+
+        i32 level = equals < end ? log_name_find(value, (u64)(value_end - value), level_names, 6) : -1;
+        b8 all = log_name_find(name, (u64)(name_end - name), (const char*[]){"all"}, 1) == 0;
+        b8 deferred = log_name_find(name, (u64)(name_end - name), (const char*[]){"deferred"}, 1) == 0;
+        i32 category = all || deferred ? -1 : log_name_find(name, (u64)(name_end - name), category_names, LOG_CATEGORY_MAX_COUNT);
+        if (level < 0 || (!all && !deferred && category < 0)) {
+            // Empty entries, such as from a trailing comma, are fine.
+            result = result && name == name_end && equals == end;
+        } else if (all) {
+            for (u32 i = 0; i < LOG_CATEGORY_MAX_COUNT; ++i) {
+                log_category_levels[i] = (u8)level;
+            }
+            log_deferred_level = (u8)level;
+        } else if (deferred) {
+            log_deferred_level = (u8)level;
+        } else {
+            log_category_levels[category] = (u8)level;
+        }
+
+        cursor = *end ? end + 1 : end;
+    }
+    return result;
+}
+
+void log_output(log_level level, const char* message, ...) {
     // NOTE: Oddly enough, MS's headers override the GCC/Clang va_list type with a "typedef char* va_list" in some
     // cases, and as a result throws a strange error here. The workaround for now is to just use __builtin_va_list,
     // which is the type GCC/Clang's va_start expects.
     __builtin_va_list arg_ptr;
     va_start(arg_ptr, message);
-    vsnprintf(out_message, msg_length, message, arg_ptr);
+    log_output_formatted(level, message, arg_ptr);
     va_end(arg_ptr);
+}
 
-    char out_message2[msg_length];
-    sprintf(out_message2, "%s%s\n", level_strings[level], out_message);
+void log_output_deferred(u32* format_id, log_level level, const char* file, i32 line, const char* message, ...) {
+    __builtin_va_list arg_ptr;
+    va_start(arg_ptr, message);
 
-    // Platform-specific output.
-    if (is_error) {
-        platform_console_write_error(out_message2, level);
-    } else {
-        platform_console_write(out_message2, level);
+    log_thread_buffer* buffer = log_async_buffer_get();
+    u32 id = __atomic_load_n(format_id, __ATOMIC_ACQUIRE);
+    if (buffer && id == 0) {
+        // First time through this call site. Should two threads race here, the site just
+        // ends up with one of the two IDs.
+        id = log_format_register(level, message, file, (u32)line);
+        __atomic_store_n(format_id, id, __ATOMIC_RELEASE);
     }
+
+    if (buffer && id != LOG_FORMAT_UNSUPPORTED) {
+        const log_format* format = log_format_get(id);
+        log_deferred_payload* payload = (log_deferred_payload*)buffer->scratch;
+        u64 args_size = 0;
+        // Packing consumes the arguments, which are still needed should they not fit.
+        __builtin_va_list pack_args;
+        va_copy(pack_args, arg_ptr);
+        b8 packed = log_deferred_pack(format, (u8*)(payload + 1), LOG_MESSAGE_MAX - sizeof(log_deferred_payload), &pack_args, &args_size);
+        va_end(pack_args);
+        if (packed) {
+            payload->format_id = id;
+            payload->args_size = (u32)args_size;
+            payload->time = platform_get_absolute_time();
+            log_buffer_push(buffer, level, LOG_ENTRY_DEFERRED, payload, sizeof(log_deferred_payload) + (u32)args_size);
+            va_end(arg_ptr);
+
+            if (level == LOG_LEVEL_FATAL) {
+                logger_flush();
+            }
+            return;
+        }
+    }
+
+    log_output_formatted(level, message, arg_ptr);
+    va_end(arg_ptr);
 }
 
 void report_assertion_failure(const char* expression, const char* message, const char* file, i32 line) {
     log_output(LOG_LEVEL_FATAL, "Assertion Failure: %s, message: '%s', in file: %s, line: %d\n", expression, message, file, line);
-}
\ No newline at end of file
+}
@@ -22,19 +22,147 @@ typedef enum log_level {
     LOG_LEVEL_TRACE = 5
 } log_level;
 
+// Areas of the engine whose logging can be turned up or down at runtime.
+typedef enum log_category {
+    LOG_CATEGORY_RENDERER,
+    LOG_CATEGORY_INPUT,
+    LOG_CATEGORY_EVENTS,
+    LOG_CATEGORY_MEMORY,
+    LOG_CATEGORY_GAME,
+
+    LOG_CATEGORY_MAX_COUNT
+} log_category;
+
+// The level categories start at, unless configured otherwise.
+#define LOG_CATEGORY_DEFAULT_LEVEL LOG_LEVEL_INFO
+
+// The level deferred messages start at, unless configured otherwise. Matches the levels compiled in.
+#if LOG_TRACE_ENABLED == 1
+#define LOG_DEFERRED_DEFAULT_LEVEL LOG_LEVEL_TRACE
+#else
+#define LOG_DEFERRED_DEFAULT_LEVEL LOG_LEVEL_INFO
+#endif
+
+// The environment variable checked for category levels, in the form taken by log_category_levels_parse.
+#define LOG_CATEGORY_LEVELS_ENV "KOHI_LOG_LEVELS"
+
+// Logging system configuration.
+typedef struct logger_config {
+    /**
+     * @brief Moves output off the logging threads. Each thread formats its messages into its
+     * own buffer, and a background thread writes them out in batches. Fatal messages are
+     * always written out, along with everything logged before them, before log_output returns.
+     */
+    b8 async;
+    // The size in bytes of each thread's buffer when async. 0 uses the default of 64KiB, which is also the minimum.
+    u32 thread_buffer_size;
+
+    // Turns off console output, such as for servers which only need the log file.
+    b8 console_disabled;
+
+    /**
+     * @brief If set, messages are also written to this file. Lines are collected in a buffer
+     * which is written out when full, when a message at or above file_flush_level arrives,
+     * or once file_flush_interval has passed. An existing file is rotated out first.
+     */
+    const char* file_path;
+    // The size in bytes of the file buffer. 0 uses the default of 64KiB.
+    u32 file_buffer_size;
+    // The longest in seconds a line may sit in the file buffer. 0 uses the default of 1 second.
+    // NOTE: Only checked as messages arrive, unless async, in which case the writer checks it too.
+    f32 file_flush_interval;
+    // Messages of this level or more severe are written out straight away. Fatal messages always are.
+    log_level file_flush_level;
+    // The size in bytes past which the file is rotated. 0 never rotates.
+    u64 file_max_size;
+    // The number of rotated files kept, as file_path.1 (newest) to file_path.N. 0 keeps none.
+    u32 file_max_backups;
+
+    /**
+     * @brief If set while async, deferred messages (see KLOG_DEFERRED) are written unformatted
+     * to this file rather than formatted by the writer, to be turned into text offline by the
+     * logdecoder tool. They don't appear on the console or in file_path. Rotated like file_path.
+     */
+    const char* binary_file_path;
+
+    /**
+     * @brief Category levels to start with, in the form taken by log_category_levels_parse.
+     * Applied before any set in the KOHI_LOG_LEVELS environment variable, which win.
+     */
+    const char* category_levels;
+} logger_config;
+
 /**
  * @brief Initializes logging system. Call twice; once with state = 0 to get required memory size,
  * then a second time passing allocated memory to state.
  * 
  * @param memory_requirement A pointer to hold the required memory size of internal state.
  * @param state 0 if just requesting memory requirement, otherwise allocated block of memory.
+ * @param config The configuration to use. Can be 0/NULL for defaults.
  * @return b8 True on success; otherwise false.
  */
-b8 initialize_logging(u64* memory_requirement, void* state);
+b8 initialize_logging(u64* memory_requirement, void* state, const logger_config* config);
 void shutdown_logging(void* state);
 
 KAPI void log_output(log_level level, const char* message, ...);
 
+/**
+ * @brief Logs a message whose formatting is left to the writer thread, or to the logdecoder tool.
+ * Only the format's ID and the raw arguments are queued, so this is far cheaper on the calling
+ * thread than log_output. Falls back to log_output when not async, or when the format has
+ * conversions which can't be deferred, such as '*' widths and %n.
+ * NOTE: Strings are copied, up to 1024 characters. Use the KLOG_DEFERRED macros rather than calling this.
+ *
+ * @param format_id A pointer to the call site's format ID, which starts at 0 and is filled in on first use.
+ * @param level The level of the message.
+ * @param file The file containing the call site.
+ * @param line The line of the call site.
+ * @param message The format of the message.
+ */
+KAPI void log_output_deferred(u32* format_id, log_level level, const char* file, i32 line, const char* message, ...);
+
+/**
+ * @brief The most verbose level logged for each log_category, indexed by category.
+ * NOTE: Read directly by the category logging macros so that a disabled message costs a single
+ * compare and branch, before any of its arguments are evaluated. Change with log_category_level_set.
+ */
+KAPI extern u8 log_category_levels[LOG_CATEGORY_MAX_COUNT];
+
+/**
+ * @brief Sets the most verbose level logged for a category.
+ * @param category The category to set.
+ * @param level The level. Anything less severe is skipped.
+ */
+KAPI void log_category_level_set(log_category category, log_level level);
+
+/**
+ * @brief The most verbose level logged by the KLOG_DEFERRED macros. Unlike the other levels,
+ * this isn't limited by the levels compiled in, so trace messages can be turned on in release builds.
+ * NOTE: Read directly by KLOG_DEFERRED, like log_category_levels. Change with log_deferred_level_set.
+ */
+KAPI extern u8 log_deferred_level;
+
+/**
+ * @brief Sets the most verbose level logged by the KLOG_DEFERRED macros.
+ * @param level The level. Anything less severe is skipped.
+ */
+KAPI void log_deferred_level_set(log_level level);
+
+/**
+ * @brief Sets category levels from a comma-separated list of category=level pairs, such as
+ * "renderer=trace,input=debug". Categories are renderer, input, events, memory, game or all,
+ * along with deferred for log_deferred_level; levels are fatal, error, warn, info, debug or trace.
+ * @param levels The list of levels to set.
+ * @returns True if every pair was understood; otherwise false, having still applied those which were.
+ */
+KAPI b8 log_category_levels_parse(const char* levels);
+
+/**
+ * @brief Blocks until every message logged before the call has been written out.
+ * Does nothing unless logging asynchronously.
+ */
+KAPI void logger_flush();
+
 //.. log fatal messages allways
 #define KFATAL(message, ...) log_output(LOG_LEVEL_FATAL, message, ##__VA_ARGS__);
 
@@ -71,4 +199,50 @@ KAPI void log_output(log_level level, const char* message, ...);
 #define KTRACE(message, ...);
 #endif
 
+//.. logs a message of the given level, formatting it later. Each call site registers its format once.
+//.. Gated on log_deferred_level at runtime rather than compiled out, as deferred messages are cheap enough to keep in release.
+#define KLOG_DEFERRED(level, message, ...)                                                           \
+    do {                                                                                             \
+        if (log_deferred_level >= (level)) {                                                         \
+            static u32 klog_format_id = 0;                                                           \
+            log_output_deferred(&klog_format_id, level, __FILE__, __LINE__, message, ##__VA_ARGS__); \
+        }                                                                                            \
+    } while (0)
+
+#define KINFO_DEFERRED(message, ...) KLOG_DEFERRED(LOG_LEVEL_INFO, message, ##__VA_ARGS__)
+#define KDEBUG_DEFERRED(message, ...) KLOG_DEFERRED(LOG_LEVEL_DEBUG, message, ##__VA_ARGS__)
+#define KTRACE_DEFERRED(message, ...) KLOG_DEFERRED(LOG_LEVEL_TRACE, message, ##__VA_ARGS__)
+
+//.. logs a message in a category, skipped without evaluating its arguments unless the category's level allows it.
+#define KLOG_CATEGORY(category, level, message, ...)                  \
+    do {                                                              \
+        if (log_category_levels[category] >= (level)) {               \
+            log_output(level, message, ##__VA_ARGS__);                \
+        }                                                             \
+    } while (0)
+
+#define KERROR_CAT(category, message, ...) KLOG_CATEGORY(category, LOG_LEVEL_ERROR, message, ##__VA_ARGS__)
 
+#if LOG_WARN_ENABLED == 1
+#define KWARN_CAT(category, message, ...) KLOG_CATEGORY(category, LOG_LEVEL_WARN, message, ##__VA_ARGS__)
+#else
+#define KWARN_CAT(category, message, ...)
+#endif
+
+#if LOG_INFO_ENABLED == 1
+#define KINFO_CAT(category, message, ...) KLOG_CATEGORY(category, LOG_LEVEL_INFO, message, ##__VA_ARGS__)
+#else
+#define KINFO_CAT(category, message, ...)
+#endif
+
+#if LOG_DEBUG_ENABLED == 1
+#define KDEBUG_CAT(category, message, ...) KLOG_CATEGORY(category, LOG_LEVEL_DEBUG, message, ##__VA_ARGS__)
+#else
+#define KDEBUG_CAT(category, message, ...)
+#endif
+
+#if LOG_TRACE_ENABLED == 1
+#define KTRACE_CAT(category, message, ...) KLOG_CATEGORY(category, LOG_LEVEL_TRACE, message, ##__VA_ARGS__)
+#else
+#define KTRACE_CAT(category, message, ...)
+#endif
@@ -0,0 +1,370 @@
+#include "core/logger_deferred.h"
+
+#include "core/kmemory.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+// Larger than any deferred entry's arguments.
+#define LOG_DECODE_ARGS_MAX (64 * 1024)
+#define LOG_DECODE_LINE_MAX 32000
+
+// Formats outlive any one logger, as call sites keep their IDs for the life of the process.
+static log_format log_formats[LOG_MAX_FORMATS];
+static volatile u32 log_format_count;
+
+/**
+ * @brief Finds the next conversion in a format string, skipping "%%".
+ * @param cursor Where to start looking.
+ * @param out_end A pointer to hold the position just past the conversion.
+ * @param out_type A pointer to hold the log_arg_type of the conversion.
+ * @returns A pointer to the '%' starting the conversion, or 0 if there are no more.
+ */
+static const char* log_format_find_conversion(const char* cursor, const char** out_end, u8* out_type) {
+    for (; *cursor; ++cursor) {
+        if (*cursor != '%') {
+            continue;
+        }
+        if (cursor[1] == '%') {
+            ++cursor;
+            continue;
+        }
+
+        const char* start = cursor++;
+        b8 unsupported = false;
+        // Flags, width and precision.
+        while (*cursor && strchr("-+ #0123456789.*", *cursor)) {
+            unsupported |= *cursor == '*';
+            ++cursor;
+        }
+
+        // Length modifier; how many bytes an integer is passed as.
+        u32 size = 4;
+        if (cursor[0] == 'h') {
+            cursor += cursor[1] == 'h' ? 2 : 1;
+        } else if (cursor[0] == 'l' && cursor[1] == 'l') {
+            size = 8;
+            cursor += 2;
+        } else if (cursor[0] == 'l') {
+            size = sizeof(long);
+            ++cursor;
+        } else if (strchr("jzt", cursor[0]) && cursor[0]) {
+            size = 8;
+            ++cursor;
+        } else if (cursor[0] == 'L') {
+            // long double.
+            unsupported = true;
+            ++cursor;
+        }
+
+        u8 type;
+        char conversion = *cursor;
+        if (conversion && strchr("diouxXc", conversion)) {
+            type = size == 8 ? LOG_ARG_I64 : LOG_ARG_I32;
+        } else if (conversion && strchr("fFeEgGaA", conversion)) {
+            type = LOG_ARG_F64;
+        } else if (conversion == 's' && size == 4) {
+            type = LOG_ARG_STRING;
+        } else if (conversion == 'p') {
+            type = LOG_ARG_POINTER;
+        } else {
+            type = LOG_ARG_UNSUPPORTED;
+        }
+        if (conversion) {
+            ++cursor;
+        }
+
+        *out_end = cursor;
+        *out_type = unsupported ? LOG_ARG_UNSUPPORTED : type;
+        return start;
+    }
+    return 0;
+}
+
+u32 log_format_register(log_level level, const char* format, const char* file, u32 line) {
+    log_format parsed = {0};
+    parsed.format = format;
+    parsed.file = file;
+    parsed.line = line;
+    parsed.level = (u8)level;
+
+    const char* cursor = format;
+    const char* start;
+    const char* end;
+    u8 type;
+    while ((start = log_format_find_conversion(cursor, &end, &type))) {
+        if (type == LOG_ARG_UNSUPPORTED || parsed.arg_count == LOG_DEFERRED_MAX_ARGS || (u64)(end - start) >= LOG_DEFERRED_CONVERSION_MAX) {
+            return LOG_FORMAT_UNSUPPORTED;
+        }
+        parsed.arg_types[parsed.arg_count++] = type;
+        cursor = end;
+    }
+
+    u32 index = __atomic_fetch_add(&log_format_count, 1, __ATOMIC_RELAXED);
+    if (index >= LOG_MAX_FORMATS) {
+        return LOG_FORMAT_UNSUPPORTED;
+    }
+    // NOTE: Only read once the ID has been handed out through a log entry, which publishes it.
+    log_formats[index] = parsed;
+    return index + 1;
+}
+
+const log_format* log_format_get(u32 id) {
+    if (id == 0 || id > LOG_MAX_FORMATS || id > __atomic_load_n(&log_format_count, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return &log_formats[id - 1];
+}
+
+b8 log_deferred_pack(const log_format* format, u8* dest, u64 max, __builtin_va_list* args, u64* out_size) {
+    u64 offset = 0;
+    for (u32 i = 0; i < format->arg_count; ++i) {
+        switch (format->arg_types[i]) {
+            case LOG_ARG_I32: {
+                i32 value = va_arg(*args, i32);
+                if (offset + sizeof(value) > max) {
+                    return false;
+                }
+                memcpy(dest + offset, &value, sizeof(value));
+                offset += sizeof(value);
+            } break;
+            case LOG_ARG_I64: {
+                i64 value = va_arg(*args, i64);
+                if (offset + sizeof(value) > max) {
+                    return false;
+                }
+                memcpy(dest + offset, &value, sizeof(value));
+                offset += sizeof(value);
+            } break;
+            case LOG_ARG_F64: {
+                f64 value = va_arg(*args, f64);
+                if (offset + sizeof(value) > max) {
+                    return false;
+                }
+                memcpy(dest + offset, &value, sizeof(value));
+                offset += sizeof(value);
+            } break;
+            case LOG_ARG_POINTER: {
+                u64 value = (u64)va_arg(*args, void*);
+                if (offset + sizeof(value) > max) {
+                    return false;
+                }
+                memcpy(dest + offset, &value, sizeof(value));
+                offset += sizeof(value);
+            } break;
+            case LOG_ARG_STRING: {
+                const char* value = va_arg(*args, const char*);
+                if (!value) {
+                    value = "(null)";
+                }
+                u64 length = strlen(value);
+                u16 stored_length = (u16)(length > LOG_DEFERRED_STRING_MAX ? LOG_DEFERRED_STRING_MAX : length);
+                if (offset + sizeof(stored_length) + stored_length > max) {
+                    return false;
+                }
+                memcpy(dest + offset, &stored_length, sizeof(stored_length));
+                memcpy(dest + offset + sizeof(stored_length), value, stored_length);
+                offset += sizeof(stored_length) + stored_length;
+            } break;
+        }
+    }
+    *out_size = offset;
+    return true;
+}
+
+/**
+ * @brief Copies literal text to dest, turning "%%" into '%'.
+ * @returns The new length of dest.
+ */
+static u64 log_deferred_copy_literal(char* dest, u64 length, u64 max, const char* start, const char* end) {
+    for (const char* c = start; c < end && length + 1 < max; ++c) {
+        if (c[0] == '%' && c[1] == '%') {
+            ++c;
+        }
+        dest[length++] = *c;
+    }
+    return length;
+}
+
+u64 log_deferred_format(char* dest, u64 max, const char* format, const u8* args, u64 args_size) {
+    u64 length = 0;
+    u64 offset = 0;
+    const char* cursor = format;
+    const char* start;
+    const char* end;
+    u8 type;
+    while ((start = log_format_find_conversion(cursor, &end, &type))) {
+        length = log_deferred_copy_literal(dest, length, max, cursor, start);
+        cursor = end;
+
+        // Rejected when registered, but may still turn up in a damaged binary log. Its argument
+        // is still stepped over, so the rest of the message lines up.
+        char conversion[LOG_DEFERRED_CONVERSION_MAX];
+        u64 conversion_length = (u64)(end - start);
+        if (conversion_length >= sizeof(conversion)) {
+            conversion_length = 0;
+        }
+        memcpy(conversion, start, conversion_length);
+        conversion[conversion_length] = 0;
+
+        i32 written = 0;
+        u64 remaining = max - length;
+        switch (type) {
+            case LOG_ARG_I32: {
+                i32 value = 0;
+                if (offset + sizeof(value) <= args_size) {
+                    memcpy(&value, args + offset, sizeof(value));
+                }
+                offset += sizeof(value);
+                written = snprintf(dest + length, remaining, conversion, value);
+            } break;
+            case LOG_ARG_I64: {
+                i64 value = 0;
+                if (offset + sizeof(value) <= args_size) {
+                    memcpy(&value, args + offset, sizeof(value));
+                }
+                offset += sizeof(value);
+                written = snprintf(dest + length, remaining, conversion, value);
+            } break;
+            case LOG_ARG_F64: {
+                f64 value = 0;
+                if (offset + sizeof(value) <= args_size) {
+                    memcpy(&value, args + offset, sizeof(value));
+                }
+                offset += sizeof(value);
+                written = snprintf(dest + length, remaining, conversion, value);
+            } break;
+            case LOG_ARG_POINTER: {
+                u64 value = 0;
+                if (offset + sizeof(value) <= args_size) {
+                    memcpy(&value, args + offset, sizeof(value));
+                }
+                offset += sizeof(value);
+                written = snprintf(dest + length, remaining, conversion, (void*)value);
+            } break;
+            case LOG_ARG_STRING: {
+                char value[LOG_DEFERRED_STRING_MAX + 1];
+                u16 value_length = 0;
+                if (offset + sizeof(value_length) <= args_size) {
+                    memcpy(&value_length, args + offset, sizeof(value_length));
+                }
+                offset += sizeof(value_length);
+                if (value_length > LOG_DEFERRED_STRING_MAX || offset + value_length > args_size) {
+                    value_length = 0;
+                }
+                memcpy(value, args + offset, value_length);
+                value[value_length] = 0;
+                offset += value_length;
+                written = snprintf(dest + length, remaining, conversion, value);
+            } break;
+            default:
+                break;
+        }
+        if (written > 0) {
+            length += (u64)written < remaining ? (u64)written : remaining - 1;
+        }
+    }
+    length = log_deferred_copy_literal(dest, length, max, cursor, cursor + strlen(cursor));
+    dest[length] = 0;
+    return length;
+}
+
+// Reads exactly size bytes, or fails.
+static b8 log_binary_read(FILE* file, void* dest, u64 size) {
+    return fread(dest, 1, size, file) == size;
+}
+
+b8 log_binary_decode(const char* binary_path, const char* text_path) {
+    // NOTE: Uses stdio rather than the filesystem layer to stream through the file, as it
+    // may be larger than is reasonable to read in at once.
+    FILE* in = fopen(binary_path, "rb");
+    if (!in) {
+        KERROR("log_binary_decode - Unable to open '%s'.", binary_path);
+        return false;
+    }
+    FILE* out = fopen(text_path, "w");
+    if (!out) {
+        KERROR("log_binary_decode - Unable to open '%s' for writing.", text_path);
+        fclose(in);
+        return false;
+    }
+
+    static const char* level_strings[6] = {"[FATAL]: ", "[ERROR]: ", "[WARN]:  ", "[INFO]:  ", "[DEBUG]: ", "[TRACE]: "};
+
+    // The formats found in this file, by ID. They are the offline copy of the registry.
+    typedef struct decoded_format {
+        char* format;
+        u64 format_size;
+        u8 level;
+    } decoded_format;
+    decoded_format* formats = kallocate(sizeof(decoded_format) * LOG_MAX_FORMATS, MEMORY_TAG_LOGGER);
+    u8* args = kallocate(LOG_DECODE_ARGS_MAX, MEMORY_TAG_LOGGER);
+    char* line = kallocate(LOG_DECODE_LINE_MAX, MEMORY_TAG_LOGGER);
+
+    b8 result = true;
+    u32 magic = 0;
+    u32 version = 0;
+    if (!log_binary_read(in, &magic, sizeof(magic)) || !log_binary_read(in, &version, sizeof(version)) ||
+        magic != LOG_BINARY_MAGIC || version != LOG_BINARY_VERSION) {
+        KERROR("log_binary_decode - '%s' is not a binary log.", binary_path);
+        result = false;
+    }
+
+    u64 message_count = 0;
+    u8 record_type;
+    while (result && log_binary_read(in, &record_type, sizeof(record_type))) {
+        if (record_type == LOG_BINARY_RECORD_FORMAT) {
+            u32 id, line_number;
+            u8 level;
+            u16 file_length, format_length;
+            char file[1024];
+            result = log_binary_read(in, &id, sizeof(id)) && log_binary_read(in, &level, sizeof(level)) &&
+                     log_binary_read(in, &line_number, sizeof(line_number)) &&
+                     log_binary_read(in, &file_length, sizeof(file_length)) && file_length < sizeof(file) &&
+                     log_binary_read(in, file, file_length) &&
+                     log_binary_read(in, &format_length, sizeof(format_length)) &&
+                     id > 0 && id <= LOG_MAX_FORMATS && level <= LOG_LEVEL_TRACE;
+            if (result) {
+                decoded_format* decoded = &formats[id - 1];
+                if (decoded->format) {
+                    kfree(decoded->format, decoded->format_size, MEMORY_TAG_LOGGER);
+                }
+                decoded->format_size = format_length + 1;
+                decoded->format = kallocate(decoded->format_size, MEMORY_TAG_LOGGER);
+                decoded->level = level;
+                result = log_binary_read(in, decoded->format, format_length);
+                decoded->format[format_length] = 0;
+            }
+        } else if (record_type == LOG_BINARY_RECORD_MESSAGE) {
+            u32 id, args_size;
+            f64 time;
+            result = log_binary_read(in, &id, sizeof(id)) && log_binary_read(in, &time, sizeof(time)) &&
+                     log_binary_read(in, &args_size, sizeof(args_size)) && args_size <= LOG_DECODE_ARGS_MAX &&
+                     log_binary_read(in, args, args_size) &&
+                     id > 0 && id <= LOG_MAX_FORMATS && formats[id - 1].format;
+            if (result) {
+                log_deferred_format(line, LOG_DECODE_LINE_MAX, formats[id - 1].format, args, args_size);
+                fprintf(out, "%.6f %s%s\n", time, level_strings[formats[id - 1].level], line);
+                message_count++;
+            }
+        } else {
+            result = false;
+        }
+        if (!result) {
+            KERROR("log_binary_decode - '%s' is corrupt after %llu messages.", binary_path, message_count);
+        }
+    }
+
+    for (u32 i = 0; i < LOG_MAX_FORMATS; ++i) {
+        if (formats[i].format) {
+            kfree(formats[i].format, formats[i].format_size, MEMORY_TAG_LOGGER);
+        }
+    }
+    kfree(formats, sizeof(decoded_format) * LOG_MAX_FORMATS, MEMORY_TAG_LOGGER);
+    kfree(args, LOG_DECODE_ARGS_MAX, MEMORY_TAG_LOGGER);
+    kfree(line, LOG_DECODE_LINE_MAX, MEMORY_TAG_LOGGER);
+    fclose(in);
+    fclose(out);
+    return result;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "defines.h"
+#include "core/logger.h"
+
+// The most call sites which may register deferred formats. Any beyond this are formatted straight away.
+#define LOG_MAX_FORMATS 4096
+#define LOG_DEFERRED_MAX_ARGS 16
+// Strings are copied into deferred entries up to this length, and truncated beyond it.
+#define LOG_DEFERRED_STRING_MAX 1024
+// The longest conversion spec which can be deferred, such as "%-08.3f", including its terminator.
+#define LOG_DEFERRED_CONVERSION_MAX 32
+// The ID given to formats which can't be deferred, such as those with a '*' width.
+#define LOG_FORMAT_UNSUPPORTED 0xFFFFFFFF
+
+// "KBLG"
+#define LOG_BINARY_MAGIC 0x474C424B
+#define LOG_BINARY_VERSION 1
+
+/**
+ * Binary log files start with the magic and version (u32 each), followed by records, each
+ * starting with a u8 log_binary_record_type. All values are little endian and unaligned.
+ */
+typedef enum log_binary_record_type {
+    /**
+     * Written before the first message using a format. u32 id, u8 level, u32 line,
+     * u16 file length, file, u16 format length, format.
+     */
+    LOG_BINARY_RECORD_FORMAT = 1,
+    // u32 format id, f64 time, u32 argument size, arguments as packed by log_deferred_pack.
+    LOG_BINARY_RECORD_MESSAGE = 2
+} log_binary_record_type;
+
+typedef enum log_arg_type {
+    // Anything passed as an int, such as %d, %hhu and %c.
+    LOG_ARG_I32,
+    // %lld, %zu, and %ld where long is 64 bits.
+    LOG_ARG_I64,
+    LOG_ARG_F64,
+    LOG_ARG_POINTER,
+    // Copied as a u16 length followed by the characters, without a terminator.
+    LOG_ARG_STRING,
+    // A conversion which can't be deferred.
+    LOG_ARG_UNSUPPORTED
+} log_arg_type;
+
+// A registered format, parsed once so each message only has to copy its arguments.
+typedef struct log_format {
+    const char* format;
+    const char* file;
+    u32 line;
+    u8 level;
+    u8 arg_count;
+    u8 arg_types[LOG_DEFERRED_MAX_ARGS];
+} log_format;
+
+/**
+ * @brief Registers the format of a deferred call site.
+ * @returns The format's ID, starting at 1, or LOG_FORMAT_UNSUPPORTED if it must be formatted straight away.
+ */
+u32 log_format_register(log_level level, const char* format, const char* file, u32 line);
+
+/**
+ * @brief Obtains a registered format.
+ * @returns A pointer to the format, or 0 if the ID isn't registered.
+ */
+const log_format* log_format_get(u32 id);
+
+/**
+ * @brief Copies the arguments of a message into dest, as described by its format.
+ * @param out_size A pointer to hold the number of bytes written.
+ * @returns True on success; otherwise false if they don't fit.
+ */
+b8 log_deferred_pack(const log_format* format, u8* dest, u64 max, __builtin_va_list* args, u64* out_size);
+
+/**
+ * @brief Formats a message from its format string and packed arguments.
+ * @returns The length of the formatted message, which is always null-terminated.
+ */
+u64 log_deferred_format(char* dest, u64 max, const char* format, const u8* args, u64 args_size);
+
+/**
+ * @brief Converts a binary log to text, one message per line in the order they were logged.
+ * @param binary_path The path of the binary log to read.
+ * @param text_path The path of the text file to write.
+ * @returns True on success; otherwise false if either file couldn't be opened or the log is corrupt.
+ */
+KAPI b8 log_binary_decode(const char* binary_path, const char* text_path);
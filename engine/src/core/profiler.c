@@ -0,0 +1,688 @@
+#include "profiler.h"
+
+#include "core/logger.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "platform/platform.h"
+#include "platform/filesystem.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+
+// The most threads which may record zones. Zones on any beyond this aren't recorded.
+#define PROFILER_MAX_THREADS 64
+// The number of finished zones each thread can hold until the frame ends. Must be a power of 2.
+#define PROFILER_THREAD_EVENT_COUNT 8192
+// The number of finished zones each thread can hold while waiting on their outermost zone to finish.
+#define PROFILER_MAX_PENDING 1024
+// Capture output is collected in a buffer of this size before being written out.
+#define PROFILER_CAPTURE_BUFFER_SIZE (64 * 1024)
+
+typedef enum profiler_event_type {
+    PROFILER_EVENT_ZONE,
+    // A point in time. Only kept by captures.
+    PROFILER_EVENT_INSTANT
+} profiler_event_type;
+
+// A finished zone, or an instant event.
+typedef struct profiler_event {
+    const char* name;
+    u64 start_ticks;
+    // The same as the start for instant events.
+    u64 end_ticks;
+    u32 depth;
+    u32 type;
+    // The hardware counters recorded over a zone, if any.
+    u32 counter_mask;
+    u64 counters[PERF_COUNTER_MAX];
+} profiler_event;
+
+/**
+ * A single-producer, single-consumer ring of finished zones. Only the owning thread writes
+ * them and only the main thread reads them, as the frame ends.
+ */
+typedef struct profiler_thread_buffer {
+    // Which buffer this is, which identifies the owning thread.
+    u32 index;
+    // Set while the owning thread has tried to open its hardware counters, along with those it could.
+    b8 counters_opened;
+    u32 counter_mask;
+    // The total number of events ever written. Only advanced by the owning thread.
+    volatile u64 write;
+    // The total number of events ever read. Only advanced by the main thread.
+    volatile u64 read;
+    // The number of zones the owning thread is currently inside of.
+    u32 depth;
+    // Zones dropped as the ring was full. Only written by the owning thread.
+    volatile u32 dropped_count;
+    // The dropped count as of the last frame. Only used by the main thread.
+    u32 last_dropped_count;
+
+    /**
+     * Zones are written as they finish, so children arrive before their parents. They are
+     * held here until the outermost zone around them finishes, at which point their place
+     * in the tree is known. Only used by the main thread.
+     */
+    u32 pending_count;
+    profiler_event pending[PROFILER_MAX_PENDING];
+
+    profiler_event events[PROFILER_THREAD_EVENT_COUNT];
+} profiler_thread_buffer;
+
+typedef struct profiler_thread_context {
+    profiler_thread_buffer* buffer;
+    // The profiler initialization the buffer belongs to, so a restarted profiler isn't handed a freed buffer.
+    u32 generation;
+} profiler_thread_context;
+
+typedef struct profiler_system_state {
+    u32 generation;
+
+    profiler_thread_buffer* volatile buffers[PROFILER_MAX_THREADS];
+    volatile u32 buffer_count;
+
+    // The frame being collected, and the last one finished. Swapped as each frame ends.
+    profiler_frame* current_frame;
+    profiler_frame* last_frame;
+    profiler_frame frames[2];
+
+    // Set while hardware counters are being recorded.
+    volatile b8 counters_enabled;
+    // The main thread's counters as the current frame started, if frame_counters_valid.
+    b8 frame_counters_valid;
+    u64 frame_counters[PERF_COUNTER_MAX];
+
+    // The running capture, if any.
+    b8 capturing;
+    file_handle capture_file;
+    u32 capture_frames_remaining;
+    // Capture timestamps are relative to this. Events from before it are left out.
+    u64 capture_start_ticks;
+    u64 capture_event_count;
+    // Set once a thread's name has been written to the capture.
+    b8 capture_thread_named[PROFILER_MAX_THREADS];
+    u64 capture_buffer_used;
+    char capture_buffer[PROFILER_CAPTURE_BUFFER_SIZE];
+} profiler_system_state;
+
+static profiler_system_state* state_ptr;
+
+// Names of the hardware counters in captures, indexed by perf_counter.
+static const char* counter_names[PERF_COUNTER_MAX] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+// Bumped on every initialization.
+static u32 profiler_generation;
+
+static KTHREAD_LOCAL profiler_thread_context thread_context;
+
+// NOTE: Zones are recorded on fibers too.
+KTHREAD_LOCAL_ACCESSOR(profiler_thread_context, profiler_thread_context_get, thread_context)
+
+static void profiler_frame_reset(profiler_frame* frame, u64 frame_number, u64 start_ticks) {
+    frame->frame_number = frame_number;
+    frame->start_ticks = start_ticks;
+    frame->end_ticks = start_ticks;
+    frame->node_count = 1;
+    frame->dropped_zone_count = 0;
+    frame->counter_mask = 0;
+
+    profiler_node* root = &frame->nodes[PROFILER_ROOT_NODE];
+    root->name = "frame";
+    root->parent = PROFILER_INVALID_NODE;
+    root->first_child = PROFILER_INVALID_NODE;
+    root->next_sibling = PROFILER_INVALID_NODE;
+    root->call_count = 1;
+    root->inclusive_time = 0;
+    root->self_time = 0;
+    kzero_memory(root->counters, sizeof(root->counters));
+    kzero_memory(root->self_counters, sizeof(root->self_counters));
+}
+
+b8 profiler_system_initialize(u64* memory_requirement, void* state) {
+    *memory_requirement = sizeof(profiler_system_state);
+    if (state == 0) {
+        return true;
+    }
+
+    kzero_memory(state, sizeof(profiler_system_state));
+    profiler_system_state* new_state = state;
+    new_state->generation = ++profiler_generation;
+    new_state->current_frame = &new_state->frames[0];
+    profiler_frame_reset(new_state->current_frame, 0, platform_get_ticks());
+
+    state_ptr = new_state;
+    return true;
+}
+
+void profiler_system_shutdown(void* state) {
+    if (!state_ptr) {
+        return;
+    }
+
+    profiler_capture_stop();
+    // Other threads' counters are closed as they exit.
+    if (state_ptr->counters_enabled) {
+        platform_perf_counters_close();
+    }
+
+    profiler_system_state* old_state = state_ptr;
+    // From here on, zones aren't recorded.
+    state_ptr = 0;
+
+    for (u32 i = 0; i < old_state->buffer_count && i < PROFILER_MAX_THREADS; ++i) {
+        if (old_state->buffers[i]) {
+            kfree(old_state->buffers[i], sizeof(profiler_thread_buffer), MEMORY_TAG_PROFILER);
+        }
+    }
+}
+
+/**
+ * @brief Obtains the calling thread's buffer, creating it on the thread's first zone.
+ * @returns The buffer, or 0 if the thread can't record zones.
+ */
+static profiler_thread_buffer* profiler_thread_buffer_get() {
+    profiler_thread_context* context = profiler_thread_context_get();
+    if (context->generation == state_ptr->generation) {
+        profiler_thread_buffer* buffer = context->buffer;
+        if (buffer && buffer->counters_opened != state_ptr->counters_enabled) {
+            // Counters were enabled or disabled since this thread's last zone.
+            buffer->counters_opened = state_ptr->counters_enabled;
+            if (buffer->counters_opened) {
+                buffer->counter_mask = platform_perf_counters_open();
+            } else {
+                buffer->counter_mask = 0;
+                platform_perf_counters_close();
+            }
+        }
+        return buffer;
+    }
+
+    context->generation = state_ptr->generation;
+    context->buffer = 0;
+    u32 index = __atomic_fetch_add(&state_ptr->buffer_count, 1, __ATOMIC_ACQ_REL);
+    if (index >= PROFILER_MAX_THREADS) {
+        return 0;
+    }
+
+    profiler_thread_buffer* buffer = kallocate(sizeof(profiler_thread_buffer), MEMORY_TAG_PROFILER);
+    buffer->index = index;
+    if (state_ptr->counters_enabled) {
+        buffer->counters_opened = true;
+        buffer->counter_mask = platform_perf_counters_open();
+    }
+    __atomic_store_n(&state_ptr->buffers[index], buffer, __ATOMIC_RELEASE);
+    context->buffer = buffer;
+    return buffer;
+}
+
+/**
+ * @brief Writes an event to the owning thread's buffer, dropping it if the buffer is full.
+ */
+static void profiler_event_push(profiler_thread_buffer* buffer, profiler_event_type type, const char* name, u64 start_ticks, u64 end_ticks, u32 depth, u32 counter_mask, const u64* counters) {
+    u64 write = buffer->write;
+    if (write - __atomic_load_n(&buffer->read, __ATOMIC_ACQUIRE) >= PROFILER_THREAD_EVENT_COUNT) {
+        __atomic_store_n(&buffer->dropped_count, buffer->dropped_count + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    profiler_event* event = &buffer->events[write & (PROFILER_THREAD_EVENT_COUNT - 1)];
+    event->name = name;
+    event->start_ticks = start_ticks;
+    event->end_ticks = end_ticks;
+    event->depth = depth;
+    event->type = (u32)type;
+    event->counter_mask = counter_mask;
+    if (counter_mask) {
+        kcopy_memory(event->counters, counters, sizeof(event->counters));
+    }
+    // Publish the event to the main thread.
+    __atomic_store_n(&buffer->write, write + 1, __ATOMIC_RELEASE);
+}
+
+profiler_zone profiler_zone_begin(const char* name) {
+    profiler_zone zone = {0};
+    if (!state_ptr) {
+        return zone;
+    }
+    profiler_thread_buffer* buffer = profiler_thread_buffer_get();
+    if (!buffer) {
+        return zone;
+    }
+
+    zone.name = name;
+    zone.depth = buffer->depth++;
+    zone.thread_index = buffer->index;
+    if (buffer->counter_mask && state_ptr->counters_enabled && platform_perf_counters_read(zone.start_counters)) {
+        zone.counter_mask = buffer->counter_mask;
+    }
+    // Read last, so reading the counters isn't counted in the zone's time.
+    zone.start_ticks = platform_get_ticks();
+    return zone;
+}
+
+void profiler_zone_end(profiler_zone* zone) {
+    if (!zone->name || !state_ptr) {
+        return;
+    }
+    u64 end_ticks = platform_get_ticks();
+    profiler_thread_buffer* buffer = profiler_thread_buffer_get();
+    if (!buffer) {
+        return;
+    }
+
+    // Counters are per thread, so they only mean anything if the zone ended where it began.
+    u32 counter_mask = 0;
+    u64 counters[PERF_COUNTER_MAX];
+    if (zone->counter_mask && zone->thread_index == buffer->index && platform_perf_counters_read(counters)) {
+        counter_mask = zone->counter_mask;
+        for (u32 i = 0; i < PERF_COUNTER_MAX; ++i) {
+            counters[i] -= zone->start_counters[i];
+        }
+    }
+
+    // Restored from the zone rather than decremented, in case its fiber moved threads.
+    buffer->depth = zone->depth;
+    profiler_event_push(buffer, PROFILER_EVENT_ZONE, zone->name, zone->start_ticks, end_ticks, zone->depth, counter_mask, counters);
+}
+
+void profiler_instant(const char* name) {
+    if (!state_ptr) {
+        return;
+    }
+    profiler_thread_buffer* buffer = profiler_thread_buffer_get();
+    if (buffer) {
+        u64 ticks = platform_get_ticks();
+        profiler_event_push(buffer, PROFILER_EVENT_INSTANT, name, ticks, ticks, buffer->depth, 0, 0);
+    }
+}
+
+u16 profiler_node_find_child(const profiler_frame* frame, u16 parent, const char* name) {
+    for (u16 child = frame->nodes[parent].first_child; child != PROFILER_INVALID_NODE; child = frame->nodes[child].next_sibling) {
+        // Names are usually literals, so a match is usually the same pointer.
+        if (frame->nodes[child].name == name || strings_equal(frame->nodes[child].name, name)) {
+            return child;
+        }
+    }
+    return PROFILER_INVALID_NODE;
+}
+
+/**
+ * @brief Finds a child of a node by name, adding it if there isn't one.
+ * @returns The index of the child, or PROFILER_INVALID_NODE if the tree is full.
+ */
+static u16 profiler_node_get_child(profiler_frame* frame, u16 parent, const char* name) {
+    u16 child = profiler_node_find_child(frame, parent, name);
+    if (child != PROFILER_INVALID_NODE || frame->node_count == PROFILER_MAX_NODES) {
+        return child;
+    }
+
+    child = (u16)frame->node_count++;
+    profiler_node* node = &frame->nodes[child];
+    node->name = name;
+    node->parent = parent;
+    node->first_child = PROFILER_INVALID_NODE;
+    node->next_sibling = frame->nodes[parent].first_child;
+    node->call_count = 0;
+    node->inclusive_time = 0;
+    node->self_time = 0;
+    kzero_memory(node->counters, sizeof(node->counters));
+    kzero_memory(node->self_counters, sizeof(node->self_counters));
+    frame->nodes[parent].first_child = child;
+    return child;
+}
+
+/**
+ * @brief Adds the counters of a zone to its node, and takes them out of its parent's self counters.
+ */
+static void profiler_node_add_counters(profiler_frame* frame, u16 node, u16 parent, const profiler_event* event) {
+    frame->counter_mask |= event->counter_mask;
+    profiler_node* target = &frame->nodes[node];
+    profiler_node* parent_node = &frame->nodes[parent];
+    for (u32 i = 0; i < PERF_COUNTER_MAX; ++i) {
+        target->counters[i] += event->counters[i];
+        target->self_counters[i] += event->counters[i];
+        if (parent != PROFILER_ROOT_NODE) {
+            // Clamped, as a parent whose fiber moved threads has no counters to take from.
+            u64 taken = event->counters[i] < parent_node->self_counters[i] ? event->counters[i] : parent_node->self_counters[i];
+            parent_node->self_counters[i] -= taken;
+        }
+    }
+}
+
+/**
+ * @brief Adds a finished outermost zone to the tree, along with the zones inside it.
+ * @param events The zones inside it in the order they finished, followed by the zone itself.
+ */
+static void profiler_frame_add_zones(profiler_frame* frame, const profiler_event* events, u32 count) {
+    const profiler_event* outer = &events[count - 1];
+    // The node at each depth of the zone last added, whose children are added next.
+    u16 path[PROFILER_MAX_DEPTH];
+    u32 path_length = 0;
+
+    // Walked backwards, each zone comes after its parent.
+    for (i32 i = (i32)count - 1; i >= 0; --i) {
+        const profiler_event* event = &events[i];
+        if (event->depth >= PROFILER_MAX_DEPTH) {
+            // Counted in the time of the ancestor at the deepest depth.
+            continue;
+        }
+
+        u16 parent;
+        u32 depth = event->depth;
+        if (event->start_ticks < outer->start_ticks || event->end_ticks > outer->end_ticks) {
+            // Left behind by a zone whose fiber moved threads; its parent is unknown.
+            parent = PROFILER_ROOT_NODE;
+            depth = 0;
+        } else {
+            // A zone deeper than its parent should be belongs to the deepest known ancestor.
+            if (depth > path_length) {
+                depth = path_length;
+            }
+            parent = depth == 0 ? PROFILER_ROOT_NODE : path[depth - 1];
+        }
+
+        u16 node = profiler_node_get_child(frame, parent, event->name);
+        if (node == PROFILER_INVALID_NODE) {
+            frame->dropped_zone_count++;
+            path_length = depth;
+            continue;
+        }
+
+        f64 duration = platform_ticks_to_seconds(event->end_ticks - event->start_ticks);
+        frame->nodes[node].call_count++;
+        frame->nodes[node].inclusive_time += duration;
+        frame->nodes[node].self_time += duration;
+        if (parent != PROFILER_ROOT_NODE) {
+            frame->nodes[parent].self_time -= duration;
+        }
+        if (event->counter_mask) {
+            profiler_node_add_counters(frame, node, parent, event);
+        }
+        path[depth] = node;
+        path_length = depth + 1;
+    }
+}
+
+/**
+ * @brief Writes out whatever has been collected in the capture buffer.
+ */
+static void profiler_capture_flush() {
+    u64 written = 0;
+    if (state_ptr->capture_buffer_used && !filesystem_write(&state_ptr->capture_file, state_ptr->capture_buffer_used, state_ptr->capture_buffer, &written)) {
+        KERROR("profiler - Failed to write to the capture file.");
+    }
+    state_ptr->capture_buffer_used = 0;
+}
+
+/**
+ * @brief Appends formatted text to the capture, writing it out as the buffer fills up.
+ */
+static void profiler_capture_write(const char* format, ...) {
+    // Long enough for any single event.
+    const u64 max_length = 4096;
+    if (state_ptr->capture_buffer_used + max_length > PROFILER_CAPTURE_BUFFER_SIZE) {
+        profiler_capture_flush();
+    }
+    __builtin_va_list arg_ptr;
+    va_start(arg_ptr, format);
+    i32 length = vsnprintf(state_ptr->capture_buffer + state_ptr->capture_buffer_used, max_length, format, arg_ptr);
+    va_end(arg_ptr);
+    if (length > 0) {
+        state_ptr->capture_buffer_used += (u64)length < max_length ? (u64)length : max_length - 1;
+    }
+}
+
+/**
+ * @brief Copies a name for use in a JSON string, escaping as needed.
+ */
+static const char* profiler_capture_escape(const char* name, char* dest, u64 max) {
+    u64 length = 0;
+    for (const char* c = name; *c && length + 2 < max; ++c) {
+        if (*c == '"' || *c == '\\') {
+            dest[length++] = '\\';
+        }
+        dest[length++] = (u8)*c < 0x20 ? ' ' : *c;
+    }
+    dest[length] = 0;
+    return dest;
+}
+
+// Begins an event, separating it from the one before.
+static void profiler_capture_next_event() {
+    profiler_capture_write(state_ptr->capture_event_count++ ? ",\n" : "\n");
+}
+
+// Capture timestamps are in microseconds.
+static f64 profiler_capture_time(u64 ticks) {
+    return (f64)platform_ticks_to_nanoseconds(ticks - state_ptr->capture_start_ticks) * 0.001;
+}
+
+/**
+ * @brief Writes an event from a thread's buffer to the capture.
+ * @param thread_index The index of the thread's buffer, which is used as its track.
+ */
+static void profiler_capture_event(const profiler_event* event, u32 thread_index, b8 main_thread) {
+    if (event->start_ticks < state_ptr->capture_start_ticks) {
+        return;
+    }
+    if (!state_ptr->capture_thread_named[thread_index]) {
+        state_ptr->capture_thread_named[thread_index] = true;
+        profiler_capture_next_event();
+        if (main_thread) {
+            profiler_capture_write("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"main\"}}", thread_index);
+        } else {
+            profiler_capture_write("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}", thread_index, thread_index);
+        }
+    }
+
+    char name[256];
+    profiler_capture_escape(event->name, name, sizeof(name));
+    profiler_capture_next_event();
+    if (event->type == PROFILER_EVENT_INSTANT) {
+        profiler_capture_write("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                               name, profiler_capture_time(event->start_ticks), thread_index);
+    } else {
+        profiler_capture_write("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+                               name, profiler_capture_time(event->start_ticks), (f64)platform_ticks_to_nanoseconds(event->end_ticks - event->start_ticks) * 0.001, thread_index);
+        if (event->counter_mask) {
+            // Shown alongside the zone when selected.
+            profiler_capture_write(",\"args\":{");
+            b8 first = true;
+            for (u32 i = 0; i < PERF_COUNTER_MAX; ++i) {
+                if (event->counter_mask & (1 << i)) {
+                    profiler_capture_write("%s\"%s\":%llu", first ? "" : ",", counter_names[i], event->counters[i]);
+                    first = false;
+                }
+            }
+            profiler_capture_write("}");
+        }
+        profiler_capture_write("}");
+    }
+}
+
+// Records memory use by tag as a counter, which Perfetto shows as a track per tag.
+static void profiler_capture_memory(u64 ticks) {
+    profiler_capture_next_event();
+    profiler_capture_write("{\"name\":\"memory\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{", profiler_capture_time(ticks));
+    for (u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i) {
+        // Tag names are padded out with spaces.
+        const char* tag_name = get_memory_tag_name(i);
+        u32 length = 0;
+        while (tag_name[length] && tag_name[length] != ' ') {
+            length++;
+        }
+        profiler_capture_write("%s\"%.*s\":%llu", i ? "," : "", length, tag_name, get_memory_tag_usage(i));
+    }
+    profiler_capture_write("}}");
+}
+
+b8 profiler_capture_start(const char* path, u32 frame_count) {
+    if (!state_ptr || state_ptr->capturing || frame_count == 0) {
+        return false;
+    }
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &state_ptr->capture_file)) {
+        KERROR("profiler_capture_start - Unable to open '%s'.", path);
+        return false;
+    }
+
+    state_ptr->capturing = true;
+    state_ptr->capture_frames_remaining = frame_count;
+    state_ptr->capture_start_ticks = platform_get_ticks();
+    state_ptr->capture_event_count = 0;
+    state_ptr->capture_buffer_used = 0;
+    kzero_memory(state_ptr->capture_thread_named, sizeof(state_ptr->capture_thread_named));
+    profiler_capture_write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    KINFO("Capturing %u frames of profiling to '%s'.", frame_count, path);
+    return true;
+}
+
+void profiler_capture_stop() {
+    if (!state_ptr || !state_ptr->capturing) {
+        return;
+    }
+    profiler_capture_write("\n]}\n");
+    profiler_capture_flush();
+    filesystem_close(&state_ptr->capture_file);
+    state_ptr->capturing = false;
+    KINFO("Profiling capture finished with %llu events.", state_ptr->capture_event_count);
+}
+
+b8 profiler_set_counters_enabled(b8 enabled) {
+    if (!state_ptr) {
+        return false;
+    }
+    state_ptr->frame_counters_valid = false;
+    if (!enabled) {
+        // Other threads close theirs on their next zone.
+        state_ptr->counters_enabled = false;
+        platform_perf_counters_close();
+        return false;
+    }
+
+    // Tried on this thread first, as if they can't be opened here they won't be on any other.
+    if (!platform_perf_counters_open()) {
+        KWARN("profiler - Hardware performance counters are unavailable; zones are only timed.");
+        state_ptr->counters_enabled = false;
+        platform_perf_counters_close();
+        return false;
+    }
+    state_ptr->counters_enabled = true;
+    KINFO("profiler - Recording hardware performance counters.");
+    return true;
+}
+
+b8 profiler_is_capturing() {
+    return state_ptr && state_ptr->capturing;
+}
+
+/**
+ * @brief Collects a thread's finished zones into the current frame, and the capture if running.
+ */
+static void profiler_collect(profiler_thread_buffer* buffer, u32 thread_index, b8 main_thread, profiler_frame* frame) {
+    u64 write = __atomic_load_n(&buffer->write, __ATOMIC_ACQUIRE);
+    for (u64 read = buffer->read; read < write; ++read) {
+        const profiler_event* event = &buffer->events[read & (PROFILER_THREAD_EVENT_COUNT - 1)];
+        if (state_ptr->capturing) {
+            profiler_capture_event(event, thread_index, main_thread);
+        }
+        if (event->type != PROFILER_EVENT_ZONE) {
+            continue;
+        }
+        if (buffer->pending_count == PROFILER_MAX_PENDING) {
+            frame->dropped_zone_count++;
+            continue;
+        }
+        buffer->pending[buffer->pending_count++] = *event;
+        if (event->depth == 0) {
+            profiler_frame_add_zones(frame, buffer->pending, buffer->pending_count);
+            buffer->pending_count = 0;
+        }
+    }
+    // Hand the space back to the owning thread.
+    __atomic_store_n(&buffer->read, write, __ATOMIC_RELEASE);
+
+    u32 dropped_count = __atomic_load_n(&buffer->dropped_count, __ATOMIC_RELAXED);
+    frame->dropped_zone_count += dropped_count - buffer->last_dropped_count;
+    buffer->last_dropped_count = dropped_count;
+}
+
+void profiler_frame_end() {
+    if (!state_ptr) {
+        return;
+    }
+
+    profiler_frame* frame = state_ptr->current_frame;
+    profiler_thread_context* context = profiler_thread_context_get();
+    profiler_thread_buffer* main_buffer = context->generation == state_ptr->generation ? context->buffer : 0;
+    u32 count = __atomic_load_n(&state_ptr->buffer_count, __ATOMIC_ACQUIRE);
+    if (count > PROFILER_MAX_THREADS) {
+        count = PROFILER_MAX_THREADS;
+    }
+    for (u32 i = 0; i < count; ++i) {
+        // May still be 0 while being registered.
+        profiler_thread_buffer* buffer = __atomic_load_n(&state_ptr->buffers[i], __ATOMIC_ACQUIRE);
+        if (buffer) {
+            profiler_collect(buffer, i, buffer == main_buffer, frame);
+        }
+    }
+
+    frame->end_ticks = platform_get_ticks();
+    frame->nodes[PROFILER_ROOT_NODE].inclusive_time = platform_ticks_to_seconds(frame->end_ticks - frame->start_ticks);
+
+    // The main thread's counters over the whole frame.
+    u64 counters[PERF_COUNTER_MAX];
+    if (state_ptr->counters_enabled && main_buffer && main_buffer->counter_mask && platform_perf_counters_read(counters)) {
+        if (state_ptr->frame_counters_valid) {
+            profiler_node* root = &frame->nodes[PROFILER_ROOT_NODE];
+            for (u32 i = 0; i < PERF_COUNTER_MAX; ++i) {
+                root->counters[i] = counters[i] - state_ptr->frame_counters[i];
+            }
+            frame->counter_mask |= main_buffer->counter_mask;
+        }
+        kcopy_memory(state_ptr->frame_counters, counters, sizeof(counters));
+        state_ptr->frame_counters_valid = true;
+    } else {
+        state_ptr->frame_counters_valid = false;
+    }
+
+    if (state_ptr->capturing) {
+        profiler_capture_memory(frame->end_ticks);
+        if (--state_ptr->capture_frames_remaining == 0) {
+            profiler_capture_stop();
+        }
+    }
+
+    // The next frame starts where this one ended.
+    state_ptr->last_frame = frame;
+    state_ptr->current_frame = frame == &state_ptr->frames[0] ? &state_ptr->frames[1] : &state_ptr->frames[0];
+    profiler_frame_reset(state_ptr->current_frame, frame->frame_number + 1, frame->end_ticks);
+}
+
+const profiler_frame* profiler_last_frame() {
+    return state_ptr ? state_ptr->last_frame : 0;
+}
+
+static void profiler_report_node(const profiler_frame* frame, u16 index, u32 depth) {
+    const profiler_node* node = &frame->nodes[index];
+    if (frame->counter_mask) {
+        const u64* counters = node->counters;
+        f64 ipc = counters[PERF_COUNTER_CYCLES] ? (f64)counters[PERF_COUNTER_INSTRUCTIONS] / (f64)counters[PERF_COUNTER_CYCLES] : 0;
+        KINFO("%*s%s: %u calls, %.3fms inclusive, %.3fms self, %llu cycles, %.2f IPC, %llu cache misses, %llu branch misses",
+              depth * 2, "", node->name, node->call_count, node->inclusive_time * 1000.0, node->self_time * 1000.0,
+              counters[PERF_COUNTER_CYCLES], ipc, counters[PERF_COUNTER_CACHE_MISSES], counters[PERF_COUNTER_BRANCH_MISSES]);
+    } else {
+        KINFO("%*s%s: %u calls, %.3fms inclusive, %.3fms self",
+              depth * 2, "", node->name, node->call_count, node->inclusive_time * 1000.0, node->self_time * 1000.0);
+    }
+    for (u16 child = node->first_child; child != PROFILER_INVALID_NODE; child = frame->nodes[child].next_sibling) {
+        profiler_report_node(frame, child, depth + 1);
+    }
+}
+
+void profiler_report() {
+    const profiler_frame* frame = profiler_last_frame();
+    if (!frame) {
+        return;
+    }
+    KINFO("Profile of frame %llu (%u zones dropped):", frame->frame_number, frame->dropped_zone_count);
+    profiler_report_node(frame, PROFILER_ROOT_NODE, 0);
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "defines.h"
+#include "platform/platform.h"
+
+// Set to 0 to compile every KPROFILE_* macro out, leaving no trace of the zones in the code.
+#define KPROFILE_ENABLED 1
+
+//.. no profiling in release builds
+#if KRELEASE == 1
+#undef KPROFILE_ENABLED
+#define KPROFILE_ENABLED 0
+#endif
+
+// The most distinct zones, by call path, in a frame's call tree. Any beyond this are counted as dropped.
+#define PROFILER_MAX_NODES 1024
+// The deepest zones may nest. Deeper zones are attributed to their ancestor at this depth.
+#define PROFILER_MAX_DEPTH 32
+// The root of every frame's call tree.
+#define PROFILER_ROOT_NODE 0
+#define PROFILER_INVALID_NODE 0xFFFF
+
+/**
+ * @brief A zone in progress, as returned by profiler_zone_begin. Lives on the stack of
+ * the code being profiled.
+ */
+typedef struct profiler_zone {
+    // 0 if the zone isn't being recorded, such as before the profiler is initialized.
+    const char* name;
+    // platform_get_ticks when the zone began.
+    u64 start_ticks;
+    u32 depth;
+    // The thread the zone began on, and its hardware counters at the time if they're being recorded.
+    u32 thread_index;
+    u32 counter_mask;
+    u64 start_counters[PERF_COUNTER_MAX];
+} profiler_zone;
+
+/**
+ * @brief A zone in a frame's call tree, aggregating every call made to it along the same
+ * path from the root. All times are in seconds.
+ */
+typedef struct profiler_node {
+    const char* name;
+    u16 parent;
+    u16 first_child;
+    u16 next_sibling;
+    u32 call_count;
+    // The time from the start to the end of each call, summed.
+    f64 inclusive_time;
+    // The inclusive time less that of the zone's children.
+    f64 self_time;
+    // Hardware counters over the calls, indexed by perf_counter, if recorded. See profiler_frame.counter_mask.
+    u64 counters[PERF_COUNTER_MAX];
+    // The counters less those of the zone's children.
+    u64 self_counters[PERF_COUNTER_MAX];
+} profiler_node;
+
+/**
+ * @brief The call tree of one frame. Zones on every thread are merged into the same
+ * tree, with those not inside another zone as children of the root. A zone is counted in
+ * the frame its outermost enclosing zone finishes in.
+ */
+typedef struct profiler_frame {
+    u64 frame_number;
+    // platform_get_ticks when the frame started and ended.
+    u64 start_ticks;
+    u64 end_ticks;
+    // The number of nodes, including the root.
+    u32 node_count;
+    // Zones which couldn't be recorded, as a thread's buffer or the tree was full.
+    u32 dropped_zone_count;
+    // The hardware counters recorded in the frame, with a bit set for each perf_counter. The
+    // root has the main thread's counters over the whole frame.
+    u32 counter_mask;
+    profiler_node nodes[PROFILER_MAX_NODES];
+} profiler_frame;
+
+/**
+ * @brief Initializes the profiler. Call twice; once with state = 0 to get required memory size,
+ * then a second time passing allocated memory to state.
+ *
+ * @param memory_requirement A pointer to hold the required memory size of internal state.
+ * @param state 0 if just requesting memory requirement, otherwise allocated block of memory.
+ * @returns True on success; otherwise false.
+ */
+b8 profiler_system_initialize(u64* memory_requirement, void* state);
+
+/**
+ * @brief Shuts the profiler down. Zones still running on other threads at this point are lost.
+ * @param state The state block of memory.
+ */
+void profiler_system_shutdown(void* state);
+
+/**
+ * @brief Starts a zone on the calling thread. Use the KPROFILE_* macros rather than calling this.
+ * @param name The name of the zone. Must outlive the profiler, such as a string literal.
+ * @returns The zone, to be passed to profiler_zone_end.
+ */
+KAPI profiler_zone profiler_zone_begin(const char* name);
+
+/**
+ * @brief Ends a zone, recording it in the calling thread's buffer. Zones on a thread must
+ * end in the reverse order they began in.
+ * @param zone A pointer to the zone to end.
+ */
+KAPI void profiler_zone_end(profiler_zone* zone);
+
+/**
+ * @brief Ends the current frame, collecting the zones finished on every thread since the
+ * last call into the frame's call tree. Call once per frame, on the main thread.
+ */
+KAPI void profiler_frame_end();
+
+/**
+ * @brief Obtains the call tree of the last frame ended.
+ * @returns A pointer to the frame, or 0 if there isn't one yet. Only valid until the next frame ends.
+ */
+KAPI const profiler_frame* profiler_last_frame();
+
+/**
+ * @brief Finds a child of a node by name.
+ * @returns The index of the child, or PROFILER_INVALID_NODE if there is none.
+ */
+KAPI u16 profiler_node_find_child(const profiler_frame* frame, u16 parent, const char* name);
+
+/**
+ * @brief Logs the call tree of the last frame ended.
+ */
+KAPI void profiler_report();
+
+/**
+ * @brief Starts or stops recording hardware performance counters (cycles, instructions, cache
+ * and branch misses) alongside the time of each zone, so slow zones can be told apart by
+ * what they were waiting on. Each thread's counters are opened on its next zone. Reading them
+ * costs a system call either side of every zone, so this is off by default.
+ *
+ * Zones whose fiber moved threads aren't given counters, nor are zones on threads where
+ * the counters couldn't be opened.
+ *
+ * @param enabled True to record counters; otherwise false.
+ * @returns True if counters are being recorded; otherwise false if disabled or unavailable,
+ * such as in containers or on platforms without support.
+ */
+KAPI b8 profiler_set_counters_enabled(b8 enabled);
+
+/**
+ * @brief Records a point in time on the calling thread, such as a swapchain being recreated.
+ * Only kept by captures. Use KPROFILE_INSTANT rather than calling this.
+ * @param name The name of the event. Must outlive the profiler, such as a string literal.
+ */
+KAPI void profiler_instant(const char* name);
+
+/**
+ * @brief Captures the next frames to a Chrome Trace Event JSON file, which loads in Perfetto
+ * and chrome://tracing. Each thread has its own track of zones and instant events, and memory
+ * use by tag is recorded as counters at the end of every frame.
+ *
+ * @param path The path of the file to write.
+ * @param frame_count The number of frames to capture, after which the file is finished.
+ * @returns True if the capture started; otherwise false if one is already running or the file couldn't be opened.
+ */
+KAPI b8 profiler_capture_start(const char* path, u32 frame_count);
+
+/**
+ * @brief Finishes the running capture early, if any. Also done on shutdown.
+ */
+KAPI void profiler_capture_stop();
+
+/**
+ * @brief Indicates if a capture is running.
+ */
+KAPI b8 profiler_is_capturing();
+
+#if KPROFILE_ENABLED == 1
+#define KPROFILE_CONCAT_INNER(a, b) a##b
+#define KPROFILE_CONCAT(a, b) KPROFILE_CONCAT_INNER(a, b)
+
+//.. profiles from here to the end of the enclosing scope
+#define KPROFILE_SCOPE(name) \
+    profiler_zone KPROFILE_CONCAT(kprofile_zone_, __LINE__) __attribute__((cleanup(profiler_zone_end))) = profiler_zone_begin(name)
+
+//.. profiles from here to the matching KPROFILE_END, for zones which don't follow a scope
+#define KPROFILE_BEGIN(zone, name) profiler_zone zone = profiler_zone_begin(name)
+#define KPROFILE_END(zone) profiler_zone_end(&zone)
+
+//.. ends the frame, collecting its call tree
+#define KPROFILE_FRAME_END() profiler_frame_end()
+
+//.. marks a point in time on the calling thread's track in captures
+#define KPROFILE_INSTANT(name) profiler_instant(name)
+#else
+#define KPROFILE_SCOPE(name)
+#define KPROFILE_BEGIN(zone, name)
+#define KPROFILE_END(zone)
+#define KPROFILE_FRAME_END()
+#define KPROFILE_INSTANT(name)
+#endif
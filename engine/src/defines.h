@@ -106,5 +106,43 @@ STATIC_ASSERT(sizeof(f64) == 8, "Expected f64 to be 8 bytes.");
 #define KNOINLINE __declspec(noinline)
 #else
 #define KINLINE static inline
-#define KNOINLINE
+#define KNOINLINE __attribute__((noinline))
+#endif
+
+// Thread-local storage
+#ifdef _MSC_VER
+#define KTHREAD_LOCAL __declspec(thread)
+#else
+#define KTHREAD_LOCAL __thread
+#endif
+
+/**
+ * Defines a function returning the address of a thread-local variable on whichever thread
+ * calls it. Code which may run on a fiber must look thread-locals up through one of these
+ * each time, as fibers can be resumed on a different thread than they were parked on. The
+ * compiler takes a thread-local's address to be the same throughout a function, and will
+ * reuse the result of a plain getter too, so the address is passed through an empty
+ * volatile asm statement; the getter then has a side effect and every call is made.
+ */
+#ifdef _MSC_VER
+#define KTHREAD_LOCAL_ACCESSOR(type, name, variable) \
+    static __declspec(noinline) type* name() {       \
+        _ReadWriteBarrier();                         \
+        return &(variable);                          \
+    }
+#else
+#if defined(__has_attribute)
+#if __has_attribute(noipa)
+#define KTHREAD_LOCAL_NOIPA __attribute__((noipa))
+#endif
+#endif
+#ifndef KTHREAD_LOCAL_NOIPA
+#define KTHREAD_LOCAL_NOIPA
+#endif
+#define KTHREAD_LOCAL_ACCESSOR(type, name, variable)                 \
+    static __attribute__((noinline)) KTHREAD_LOCAL_NOIPA type* name() { \
+        type* address = &(variable);                                 \
+        __asm__ volatile("" : "+r"(address));                        \
+        return address;                                              \
+    }
 #endif
\ No newline at end of file
@@ -14,7 +14,7 @@ extern b8 create_game(game* out_game);
  */
 int main (void) {
 
-    game game_inst;
+    game game_inst = {0};
     if (!create_game(&game_inst)) {
         KFATAL("Could not create game!");
         return -1;
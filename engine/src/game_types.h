@@ -5,8 +5,14 @@
 typedef struct game {
     application_config app_config;
     b8 (*initialize)(struct game* game_inst);
+    // Runs as a task of the frame graph, always on the main thread.
     b8 (*update)(struct game* game_inst, f32 delta_time);
-    b8 (*render)(struct game* game_inst, f32 delta_time);
+    /**
+     * Runs as a task of the frame graph, always on the main thread, after update.
+     * alpha is how far between the last two updates to render, with fixed updates. Otherwise
+     * it's always 1.
+     */
+    b8 (*render)(struct game* game_inst, f32 delta_time, f32 alpha);
     void (*on_resize)(struct game* game_inst, u32 width, u32 height);
     // Game-specific game state. Created and managed by the game.
     void* state;
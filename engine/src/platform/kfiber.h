@@ -0,0 +1,54 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief A fiber is a user-space execution context with its own stack. Switching
+ * between fibers is cooperative and never enters the kernel scheduler, which is
+ * what lets the job system park a job mid-execution and run something else on
+ * the same worker thread.
+ */
+typedef struct kfiber {
+    // Platform-specific fiber data.
+    void* internal_data;
+} kfiber;
+
+// A function pointer to be invoked when a fiber is first switched to. Must never return.
+typedef void (*pfn_fiber_start)(void*);
+
+/**
+ * @brief Converts the calling thread into a fiber so that it can switch to and
+ * from other fibers. Must be called on a thread before it switches to any fiber.
+ * @param out_fiber A pointer to hold the fiber representing the thread.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 kfiber_convert_current_thread(kfiber* out_fiber);
+
+/**
+ * @brief Reverts a fiber created with kfiber_convert_current_thread back to a plain thread.
+ * Must be called on the same thread, while that fiber is the one running.
+ */
+KAPI void kfiber_revert_current_thread(kfiber* fiber);
+
+/**
+ * @brief Creates a new fiber with its own stack. The stack is bounded by a guard
+ * page so that an overflow faults immediately instead of corrupting other memory.
+ * @param stack_size The usable size of the stack in bytes. Rounded up to the page size.
+ * @param start_function_ptr The function invoked the first time the fiber is switched to. Must never return.
+ * @param params A pointer to any data to be passed to start_function_ptr. Optional.
+ * @param out_fiber A pointer to hold the created fiber.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 kfiber_create(u64 stack_size, pfn_fiber_start start_function_ptr, void* params, kfiber* out_fiber);
+
+/**
+ * @brief Destroys the given fiber and releases its stack. Must not be the running fiber.
+ */
+KAPI void kfiber_destroy(kfiber* fiber);
+
+/**
+ * @brief Saves the current execution context into from and resumes to.
+ * @param from The currently-running fiber.
+ * @param to The fiber to switch to.
+ */
+KAPI void kfiber_switch(kfiber* from, kfiber* to);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief A mutex to be used for synchronization purposes. A mutex (or
+ * mutual exclusion) is used to limit access to a resource when there are
+ * multiple threads of execution around that resource.
+ */
+typedef struct kmutex {
+    void* internal_data;
+} kmutex;
+
+/**
+ * @brief Creates a mutex.
+ * @param out_mutex A pointer to hold the created mutex.
+ * @returns True if created successfully; otherwise false.
+ */
+KAPI b8 kmutex_create(kmutex* out_mutex);
+
+/**
+ * @brief Destroys the provided mutex.
+ */
+KAPI void kmutex_destroy(kmutex* mutex);
+
+/**
+ * @brief Creates a mutex lock. Blocks until the lock is obtained.
+ * @returns True if locked successfully; otherwise false.
+ */
+KAPI b8 kmutex_lock(kmutex* mutex);
+
+/**
+ * @brief Unlocks the given mutex.
+ * @returns True if unlocked successfully; otherwise false.
+ */
+KAPI b8 kmutex_unlock(kmutex* mutex);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief A counting semaphore. Used to put threads to sleep until there is
+ * work for them, rather than having them spin.
+ */
+typedef struct ksemaphore {
+    void* internal_data;
+} ksemaphore;
+
+/**
+ * @brief Creates a semaphore.
+ * @param out_semaphore A pointer to hold the created semaphore.
+ * @param max_count The maximum count the semaphore may reach.
+ * @param start_count The count the semaphore starts with.
+ * @returns True if created successfully; otherwise false.
+ */
+KAPI b8 ksemaphore_create(ksemaphore* out_semaphore, u32 max_count, u32 start_count);
+
+/**
+ * @brief Destroys the provided semaphore.
+ */
+KAPI void ksemaphore_destroy(ksemaphore* semaphore);
+
+/**
+ * @brief Increments the semaphore count, waking up a waiting thread if there is one.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 ksemaphore_signal(ksemaphore* semaphore);
+
+/**
+ * @brief Decrements the semaphore count, blocking for up to timeout_ms if the count is zero.
+ * @returns True if the semaphore was acquired; false on timeout or error.
+ */
+KAPI b8 ksemaphore_wait(ksemaphore* semaphore, u64 timeout_ms);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief Represents a process thread in the system to be used for work.
+ * Generally should not be created directly in user code; the job system
+ * owns the engine's worker threads.
+ */
+typedef struct kthread {
+    // Platform-specific thread data.
+    void* internal_data;
+    u64 thread_id;
+} kthread;
+
+// A function pointer to be invoked when the thread starts.
+typedef u32 (*pfn_thread_start)(void*);
+
+/**
+ * @brief Creates a new thread, immediately calling the function pointed to.
+ *
+ * @param start_function_ptr The pointer to the function to be invoked immediately. Required.
+ * @param params A pointer to any data to be passed to the start_function_ptr. Optional. Pass 0/NULL if not used.
+ * @param auto_detach Indicates if the thread should immediately release its resources when the work is complete. If true, out_thread is not set.
+ * @param out_thread A pointer to hold the created thread, if auto_detach is false.
+ * @return True if successfully created; otherwise false.
+ */
+KAPI b8 kthread_create(pfn_thread_start start_function_ptr, void* params, b8 auto_detach, kthread* out_thread);
+
+/**
+ * @brief Destroys the given thread.
+ */
+KAPI void kthread_destroy(kthread* thread);
+
+/**
+ * @brief Detaches the thread, automatically releasing resources when work is complete.
+ */
+KAPI void kthread_detach(kthread* thread);
+
+/**
+ * @brief Blocks until the given thread has finished its work.
+ * @return True if the thread was joined successfully; otherwise false.
+ */
+KAPI b8 kthread_wait(kthread* thread);
+
+/**
+ * @brief Gives the remainder of the calling thread's time slice back to the OS.
+ */
+KAPI void kthread_yield();
+
+/**
+ * @brief Obtains the identifier for the current thread.
+ */
+KAPI u64 platform_current_thread_id();
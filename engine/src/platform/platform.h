@@ -26,7 +26,77 @@ void platform_console_write_error(const char* message, u8 colour);
 
 f64 platform_get_absolute_time();
 
+/**
+ * @brief Obtains a timestamp in ticks, for timing short spans cheaply and precisely. Read
+ * straight from the CPU's invariant timestamp counter where there is one, calibrated
+ * against the OS clock on first use, and from the OS's monotonic clock otherwise. Ticks
+ * only mean anything relative to each other, and are converted with the functions below.
+ * @returns The current tick count.
+ */
+u64 platform_get_ticks();
+
+/**
+ * @brief Obtains the number of ticks per second counted by platform_get_ticks.
+ */
+u64 platform_get_tick_frequency();
+
+/**
+ * @brief Converts a number of ticks, such as the difference between two timestamps, to nanoseconds.
+ */
+u64 platform_ticks_to_nanoseconds(u64 ticks);
+
+/**
+ * @brief Converts a number of ticks, such as the difference between two timestamps, to seconds.
+ */
+f64 platform_ticks_to_seconds(u64 ticks);
+
+// Hardware performance counters, counted per thread in user mode.
+typedef enum perf_counter {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    // Misses in the last level cache.
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+
+    PERF_COUNTER_MAX
+} perf_counter;
+
+/**
+ * @brief Opens the hardware performance counters of the calling thread, which stay open until
+ * platform_perf_counters_close is called on it. Threads which may have opened them must do so
+ * before they exit. Does nothing if they're already open. Counters are often
+ * unavailable, such as in containers and virtual machines, or where the OS doesn't allow
+ * them, and aren't supported at all on some platforms.
+ * @returns A mask of the counters opened, with a bit set for each perf_counter. 0 if none could be.
+ */
+u32 platform_perf_counters_open();
+
+/**
+ * @brief Closes the calling thread's hardware performance counters, if open. They may be
+ * opened again afterwards.
+ */
+void platform_perf_counters_close();
+
+/**
+ * @brief Reads the calling thread's hardware performance counters.
+ * @param out_values An array of PERF_COUNTER_MAX values to hold the counts. Counters which
+ * aren't open read as 0.
+ * @returns True if the counters were read; otherwise false if none are open.
+ */
+b8 platform_perf_counters_read(u64* out_values);
+
+// Obtains the number of logical processors available to the process.
+i32 platform_get_processor_count();
+
 // Sleep on the thread for the provided ms. This blocks the main thread.
 // Should only be used for giving time back to the OS for unused update power.
 // Therefore it is not exported.
-void platform_sleep(u64 ms);
\ No newline at end of file
+void platform_sleep(u64 ms);
+
+/**
+ * @brief Sleeps on the thread until platform_get_absolute_time reaches the given time,
+ * waking as close to it as the OS allows. Returns straight away if it has already passed.
+ * Sleeping to an absolute time, rather than for a duration, keeps any delay in getting
+ * here from adding to the wait.
+ */
+void platform_sleep_until(f64 absolute_time);
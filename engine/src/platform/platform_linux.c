@@ -6,9 +6,15 @@
 #include "core/logger.h"
 #include "core/event.h"
 #include "core/input.h"
+#include "core/profiler.h"
 
 #include "containers/darray.h"
 
+#include "platform/kthread.h"
+#include "platform/kmutex.h"
+#include "platform/ksemaphore.h"
+#include "platform/kfiber.h"
+
 #include <xcb/xcb.h>
 #include <X11/keysym.h>
 #include <X11/XKBlib.h>  // sudo apt-get install libx11-dev
@@ -26,6 +32,28 @@
 #include <stdio.h>
 #include <string.h>
 
+// Threading/fibers
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <unistd.h>
+
+// Performance counters
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+// Timestamp counter
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define KPLATFORM_HAS_TSC 1
+#else
+#define KPLATFORM_HAS_TSC 0
+#endif
+
 // For surface creation
 #define VK_USE_PLATFORM_XCB_KHR
 #include <vulkan/vulkan.h>
@@ -183,6 +211,7 @@ void platform_shutdown(platform_state* plat_state) {
 }
 
 b8 platform_pump_messages(platform_state* plat_state) {
+    KPROFILE_SCOPE("platform_pump_messages");
     // Simply cold-cast to the known type.
     internal_state* state = (internal_state*)plat_state->internal_state;
 
@@ -252,12 +281,12 @@ b8 platform_pump_messages(platform_state* plat_state) {
                 // The application layer can decide what to do with this.
                 xcb_configure_notify_event_t *configure_event = (xcb_configure_notify_event_t *)event;
 
-                // Fire the event. The application layer should pick this up, but not handle it
+                // Post the event. The application layer should pick this up, but not handle it
                 // as it shouldn be visible to other parts of the application.
                 event_context context;
                 context.data.u16[0] = configure_event->width;
                 context.data.u16[1] = configure_event->height;
-                event_fire(EVENT_CODE_RESIZED, 0, context);
+                event_post(EVENT_CODE_RESIZED, 0, context);
             } break;
 
             case XCB_CLIENT_MESSAGE: {
@@ -311,6 +340,100 @@ f64 platform_get_absolute_time() {
     return now.tv_sec + now.tv_nsec * 0.000000001;
 }
 
+// How long the timestamp counter is measured against the OS clock for, in nanoseconds.
+#define TICK_CALIBRATION_TIME_NS 10000000ULL
+
+typedef struct tick_source {
+    // Set if ticks come from the timestamp counter, otherwise they're CLOCK_MONOTONIC nanoseconds.
+    b8 use_tsc;
+    u64 frequency;
+    f64 seconds_per_tick;
+} tick_source;
+
+static tick_source ticks;
+static pthread_once_t ticks_once = PTHREAD_ONCE_INIT;
+
+static u64 monotonic_nanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000000ULL + (u64)now.tv_nsec;
+}
+
+#if KPLATFORM_HAS_TSC
+/**
+ * @brief Reads the OS clock along with the timestamp counter, taking the counter either side
+ * and using the midpoint, so the time spent reading the clock doesn't skew the calibration.
+ */
+static u64 tick_source_sample(u64* out_tsc) {
+    u64 before = __rdtsc();
+    u64 ns = monotonic_nanoseconds();
+    u64 after = __rdtsc();
+    *out_tsc = before + (after - before) / 2;
+    return ns;
+}
+
+/**
+ * @brief Measures the frequency of the timestamp counter, if it runs at a constant rate
+ * whatever the core's power state, as only then is it usable as a clock.
+ * @returns The frequency in ticks per second, or 0 if the counter can't be used.
+ */
+static u64 tick_source_calibrate_tsc() {
+    u32 eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8))) {
+        // Not invariant. Virtual machines often don't report it either.
+        return 0;
+    }
+
+    u64 start_tsc, end_tsc;
+    u64 start_ns = tick_source_sample(&start_tsc);
+    struct timespec wait = {0, (long)TICK_CALIBRATION_TIME_NS};
+    while (nanosleep(&wait, &wait) == -1 && errno == EINTR) {
+    }
+    u64 end_ns = tick_source_sample(&end_tsc);
+    if (end_ns <= start_ns || end_tsc <= start_tsc) {
+        return 0;
+    }
+    return (u64)((f64)(end_tsc - start_tsc) * 1000000000.0 / (f64)(end_ns - start_ns));
+}
+#endif
+
+static void tick_source_setup() {
+#if KPLATFORM_HAS_TSC
+    ticks.frequency = tick_source_calibrate_tsc();
+    ticks.use_tsc = ticks.frequency != 0;
+#endif
+    if (!ticks.use_tsc) {
+        ticks.frequency = 1000000000ULL;
+    }
+    ticks.seconds_per_tick = 1.0 / (f64)ticks.frequency;
+}
+
+u64 platform_get_ticks() {
+    pthread_once(&ticks_once, tick_source_setup);
+#if KPLATFORM_HAS_TSC
+    if (ticks.use_tsc) {
+        return __rdtsc();
+    }
+#endif
+    return monotonic_nanoseconds();
+}
+
+u64 platform_get_tick_frequency() {
+    pthread_once(&ticks_once, tick_source_setup);
+    return ticks.frequency;
+}
+
+u64 platform_ticks_to_nanoseconds(u64 count) {
+    pthread_once(&ticks_once, tick_source_setup);
+    // Split up so the multiplication can't overflow.
+    return (count / ticks.frequency) * 1000000000ULL + (count % ticks.frequency) * 1000000000ULL / ticks.frequency;
+}
+
+f64 platform_ticks_to_seconds(u64 count) {
+    pthread_once(&ticks_once, tick_source_setup);
+    return (f64)count * ticks.seconds_per_tick;
+}
+
 void platform_sleep(u64 ms) {
 #if _POSIX_C_SOURCE >= 199309L
     struct timespec ts;
@@ -325,6 +448,366 @@ void platform_sleep(u64 ms) {
 #endif
 }
 
+void platform_sleep_until(f64 absolute_time) {
+    // The same clock as platform_get_absolute_time.
+    struct timespec ts;
+    ts.tv_sec = (time_t)absolute_time;
+    ts.tv_nsec = (long)((absolute_time - (f64)ts.tv_sec) * 1000000000.0);
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    // Interrupted sleeps pick up where they left off, as the deadline doesn't move.
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR) {
+    }
+}
+
+// The open performance counters of a thread, read together as a group.
+typedef struct perf_counter_group {
+    b8 opened;
+    i32 leader_fd;
+    u32 mask;
+    // The number of counters in the group, and which perf_counter each is, in the order they're read.
+    u32 count;
+    u8 counters[PERF_COUNTER_MAX];
+    i32 fds[PERF_COUNTER_MAX];
+} perf_counter_group;
+
+static KTHREAD_LOCAL perf_counter_group perf_counters;
+
+// NOTE: Counters are read from fibers too.
+KTHREAD_LOCAL_ACCESSOR(perf_counter_group, perf_counter_group_get, perf_counters)
+
+u32 platform_perf_counters_open() {
+    perf_counter_group* group = perf_counter_group_get();
+    if (group->opened) {
+        return group->mask;
+    }
+    group->opened = true;
+    group->leader_fd = -1;
+
+    static const u64 configs[PERF_COUNTER_MAX] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES};
+    for (u32 i = 0; i < PERF_COUNTER_MAX; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        // User mode only, which is all that's allowed without privileges on most systems.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // So the whole group is read with one call.
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        // This thread, on any CPU.
+        i32 fd = (i32)syscall(SYS_perf_event_open, &attr, 0, -1, group->leader_fd, PERF_FLAG_FD_CLOEXEC);
+        if (fd == -1) {
+            // Left out, leaving the rest. Nothing is likely to open if the first fails.
+            if (i == 0) {
+                KDEBUG("Hardware performance counters unavailable: %s.", strerror(errno));
+            }
+            continue;
+        }
+        if (group->leader_fd == -1) {
+            group->leader_fd = fd;
+        }
+        group->fds[group->count] = fd;
+        group->counters[group->count] = (u8)i;
+        group->count++;
+        group->mask |= 1 << i;
+    }
+    return group->mask;
+}
+
+void platform_perf_counters_close() {
+    perf_counter_group* group = perf_counter_group_get();
+    // Members first, then the leader.
+    for (u32 i = group->count; i > 0; --i) {
+        close(group->fds[i - 1]);
+    }
+    memset(group, 0, sizeof(perf_counter_group));
+}
+
+b8 platform_perf_counters_read(u64* out_values) {
+    perf_counter_group* group = perf_counter_group_get();
+    memset(out_values, 0, sizeof(u64) * PERF_COUNTER_MAX);
+    if (group->count == 0) {
+        return false;
+    }
+
+    // The number of counters, followed by their values.
+    u64 data[1 + PERF_COUNTER_MAX];
+    ssize_t size = read(group->leader_fd, data, sizeof(data));
+    if (size < (ssize_t)sizeof(u64)) {
+        return false;
+    }
+    u64 count = data[0] < group->count ? data[0] : group->count;
+    for (u64 i = 0; i < count; ++i) {
+        out_values[group->counters[i]] = data[1 + i];
+    }
+    return true;
+}
+
+i32 platform_get_processor_count() {
+    i32 count = (i32)sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+}
+
+// NOTE: Begin threads
+b8 kthread_create(pfn_thread_start start_function_ptr, void *params, b8 auto_detach, kthread *out_thread) {
+    if (!start_function_ptr) {
+        return false;
+    }
+
+    // pthread_create uses a function pointer that returns void*, so cold-cast to this type.
+    pthread_t thread;
+    i32 result = pthread_create(&thread, 0, (void *(*)(void *))start_function_ptr, params);
+    if (result != 0) {
+        KERROR("Failed to create thread. pthread_create returned %i.", result);
+        return false;
+    }
+
+    if (auto_detach) {
+        pthread_detach(thread);
+        return true;
+    }
+
+    out_thread->thread_id = (u64)thread;
+    out_thread->internal_data = (void *)thread;
+    return true;
+}
+
+void kthread_destroy(kthread *thread) {
+    if (thread && thread->internal_data) {
+        pthread_cancel((pthread_t)thread->internal_data);
+        thread->internal_data = 0;
+        thread->thread_id = 0;
+    }
+}
+
+void kthread_detach(kthread *thread) {
+    if (thread && thread->internal_data) {
+        pthread_detach((pthread_t)thread->internal_data);
+        thread->internal_data = 0;
+    }
+}
+
+b8 kthread_wait(kthread *thread) {
+    if (thread && thread->internal_data) {
+        i32 result = pthread_join((pthread_t)thread->internal_data, 0);
+        thread->internal_data = 0;
+        thread->thread_id = 0;
+        return result == 0;
+    }
+    return false;
+}
+
+void kthread_yield() {
+    sched_yield();
+}
+
+u64 platform_current_thread_id() {
+    return (u64)pthread_self();
+}
+// NOTE: End threads.
+
+// NOTE: Begin mutexes
+b8 kmutex_create(kmutex *out_mutex) {
+    if (!out_mutex) {
+        return false;
+    }
+
+    pthread_mutex_t *mutex = platform_allocate(sizeof(pthread_mutex_t), false);
+    if (pthread_mutex_init(mutex, 0) != 0) {
+        KERROR("Failed to create mutex.");
+        platform_free(mutex, false);
+        return false;
+    }
+
+    out_mutex->internal_data = mutex;
+    return true;
+}
+
+void kmutex_destroy(kmutex *mutex) {
+    if (mutex && mutex->internal_data) {
+        pthread_mutex_destroy((pthread_mutex_t *)mutex->internal_data);
+        platform_free(mutex->internal_data, false);
+        mutex->internal_data = 0;
+    }
+}
+
+b8 kmutex_lock(kmutex *mutex) {
+    if (!mutex || !mutex->internal_data) {
+        return false;
+    }
+    return pthread_mutex_lock((pthread_mutex_t *)mutex->internal_data) == 0;
+}
+
+b8 kmutex_unlock(kmutex *mutex) {
+    if (!mutex || !mutex->internal_data) {
+        return false;
+    }
+    return pthread_mutex_unlock((pthread_mutex_t *)mutex->internal_data) == 0;
+}
+// NOTE: End mutexes.
+
+// NOTE: Begin semaphores
+b8 ksemaphore_create(ksemaphore *out_semaphore, u32 max_count, u32 start_count) {
+    if (!out_semaphore) {
+        return false;
+    }
+
+    // NOTE: POSIX semaphores have no upper bound other than SEM_VALUE_MAX, so max_count is not used.
+    sem_t *semaphore = platform_allocate(sizeof(sem_t), false);
+    if (sem_init(semaphore, 0, start_count) != 0) {
+        KERROR("Failed to create semaphore.");
+        platform_free(semaphore, false);
+        return false;
+    }
+
+    out_semaphore->internal_data = semaphore;
+    return true;
+}
+
+void ksemaphore_destroy(ksemaphore *semaphore) {
+    if (semaphore && semaphore->internal_data) {
+        sem_destroy((sem_t *)semaphore->internal_data);
+        platform_free(semaphore->internal_data, false);
+        semaphore->internal_data = 0;
+    }
+}
+
+b8 ksemaphore_signal(ksemaphore *semaphore) {
+    if (!semaphore || !semaphore->internal_data) {
+        return false;
+    }
+    return sem_post((sem_t *)semaphore->internal_data) == 0;
+}
+
+b8 ksemaphore_wait(ksemaphore *semaphore, u64 timeout_ms) {
+    if (!semaphore || !semaphore->internal_data) {
+        return false;
+    }
+
+    // sem_timedwait takes an absolute CLOCK_REALTIME deadline.
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    // Retry if interrupted by a signal.
+    i32 result;
+    do {
+        result = sem_timedwait((sem_t *)semaphore->internal_data, &deadline);
+    } while (result != 0 && errno == EINTR);
+    return result == 0;
+}
+// NOTE: End semaphores.
+
+// NOTE: Begin fibers
+typedef struct linux_fiber {
+    ucontext_t context;
+    // Base of the mapping, including the guard page. 0 for converted threads.
+    void *mapping;
+    u64 mapping_size;
+    pfn_fiber_start start_function_ptr;
+    void *params;
+} linux_fiber;
+
+// makecontext only passes int arguments, so the fiber pointer is split in two.
+static void linux_fiber_trampoline(u32 ptr_low, u32 ptr_high) {
+    linux_fiber *fiber = (linux_fiber *)(((u64)ptr_high << 32) | (u64)ptr_low);
+    fiber->start_function_ptr(fiber->params);
+
+    // Returning would end the thread with uc_link == 0.
+    KFATAL("Fiber start function returned. This is not allowed.");
+    abort();
+}
+
+b8 kfiber_convert_current_thread(kfiber *out_fiber) {
+    if (!out_fiber) {
+        return false;
+    }
+
+    // The thread's own stack is used; the context is filled in on the first switch away.
+    linux_fiber *fiber = platform_allocate(sizeof(linux_fiber), false);
+    platform_zero_memory(fiber, sizeof(linux_fiber));
+    out_fiber->internal_data = fiber;
+    return true;
+}
+
+void kfiber_revert_current_thread(kfiber *fiber) {
+    if (fiber && fiber->internal_data) {
+        platform_free(fiber->internal_data, false);
+        fiber->internal_data = 0;
+    }
+}
+
+b8 kfiber_create(u64 stack_size, pfn_fiber_start start_function_ptr, void *params, kfiber *out_fiber) {
+    if (!out_fiber || !start_function_ptr) {
+        return false;
+    }
+
+    u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+    stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+
+    // Reserve the stack plus one guard page at the low end, since the stack grows downward.
+    u64 mapping_size = stack_size + page_size;
+    void *mapping = mmap(0, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (mapping == MAP_FAILED) {
+        KERROR("Failed to map fiber stack of %llu bytes.", mapping_size);
+        return false;
+    }
+    if (mprotect(mapping, page_size, PROT_NONE) != 0) {
+        KERROR("Failed to protect fiber stack guard page.");
+        munmap(mapping, mapping_size);
+        return false;
+    }
+
+    linux_fiber *fiber = platform_allocate(sizeof(linux_fiber), false);
+    platform_zero_memory(fiber, sizeof(linux_fiber));
+    fiber->mapping = mapping;
+    fiber->mapping_size = mapping_size;
+    fiber->start_function_ptr = start_function_ptr;
+    fiber->params = params;
+
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp = (u8 *)mapping + page_size;
+    fiber->context.uc_stack.ss_size = stack_size;
+    fiber->context.uc_link = 0;
+    u64 ptr = (u64)fiber;
+    makecontext(&fiber->context, (void (*)())linux_fiber_trampoline, 2, (u32)(ptr & 0xFFFFFFFF), (u32)(ptr >> 32));
+
+    out_fiber->internal_data = fiber;
+    return true;
+}
+
+void kfiber_destroy(kfiber *fiber) {
+    if (fiber && fiber->internal_data) {
+        linux_fiber *f = (linux_fiber *)fiber->internal_data;
+        if (f->mapping) {
+            munmap(f->mapping, f->mapping_size);
+        }
+        platform_free(f, false);
+        fiber->internal_data = 0;
+    }
+}
+
+void kfiber_switch(kfiber *from, kfiber *to) {
+    linux_fiber *from_fiber = (linux_fiber *)from->internal_data;
+    linux_fiber *to_fiber = (linux_fiber *)to->internal_data;
+    swapcontext(&from_fiber->context, &to_fiber->context);
+}
+// NOTE: End fibers.
+
 void platform_get_required_extension_names(const char ***names_darray) {
     darray_push(*names_darray, &"VK_KHR_xcb_surface");  // VK_KHR_xlib_surface?
 }
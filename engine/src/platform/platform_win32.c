@@ -6,13 +6,27 @@
 #include "core/logger.h"
 #include "core/input.h"
 #include "core/event.h"
+#include "core/profiler.h"
 
 #include "containers/darray.h"
 
+#include "platform/kthread.h"
+#include "platform/kmutex.h"
+#include "platform/ksemaphore.h"
+#include "platform/kfiber.h"
+
 #include <windows.h>
 #include <windowsx.h>  // param input extraction
 #include <stdlib.h>
 
+// Timestamp counter
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <intrin.h>
+#define KPLATFORM_HAS_TSC 1
+#else
+#define KPLATFORM_HAS_TSC 0
+#endif
+
 // For surface creation
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_win32.h>
@@ -139,6 +153,7 @@ void platform_system_shutdown(void *plat_state) {
 }
 
 b8 platform_pump_messages() {
+    KPROFILE_SCOPE("platform_pump_messages");
     if (state_ptr) {
         MSG message;
         while (PeekMessageA(&message, NULL, 0, 0, PM_REMOVE)) {
@@ -201,10 +216,375 @@ f64 platform_get_absolute_time() {
     return (f64)now_time.QuadPart * clock_frequency;
 }
 
+// How long the timestamp counter is measured against the performance counter for, in milliseconds.
+#define TICK_CALIBRATION_TIME_MS 10
+
+typedef struct tick_source {
+    // Set if ticks come from the timestamp counter, otherwise they're performance counter ticks.
+    b8 use_tsc;
+    u64 frequency;
+    f64 seconds_per_tick;
+} tick_source;
+
+static tick_source ticks;
+static INIT_ONCE ticks_once = INIT_ONCE_STATIC_INIT;
+
+#if KPLATFORM_HAS_TSC
+/**
+ * @brief Reads the performance counter along with the timestamp counter, taking the latter
+ * either side and using the midpoint, so the time spent reading doesn't skew the calibration.
+ */
+static u64 tick_source_sample(u64 *out_tsc) {
+    LARGE_INTEGER now;
+    u64 before = __rdtsc();
+    QueryPerformanceCounter(&now);
+    u64 after = __rdtsc();
+    *out_tsc = before + (after - before) / 2;
+    return (u64)now.QuadPart;
+}
+
+/**
+ * @brief Measures the frequency of the timestamp counter, if it runs at a constant rate
+ * whatever the core's power state, as only then is it usable as a clock.
+ * @returns The frequency in ticks per second, or 0 if the counter can't be used.
+ */
+static u64 tick_source_calibrate_tsc(u64 qpc_frequency) {
+    i32 info[4];
+    __cpuid(info, 0x80000000);
+    if ((u32)info[0] < 0x80000007) {
+        return 0;
+    }
+    __cpuid(info, 0x80000007);
+    if (!(info[3] & (1 << 8))) {
+        // Not invariant. Virtual machines often don't report it either.
+        return 0;
+    }
+
+    u64 start_tsc, end_tsc;
+    u64 start_qpc = tick_source_sample(&start_tsc);
+    Sleep(TICK_CALIBRATION_TIME_MS);
+    u64 end_qpc = tick_source_sample(&end_tsc);
+    if (end_qpc <= start_qpc || end_tsc <= start_tsc) {
+        return 0;
+    }
+    return (u64)((f64)(end_tsc - start_tsc) * (f64)qpc_frequency / (f64)(end_qpc - start_qpc));
+}
+#endif
+
+static BOOL CALLBACK tick_source_setup(PINIT_ONCE once, PVOID parameter, PVOID *context) {
+    LARGE_INTEGER qpc_frequency;
+    QueryPerformanceFrequency(&qpc_frequency);
+#if KPLATFORM_HAS_TSC
+    ticks.frequency = tick_source_calibrate_tsc((u64)qpc_frequency.QuadPart);
+    ticks.use_tsc = ticks.frequency != 0;
+#endif
+    if (!ticks.use_tsc) {
+        ticks.frequency = (u64)qpc_frequency.QuadPart;
+    }
+    ticks.seconds_per_tick = 1.0 / (f64)ticks.frequency;
+    return TRUE;
+}
+
+u64 platform_get_ticks() {
+    InitOnceExecuteOnce(&ticks_once, tick_source_setup, 0, 0);
+#if KPLATFORM_HAS_TSC
+    if (ticks.use_tsc) {
+        return __rdtsc();
+    }
+#endif
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (u64)now.QuadPart;
+}
+
+u64 platform_get_tick_frequency() {
+    InitOnceExecuteOnce(&ticks_once, tick_source_setup, 0, 0);
+    return ticks.frequency;
+}
+
+u64 platform_ticks_to_nanoseconds(u64 count) {
+    InitOnceExecuteOnce(&ticks_once, tick_source_setup, 0, 0);
+    // Split up so the multiplication can't overflow.
+    return (count / ticks.frequency) * 1000000000ULL + (count % ticks.frequency) * 1000000000ULL / ticks.frequency;
+}
+
+f64 platform_ticks_to_seconds(u64 count) {
+    InitOnceExecuteOnce(&ticks_once, tick_source_setup, 0, 0);
+    return (f64)count * ticks.seconds_per_tick;
+}
+
 void platform_sleep(u64 ms) {
     Sleep(ms);
 }
 
+// Not in older SDK headers. Available from Windows 10 1803.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+void platform_sleep_until(f64 absolute_time) {
+    f64 remaining = absolute_time - platform_get_absolute_time();
+    if (remaining <= 0) {
+        return;
+    }
+
+    // A high resolution timer per thread, as Sleep only has the granularity of the system tick.
+    static KTHREAD_LOCAL HANDLE timer;
+    static KTHREAD_LOCAL b8 timer_unavailable;
+    if (!timer && !timer_unavailable) {
+        timer = CreateWaitableTimerExW(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        timer_unavailable = timer == 0;
+    }
+    if (timer) {
+        // Negative for a relative time, in 100ns intervals.
+        LARGE_INTEGER due_time;
+        due_time.QuadPart = -(LONGLONG)(remaining * 10000000.0);
+        if (SetWaitableTimer(timer, &due_time, 0, 0, 0, FALSE)) {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+    Sleep((DWORD)(remaining * 1000.0));
+}
+
+// NOTE: Hardware performance counters aren't supported on Windows, so none are ever open.
+u32 platform_perf_counters_open() {
+    return 0;
+}
+
+void platform_perf_counters_close() {
+}
+
+b8 platform_perf_counters_read(u64 *out_values) {
+    memset(out_values, 0, sizeof(u64) * PERF_COUNTER_MAX);
+    return false;
+}
+
+i32 platform_get_processor_count() {
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return (i32)sysinfo.dwNumberOfProcessors;
+}
+
+// NOTE: Begin threads
+b8 kthread_create(pfn_thread_start start_function_ptr, void *params, b8 auto_detach, kthread *out_thread) {
+    if (!start_function_ptr) {
+        return false;
+    }
+
+    DWORD thread_id = 0;
+    HANDLE handle = CreateThread(0, 0, (LPTHREAD_START_ROUTINE)start_function_ptr, params, 0, &thread_id);
+    if (!handle) {
+        KERROR("Failed to create thread. CreateThread error: %u", GetLastError());
+        return false;
+    }
+
+    if (auto_detach) {
+        CloseHandle(handle);
+        return true;
+    }
+
+    out_thread->thread_id = thread_id;
+    out_thread->internal_data = handle;
+    return true;
+}
+
+void kthread_destroy(kthread *thread) {
+    if (thread && thread->internal_data) {
+        DWORD exit_code;
+        GetExitCodeThread(thread->internal_data, &exit_code);
+        if (exit_code == STILL_ACTIVE) {
+            TerminateThread(thread->internal_data, 0);
+        }
+        CloseHandle((HANDLE)thread->internal_data);
+        thread->internal_data = 0;
+        thread->thread_id = 0;
+    }
+}
+
+void kthread_detach(kthread *thread) {
+    if (thread && thread->internal_data) {
+        CloseHandle(thread->internal_data);
+        thread->internal_data = 0;
+    }
+}
+
+b8 kthread_wait(kthread *thread) {
+    if (thread && thread->internal_data) {
+        DWORD result = WaitForSingleObject((HANDLE)thread->internal_data, INFINITE);
+        CloseHandle((HANDLE)thread->internal_data);
+        thread->internal_data = 0;
+        thread->thread_id = 0;
+        return result == WAIT_OBJECT_0;
+    }
+    return false;
+}
+
+void kthread_yield() {
+    SwitchToThread();
+}
+
+u64 platform_current_thread_id() {
+    return (u64)GetCurrentThreadId();
+}
+// NOTE: End threads.
+
+// NOTE: Begin mutexes
+b8 kmutex_create(kmutex *out_mutex) {
+    if (!out_mutex) {
+        return false;
+    }
+
+    CRITICAL_SECTION *section = platform_allocate(sizeof(CRITICAL_SECTION), false);
+    InitializeCriticalSection(section);
+    out_mutex->internal_data = section;
+    return true;
+}
+
+void kmutex_destroy(kmutex *mutex) {
+    if (mutex && mutex->internal_data) {
+        DeleteCriticalSection((CRITICAL_SECTION *)mutex->internal_data);
+        platform_free(mutex->internal_data, false);
+        mutex->internal_data = 0;
+    }
+}
+
+b8 kmutex_lock(kmutex *mutex) {
+    if (!mutex || !mutex->internal_data) {
+        return false;
+    }
+    EnterCriticalSection((CRITICAL_SECTION *)mutex->internal_data);
+    return true;
+}
+
+b8 kmutex_unlock(kmutex *mutex) {
+    if (!mutex || !mutex->internal_data) {
+        return false;
+    }
+    LeaveCriticalSection((CRITICAL_SECTION *)mutex->internal_data);
+    return true;
+}
+// NOTE: End mutexes.
+
+// NOTE: Begin semaphores
+b8 ksemaphore_create(ksemaphore *out_semaphore, u32 max_count, u32 start_count) {
+    if (!out_semaphore) {
+        return false;
+    }
+
+    HANDLE handle = CreateSemaphoreA(0, (LONG)start_count, (LONG)max_count, 0);
+    if (!handle) {
+        KERROR("Failed to create semaphore. CreateSemaphore error: %u", GetLastError());
+        return false;
+    }
+    out_semaphore->internal_data = handle;
+    return true;
+}
+
+void ksemaphore_destroy(ksemaphore *semaphore) {
+    if (semaphore && semaphore->internal_data) {
+        CloseHandle((HANDLE)semaphore->internal_data);
+        semaphore->internal_data = 0;
+    }
+}
+
+b8 ksemaphore_signal(ksemaphore *semaphore) {
+    if (!semaphore || !semaphore->internal_data) {
+        return false;
+    }
+    return ReleaseSemaphore((HANDLE)semaphore->internal_data, 1, 0) != 0;
+}
+
+b8 ksemaphore_wait(ksemaphore *semaphore, u64 timeout_ms) {
+    if (!semaphore || !semaphore->internal_data) {
+        return false;
+    }
+    return WaitForSingleObject((HANDLE)semaphore->internal_data, (DWORD)timeout_ms) == WAIT_OBJECT_0;
+}
+// NOTE: End semaphores.
+
+// NOTE: Begin fibers
+typedef struct win32_fiber {
+    LPVOID handle;
+    b8 is_converted_thread;
+    pfn_fiber_start start_function_ptr;
+    void *params;
+} win32_fiber;
+
+static VOID WINAPI win32_fiber_trampoline(LPVOID param) {
+    win32_fiber *fiber = (win32_fiber *)param;
+    fiber->start_function_ptr(fiber->params);
+
+    // Returning from a fiber procedure exits the thread.
+    KFATAL("Fiber start function returned. This is not allowed.");
+    ExitProcess(1);
+}
+
+b8 kfiber_convert_current_thread(kfiber *out_fiber) {
+    if (!out_fiber) {
+        return false;
+    }
+
+    LPVOID handle = ConvertThreadToFiber(0);
+    if (!handle) {
+        KERROR("Failed to convert thread to fiber. Error: %u", GetLastError());
+        return false;
+    }
+
+    win32_fiber *fiber = platform_allocate(sizeof(win32_fiber), false);
+    memset(fiber, 0, sizeof(win32_fiber));
+    fiber->handle = handle;
+    fiber->is_converted_thread = true;
+    out_fiber->internal_data = fiber;
+    return true;
+}
+
+void kfiber_revert_current_thread(kfiber *fiber) {
+    if (fiber && fiber->internal_data) {
+        ConvertFiberToThread();
+        platform_free(fiber->internal_data, false);
+        fiber->internal_data = 0;
+    }
+}
+
+b8 kfiber_create(u64 stack_size, pfn_fiber_start start_function_ptr, void *params, kfiber *out_fiber) {
+    if (!out_fiber || !start_function_ptr) {
+        return false;
+    }
+
+    win32_fiber *fiber = platform_allocate(sizeof(win32_fiber), false);
+    memset(fiber, 0, sizeof(win32_fiber));
+    fiber->start_function_ptr = start_function_ptr;
+    fiber->params = params;
+
+    // NOTE: The OS reserves the stack with its own guard page.
+    fiber->handle = CreateFiber((SIZE_T)stack_size, win32_fiber_trampoline, fiber);
+    if (!fiber->handle) {
+        KERROR("Failed to create fiber. Error: %u", GetLastError());
+        platform_free(fiber, false);
+        return false;
+    }
+
+    out_fiber->internal_data = fiber;
+    return true;
+}
+
+void kfiber_destroy(kfiber *fiber) {
+    if (fiber && fiber->internal_data) {
+        win32_fiber *f = (win32_fiber *)fiber->internal_data;
+        if (!f->is_converted_thread) {
+            DeleteFiber(f->handle);
+        }
+        platform_free(f, false);
+        fiber->internal_data = 0;
+    }
+}
+
+void kfiber_switch(kfiber *from, kfiber *to) {
+    SwitchToFiber(((win32_fiber *)to->internal_data)->handle);
+}
+// NOTE: End fibers.
+
 void platform_get_required_extension_names(const char ***names_darray) {
     darray_push(*names_darray, &"VK_KHR_win32_surface");
 }
@@ -236,7 +616,7 @@ LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARA
         case WM_CLOSE:
             // TODO: Fire an event for the application to quit.
             event_context data = {};
-            event_fire(EVENT_CODE_APPLICATION_QUIT, 0, data);
+            event_post(EVENT_CODE_APPLICATION_QUIT, 0, data);
             return 0;
         case WM_DESTROY:
             PostQuitMessage(0);
@@ -248,12 +628,12 @@ LRESULT CALLBACK win32_process_message(HWND hwnd, u32 msg, WPARAM w_param, LPARA
             u32 width = r.right - r.left;
             u32 height = r.bottom - r.top;
 
-            // Fire the event. The application layer should pick this up, but not handle it
+            // Post the event. The application layer should pick this up, but not handle it
             // as it shouldn be visible to other parts of the application.
             event_context context;
             context.data.u16[0] = (u16)width;
             context.data.u16[1] = (u16)height;
-            event_fire(EVENT_CODE_RESIZED, 0, context);
+            event_post(EVENT_CODE_RESIZED, 0, context);
         } break;
         case WM_KEYDOWN:
         case WM_SYSKEYDOWN:
@@ -4,6 +4,7 @@
 
 #include "core/logger.h"
 #include "core/kmemory.h"
+#include "core/profiler.h"
 
 typedef struct renderer_system_state {
     renderer_backend backend;
@@ -62,6 +63,7 @@ void renderer_on_resized(u16 width, u16 height) {
 }
 
 b8 renderer_draw_frame(render_packet* packet) {
+    KPROFILE_SCOPE("renderer_draw_frame");
     // If the begin frame returned successfully, mid-frame operations may continue.
     if (renderer_begin_frame(packet->delta_time)) {
         // End the frame. If this fails, it is likely unrecoverable.
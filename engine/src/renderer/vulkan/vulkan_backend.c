@@ -14,6 +14,7 @@
 #include "core/kstring.h"
 #include "core/kmemory.h"
 #include "core/application.h"
+#include "core/profiler.h"
 
 #include "containers/darray.h"
 
@@ -70,10 +71,10 @@ b8 vulkan_renderer_backend_initialize(renderer_backend* backend, const char* app
 #if defined(_DEBUG)
     darray_push(required_extensions, &VK_EXT_DEBUG_UTILS_EXTENSION_NAME);  // debug utilities
 
-    KDEBUG("Required extensions:");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Required extensions:");
     u32 length = darray_length(required_extensions);
     for (u32 i = 0; i < length; ++i) {
-        KDEBUG(required_extensions[i]);
+        KDEBUG_CAT(LOG_CATEGORY_RENDERER, required_extensions[i]);
     }
 #endif
 
@@ -128,11 +129,14 @@ b8 vulkan_renderer_backend_initialize(renderer_backend* backend, const char* app
 
     // Debugger
 #if defined(_DEBUG)
-    KDEBUG("Creating Vulkan debugger...");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Creating Vulkan debugger...");
     u32 log_severity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT |
                        VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-                       VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;  //|
-                                                                      //    VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+                       VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    // Verbose messages are plentiful, so are only asked for when the renderer category will log them.
+    if (log_category_levels[LOG_CATEGORY_RENDERER] >= LOG_LEVEL_TRACE) {
+        log_severity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    }
 
     VkDebugUtilsMessengerCreateInfoEXT debug_create_info = {VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT};
     debug_create_info.messageSeverity = log_severity;
@@ -143,16 +147,16 @@ b8 vulkan_renderer_backend_initialize(renderer_backend* backend, const char* app
         (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(context.instance, "vkCreateDebugUtilsMessengerEXT");
     KASSERT_MSG(func, "Failed to create debug messenger!");
     VK_CHECK(func(context.instance, &debug_create_info, context.allocator, &context.debug_messenger));
-    KDEBUG("Vulkan debugger created.");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Vulkan debugger created.");
 #endif
 
     // Surface
-    KDEBUG("Creating Vulkan surface...");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Creating Vulkan surface...");
     if (!platform_create_vulkan_surface(&context)) {
         KERROR("Failed to create platform surface!");
         return false;
     }
-    KDEBUG("Vulkan surface created.");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Vulkan surface created.");
 
     // Device creation
     if (!vulkan_device_create(&context)) {
@@ -275,17 +279,17 @@ void vulkan_renderer_backend_shutdown(renderer_backend* backend) {
     // Swapchain
     vulkan_swapchain_destroy(&context, &context.swapchain);
 
-    KDEBUG("Destroying Vulkan device...");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Destroying Vulkan device...");
     vulkan_device_destroy(&context);
 
-    KDEBUG("Destroying Vulkan surface...");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Destroying Vulkan surface...");
     if (context.surface) {
         vkDestroySurfaceKHR(context.instance, context.surface, context.allocator);
         context.surface = 0;
     }
 
 #if defined(_DEBUG)
-    KDEBUG("Destroying Vulkan debugger...");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Destroying Vulkan debugger...");
     if (context.debug_messenger) {
         PFN_vkDestroyDebugUtilsMessengerEXT func =
             (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(context.instance, "vkDestroyDebugUtilsMessengerEXT");
@@ -293,7 +297,7 @@ void vulkan_renderer_backend_shutdown(renderer_backend* backend) {
     }
 #endif
 
-    KDEBUG("Destroying Vulkan instance...");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Destroying Vulkan instance...");
     vkDestroyInstance(context.instance, context.allocator);
 }
 
@@ -480,10 +484,10 @@ VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(
             KWARN(callback_data->pMessage);
             break;
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
-            KINFO(callback_data->pMessage);
+            KINFO_CAT(LOG_CATEGORY_RENDERER, callback_data->pMessage);
             break;
         case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
-            KTRACE(callback_data->pMessage);
+            KTRACE_CAT(LOG_CATEGORY_RENDERER, callback_data->pMessage);
             break;
     }
     return VK_FALSE;
@@ -527,7 +531,7 @@ void create_command_buffers(renderer_backend* backend) {
             &context.graphics_command_buffers[i]);
     }
 
-    KDEBUG("Vulkan command buffers created.");
+    KDEBUG_CAT(LOG_CATEGORY_RENDERER, "Vulkan command buffers created.");
 }
 
 void regenerate_framebuffers(renderer_backend* backend, vulkan_swapchain* swapchain, vulkan_renderpass* renderpass) {
@@ -552,18 +556,19 @@ void regenerate_framebuffers(renderer_backend* backend, vulkan_swapchain* swapch
 b8 recreate_swapchain(renderer_backend* backend) {
     // If already being recreated, do not try again.
     if (context.recreating_swapchain) {
-        KDEBUG("recreate_swapchain called when already recreating. Booting.");
+        KDEBUG_CAT(LOG_CATEGORY_RENDERER, "recreate_swapchain called when already recreating. Booting.");
         return false;
     }
 
     // Detect if the window is too small to be drawn to
     if (context.framebuffer_width == 0 || context.framebuffer_height == 0) {
-        KDEBUG("recreate_swapchain called when window is < 1 in a dimension. Booting.");
+        KDEBUG_CAT(LOG_CATEGORY_RENDERER, "recreate_swapchain called when window is < 1 in a dimension. Booting.");
         return false;
     }
 
     // Mark as recreating if the dimensions are valid.
     context.recreating_swapchain = true;
+    KPROFILE_INSTANT("swapchain_recreate");
 
     // Wait for any operations to complete.
     vkDeviceWaitIdle(context.device.logical_device);
@@ -435,10 +435,10 @@ b8 physical_device_meets_requirements(
         (!requirements->compute || (requirements->compute && out_queue_info->compute_family_index != -1)) &&
         (!requirements->transfer || (requirements->transfer && out_queue_info->transfer_family_index != -1))) {
         KINFO("Device meets queue requirements.");
-        KTRACE("Graphics Family Index: %i", out_queue_info->graphics_family_index);
-        KTRACE("Present Family Index:  %i", out_queue_info->present_family_index);
-        KTRACE("Transfer Family Index: %i", out_queue_info->transfer_family_index);
-        KTRACE("Compute Family Index:  %i", out_queue_info->compute_family_index);
+        KTRACE_CAT(LOG_CATEGORY_RENDERER, "Graphics Family Index: %i", out_queue_info->graphics_family_index);
+        KTRACE_CAT(LOG_CATEGORY_RENDERER, "Present Family Index:  %i", out_queue_info->present_family_index);
+        KTRACE_CAT(LOG_CATEGORY_RENDERER, "Transfer Family Index: %i", out_queue_info->transfer_family_index);
+        KTRACE_CAT(LOG_CATEGORY_RENDERER, "Compute Family Index:  %i", out_queue_info->compute_family_index);
 
         // Query swapchain support.
         vulkan_device_query_swapchain_support(
@@ -0,0 +1,665 @@
+#include "systems/job_system.h"
+
+#include "core/logger.h"
+#include "core/kmemory.h"
+
+#include "platform/platform.h"
+#include "platform/kthread.h"
+#include "platform/kmutex.h"
+#include "platform/ksemaphore.h"
+#include "platform/kfiber.h"
+
+// The maximum number of jobs which may be queued at once on each lane. Must be a power of 2.
+#define JOB_QUEUE_CAPACITY 4096
+
+#define JOB_DEFAULT_FIBER_COUNT 64
+// Generous, since log_output alone uses ~64KiB of stack.
+#define JOB_DEFAULT_FIBER_STACK_SIZE (256 * 1024)
+
+// How long an idle worker sleeps before checking for work again. Everything that
+// produces work signals the workers, so this is only a safety net.
+#define JOB_IDLE_WAIT_MS 10
+
+// The worker lanes, indexed by priority, followed by the main thread's queue.
+#define JOB_QUEUE_MAIN_THREAD JOB_PRIORITY_MAX
+#define JOB_QUEUE_COUNT (JOB_PRIORITY_MAX + 1)
+
+// Queue masks for job_queue_pop.
+#define JOB_QUEUES_WORKER ((1 << JOB_PRIORITY_HIGH) | (1 << JOB_PRIORITY_NORMAL) | (1 << JOB_PRIORITY_BACKGROUND))
+#define JOB_QUEUES_MAIN_THREAD ((1 << JOB_QUEUE_MAIN_THREAD) | (1 << JOB_PRIORITY_HIGH) | (1 << JOB_PRIORITY_NORMAL))
+
+typedef struct job_entry {
+    job_decl decl;
+    job_counter* counter;
+    job_priority priority;
+} job_entry;
+
+// A ring buffer of pending jobs.
+typedef struct job_queue {
+    job_entry* entries;
+    u32 head;
+    volatile u32 count;
+} job_queue;
+
+typedef struct job_fiber {
+    kfiber fiber;
+    u32 index;
+} job_fiber;
+
+typedef struct job_waiting_fiber {
+    job_fiber* fiber;
+    job_counter* counter;
+    job_priority priority;
+} job_waiting_fiber;
+
+typedef struct job_worker {
+    kthread thread;
+    // The worker thread's own fiber, switched back to on shutdown.
+    kfiber thread_fiber;
+} job_worker;
+
+// Per-thread context. Zeroed on any thread that is not a worker.
+typedef struct job_thread_context {
+    job_worker* worker;
+    job_fiber* current_fiber;
+    // The job being executed by the current fiber, if any.
+    const job_entry* current_job;
+
+    // A fiber can't be returned to the pool or made resumable while it is still
+    // running, so these are handed across a switch and processed by whichever
+    // fiber runs next.
+    job_fiber* fiber_to_free;
+    job_fiber* fiber_to_park;
+    job_counter* park_counter;
+    job_priority park_priority;
+} job_thread_context;
+
+typedef struct job_system_state {
+    volatile b8 running;
+    b8 use_fibers;
+    u8 worker_count;
+    u8 max_background_workers;
+    u32 fiber_count;
+    u64 main_thread_id;
+
+    job_worker* workers;
+
+    // Pending jobs, one queue per lane plus one for the main thread.
+    kmutex queue_mutex;
+    job_queue queues[JOB_QUEUE_COUNT];
+    // The number of background jobs currently executing, capped at max_background_workers.
+    volatile u32 background_active;
+
+    // Signalled once per queued job and whenever a parked fiber may have become ready.
+    ksemaphore work_semaphore;
+
+    // Guards the free fiber list and the waiting fiber list.
+    kmutex fiber_mutex;
+    job_fiber* fibers;
+    u32* free_fibers;
+    u32 free_fiber_count;
+    job_waiting_fiber* waiting_fibers;
+    volatile u32 waiting_fiber_count;
+} job_system_state;
+
+static job_system_state* state_ptr;
+
+static KTHREAD_LOCAL job_thread_context thread_context;
+
+static void job_worker_loop();
+static void job_fiber_entry(void* param);
+static u32 job_worker_thread(void* param);
+
+// NOTE: A fiber may be resumed on a different thread than the one it was parked on.
+KTHREAD_LOCAL_ACCESSOR(job_thread_context, job_thread_context_get, thread_context)
+
+static void job_system_resolve_config(const job_system_config* config, job_system_config* out_config) {
+    kzero_memory(out_config, sizeof(job_system_config));
+    if (config) {
+        *out_config = *config;
+    }
+
+    if (out_config->worker_count == 0) {
+        // Leave the main thread its own core.
+        i32 processor_count = platform_get_processor_count() - 1;
+        out_config->worker_count = processor_count < 1 ? 1 : (processor_count > 255 ? 255 : processor_count);
+    }
+
+    if (out_config->use_fibers) {
+        if (out_config->fiber_count == 0) {
+            out_config->fiber_count = JOB_DEFAULT_FIBER_COUNT;
+        }
+        // Each worker needs a fiber to run on, plus spares to switch to when one is parked.
+        u32 min_fiber_count = out_config->worker_count * 2;
+        if (out_config->fiber_count < min_fiber_count) {
+            out_config->fiber_count = min_fiber_count;
+        }
+        if (out_config->fiber_stack_size == 0) {
+            out_config->fiber_stack_size = JOB_DEFAULT_FIBER_STACK_SIZE;
+        }
+    } else {
+        out_config->fiber_count = 0;
+    }
+
+    if (out_config->max_background_workers == 0 || out_config->max_background_workers >= out_config->worker_count) {
+        // Keep one worker back for the other lanes, unless there is only one.
+        out_config->max_background_workers = out_config->worker_count > 1 ? out_config->worker_count - 1 : 1;
+    }
+}
+
+b8 job_system_initialize(u64* memory_requirement, void* state, const job_system_config* config) {
+    job_system_config resolved;
+    job_system_resolve_config(config, &resolved);
+
+    u64 workers_size = sizeof(job_worker) * resolved.worker_count;
+    u64 queue_size = sizeof(job_entry) * JOB_QUEUE_CAPACITY * JOB_QUEUE_COUNT;
+    u64 fibers_size = sizeof(job_fiber) * resolved.fiber_count;
+    u64 free_fibers_size = sizeof(u32) * resolved.fiber_count;
+    u64 waiting_fibers_size = sizeof(job_waiting_fiber) * resolved.fiber_count;
+    *memory_requirement = sizeof(job_system_state) + workers_size + queue_size + fibers_size + free_fibers_size + waiting_fibers_size;
+    if (state == 0) {
+        return true;
+    }
+
+    kzero_memory(state, *memory_requirement);
+    state_ptr = state;
+    state_ptr->use_fibers = resolved.use_fibers;
+    state_ptr->worker_count = resolved.worker_count;
+    state_ptr->max_background_workers = resolved.max_background_workers;
+    state_ptr->fiber_count = resolved.fiber_count;
+    state_ptr->main_thread_id = platform_current_thread_id();
+
+    // Carve the arrays out of the block following the state.
+    u8* block = (u8*)state + sizeof(job_system_state);
+    state_ptr->workers = (job_worker*)block;
+    block += workers_size;
+    for (u32 i = 0; i < JOB_QUEUE_COUNT; ++i) {
+        state_ptr->queues[i].entries = (job_entry*)block + (i * JOB_QUEUE_CAPACITY);
+    }
+    block += queue_size;
+    state_ptr->fibers = (job_fiber*)block;
+    block += fibers_size;
+    state_ptr->free_fibers = (u32*)block;
+    block += free_fibers_size;
+    state_ptr->waiting_fibers = (job_waiting_fiber*)block;
+
+    if (!kmutex_create(&state_ptr->queue_mutex) || !kmutex_create(&state_ptr->fiber_mutex)) {
+        KERROR("Failed to create job system mutexes.");
+        return false;
+    }
+    if (!ksemaphore_create(&state_ptr->work_semaphore, 0x7FFFFFFF, 0)) {
+        KERROR("Failed to create job system semaphore.");
+        return false;
+    }
+
+    for (u32 i = 0; i < state_ptr->fiber_count; ++i) {
+        state_ptr->fibers[i].index = i;
+        if (!kfiber_create(resolved.fiber_stack_size, job_fiber_entry, 0, &state_ptr->fibers[i].fiber)) {
+            KERROR("Failed to create job fiber %u.", i);
+            return false;
+        }
+        state_ptr->free_fibers[i] = i;
+    }
+    state_ptr->free_fiber_count = state_ptr->fiber_count;
+
+    state_ptr->running = true;
+    for (u8 i = 0; i < state_ptr->worker_count; ++i) {
+        if (!kthread_create(job_worker_thread, &state_ptr->workers[i], false, &state_ptr->workers[i].thread)) {
+            KFATAL("Failed to create job worker thread %u.", i);
+            return false;
+        }
+    }
+
+    KINFO("Job system initialized with %u workers (%s), up to %u for background jobs.", state_ptr->worker_count, state_ptr->use_fibers ? "fibers" : "threads", state_ptr->max_background_workers);
+    return true;
+}
+
+void job_system_shutdown(void* state) {
+    if (!state_ptr) {
+        return;
+    }
+
+    __atomic_store_n(&state_ptr->running, false, __ATOMIC_RELEASE);
+
+    // Wake everyone up so they notice.
+    for (u8 i = 0; i < state_ptr->worker_count; ++i) {
+        ksemaphore_signal(&state_ptr->work_semaphore);
+    }
+    for (u8 i = 0; i < state_ptr->worker_count; ++i) {
+        kthread_wait(&state_ptr->workers[i].thread);
+    }
+
+    u32 queued_count = 0;
+    for (u32 i = 0; i < JOB_QUEUE_COUNT; ++i) {
+        queued_count += state_ptr->queues[i].count;
+    }
+    if (queued_count > 0) {
+        KWARN("Job system shut down with %u jobs still queued. They will not run.", queued_count);
+    }
+    if (state_ptr->waiting_fiber_count > 0) {
+        KWARN("Job system shut down with %u fibers still waiting on counters.", state_ptr->waiting_fiber_count);
+    }
+
+    for (u32 i = 0; i < state_ptr->fiber_count; ++i) {
+        kfiber_destroy(&state_ptr->fibers[i].fiber);
+    }
+
+    ksemaphore_destroy(&state_ptr->work_semaphore);
+    kmutex_destroy(&state_ptr->fiber_mutex);
+    kmutex_destroy(&state_ptr->queue_mutex);
+
+    state_ptr = 0;
+}
+
+b8 job_counter_is_complete(const job_counter* counter) {
+    return __atomic_load_n(&counter->value, __ATOMIC_ACQUIRE) <= 0;
+}
+
+u8 job_system_worker_count() {
+    return state_ptr ? state_ptr->worker_count : 0;
+}
+
+b8 job_system_is_main_thread() {
+    return state_ptr && platform_current_thread_id() == state_ptr->main_thread_id;
+}
+
+/**
+ * @brief Executes a job. Background jobs must already hold a slot in background_active,
+ * which is released here.
+ */
+static void job_execute(const job_entry* entry) {
+    job_thread_context* context = job_thread_context_get();
+    const job_entry* previous_job = context->current_job;
+    context->current_job = entry;
+
+    entry->decl.entry_point(entry->decl.param);
+
+    // The job may have been parked and resumed on another thread.
+    context = job_thread_context_get();
+    context->current_job = previous_job;
+    if (entry->priority == JOB_PRIORITY_BACKGROUND) {
+        __atomic_sub_fetch(&state_ptr->background_active, 1, __ATOMIC_ACQ_REL);
+    }
+
+    if (entry->counter) {
+        // NOTE: The counter belongs to the waiter and must not be touched after it hits zero.
+        if (__atomic_sub_fetch(&entry->counter->value, 1, __ATOMIC_ACQ_REL) == 0 &&
+            __atomic_load_n(&state_ptr->waiting_fiber_count, __ATOMIC_ACQUIRE) > 0) {
+            // Someone may be parked on this counter. Wake a worker to resume it.
+            ksemaphore_signal(&state_ptr->work_semaphore);
+        }
+    }
+}
+
+/**
+ * @brief Claims a slot in background_active if one is free.
+ * @returns True if a slot was claimed; otherwise false.
+ */
+static b8 job_background_slot_acquire() {
+    u32 active = __atomic_load_n(&state_ptr->background_active, __ATOMIC_ACQUIRE);
+    while (active < state_ptr->max_background_workers) {
+        if (__atomic_compare_exchange_n(&state_ptr->background_active, &active, active + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Pops the next job from the first non-empty queue in queue_mask, in queue order.
+ * A background job is only taken if a background slot is free, and the slot is claimed
+ * before returning.
+ */
+static b8 job_queue_pop(u32 queue_mask, job_entry* out_entry) {
+    // Cheap early-out so idle workers don't hammer the lock.
+    b8 any_queued = false;
+    for (u32 i = 0; i < JOB_QUEUE_COUNT; ++i) {
+        if ((queue_mask & (1 << i)) && __atomic_load_n(&state_ptr->queues[i].count, __ATOMIC_ACQUIRE) > 0) {
+            any_queued = true;
+            break;
+        }
+    }
+    if (!any_queued) {
+        return false;
+    }
+
+    // The main thread queue comes first for the main thread; the lanes follow in priority order.
+    static const u32 pop_order[JOB_QUEUE_COUNT] = {JOB_QUEUE_MAIN_THREAD, JOB_PRIORITY_HIGH, JOB_PRIORITY_NORMAL, JOB_PRIORITY_BACKGROUND};
+
+    b8 found = false;
+    kmutex_lock(&state_ptr->queue_mutex);
+    for (u32 i = 0; i < JOB_QUEUE_COUNT && !found; ++i) {
+        u32 index = pop_order[i];
+        job_queue* queue = &state_ptr->queues[index];
+        if (!(queue_mask & (1 << index)) || queue->count == 0) {
+            continue;
+        }
+        if (index == JOB_PRIORITY_BACKGROUND && !job_background_slot_acquire()) {
+            continue;
+        }
+
+        *out_entry = queue->entries[queue->head];
+        queue->head = (queue->head + 1) & (JOB_QUEUE_CAPACITY - 1);
+        __atomic_store_n(&queue->count, queue->count - 1, __ATOMIC_RELEASE);
+        found = true;
+    }
+    kmutex_unlock(&state_ptr->queue_mutex);
+    return found;
+}
+
+/**
+ * @brief Queues jobs on the given queue, incrementing counter by job_count up front.
+ */
+static b8 job_submit(const job_decl* jobs, u32 job_count, u32 queue_index, job_counter* counter) {
+    if (!state_ptr || !jobs) {
+        return false;
+    }
+
+    job_queue* queue = &state_ptr->queues[queue_index];
+    b8 main_thread_queue = queue_index == JOB_QUEUE_MAIN_THREAD;
+    // Main thread jobs are treated as high priority when they submit jobs of their own.
+    job_priority priority = main_thread_queue ? JOB_PRIORITY_HIGH : (job_priority)queue_index;
+
+    // Count everything up front so a waiter can't observe zero part way through submission.
+    if (counter) {
+        __atomic_add_fetch(&counter->value, (i32)job_count, __ATOMIC_ACQ_REL);
+    }
+
+    u32 submitted = 0;
+    while (submitted < job_count) {
+        u32 pushed = 0;
+        kmutex_lock(&state_ptr->queue_mutex);
+        while (submitted < job_count && queue->count < JOB_QUEUE_CAPACITY) {
+            u32 tail = (queue->head + queue->count) & (JOB_QUEUE_CAPACITY - 1);
+            queue->entries[tail].decl = jobs[submitted];
+            queue->entries[tail].counter = counter;
+            queue->entries[tail].priority = priority;
+            __atomic_store_n(&queue->count, queue->count + 1, __ATOMIC_RELEASE);
+            submitted++;
+            pushed++;
+        }
+        kmutex_unlock(&state_ptr->queue_mutex);
+
+        // The main thread isn't woken by the semaphore; it drains its queue at set points.
+        if (!main_thread_queue) {
+            for (u32 i = 0; i < pushed; ++i) {
+                ksemaphore_signal(&state_ptr->work_semaphore);
+            }
+        }
+
+        if (submitted < job_count) {
+            if (main_thread_queue && !job_system_is_main_thread()) {
+                // Main thread jobs can't be run here. Wait for the main thread to make room.
+                kthread_yield();
+                continue;
+            }
+
+            if (priority == JOB_PRIORITY_BACKGROUND) {
+                // Background work never runs on the main thread and needs a slot. A background job
+                // lends its own slot, as it does nothing else meanwhile; anyone else waits for room.
+                b8 own_slot = !job_system_is_main_thread() && job_system_current_priority() == JOB_PRIORITY_BACKGROUND;
+                if (!own_slot) {
+                    kthread_yield();
+                    continue;
+                }
+                // Released again by job_execute.
+                __atomic_add_fetch(&state_ptr->background_active, 1, __ATOMIC_ACQ_REL);
+            }
+
+            // The queue is full. Run the next job here so the caller still makes progress.
+            job_entry entry;
+            entry.decl = jobs[submitted];
+            entry.counter = counter;
+            entry.priority = priority;
+            job_execute(&entry);
+            submitted++;
+        }
+    }
+
+    return true;
+}
+
+job_priority job_system_current_priority() {
+    const job_entry* current_job = job_thread_context_get()->current_job;
+    return current_job ? current_job->priority : JOB_PRIORITY_NORMAL;
+}
+
+b8 job_system_run(const job_decl* jobs, u32 job_count, job_counter* counter) {
+    return job_submit(jobs, job_count, job_system_current_priority(), counter);
+}
+
+b8 job_system_run_with_priority(const job_decl* jobs, u32 job_count, job_priority priority, job_counter* counter) {
+    if (priority >= JOB_PRIORITY_MAX) {
+        KERROR("job_system_run_with_priority - Invalid priority %u.", priority);
+        return false;
+    }
+    return job_submit(jobs, job_count, priority, counter);
+}
+
+b8 job_system_run_on_main_thread(const job_decl* jobs, u32 job_count, job_counter* counter) {
+    return job_submit(jobs, job_count, JOB_QUEUE_MAIN_THREAD, counter);
+}
+
+u32 job_system_drain_main_thread() {
+    if (!job_system_is_main_thread()) {
+        KERROR("job_system_drain_main_thread - Must be called from the main thread.");
+        return 0;
+    }
+
+    // Only what is queued now, so a job which requeues itself can't stall the caller.
+    u32 count = __atomic_load_n(&state_ptr->queues[JOB_QUEUE_MAIN_THREAD].count, __ATOMIC_ACQUIRE);
+    u32 executed = 0;
+    job_entry entry;
+    while (executed < count && job_queue_pop(1 << JOB_QUEUE_MAIN_THREAD, &entry)) {
+        job_execute(&entry);
+        executed++;
+    }
+    return executed;
+}
+
+static job_fiber* job_fiber_acquire() {
+    job_fiber* fiber = 0;
+    kmutex_lock(&state_ptr->fiber_mutex);
+    if (state_ptr->free_fiber_count > 0) {
+        state_ptr->free_fiber_count--;
+        fiber = &state_ptr->fibers[state_ptr->free_fibers[state_ptr->free_fiber_count]];
+    }
+    kmutex_unlock(&state_ptr->fiber_mutex);
+    return fiber;
+}
+
+/**
+ * @brief Completes the hand-off started before a fiber switch. Must be called
+ * immediately after every switch, by the fiber that was switched to.
+ */
+static void job_fiber_finish_switch() {
+    job_thread_context* context = job_thread_context_get();
+
+    if (context->fiber_to_free) {
+        kmutex_lock(&state_ptr->fiber_mutex);
+        state_ptr->free_fibers[state_ptr->free_fiber_count] = context->fiber_to_free->index;
+        state_ptr->free_fiber_count++;
+        kmutex_unlock(&state_ptr->fiber_mutex);
+        context->fiber_to_free = 0;
+    }
+
+    if (context->fiber_to_park) {
+        kmutex_lock(&state_ptr->fiber_mutex);
+        job_waiting_fiber* waiting = &state_ptr->waiting_fibers[state_ptr->waiting_fiber_count];
+        waiting->fiber = context->fiber_to_park;
+        waiting->counter = context->park_counter;
+        waiting->priority = context->park_priority;
+        __atomic_store_n(&state_ptr->waiting_fiber_count, state_ptr->waiting_fiber_count + 1, __ATOMIC_RELEASE);
+        // The counter may have hit zero before the fiber made it onto the list, in which case
+        // nobody was woken to resume it. Checked under the lock, as the fiber (and the counter
+        // it owns) may be resumed and gone as soon as the lock is released.
+        b8 ready = job_counter_is_complete(context->park_counter);
+        kmutex_unlock(&state_ptr->fiber_mutex);
+
+        context->fiber_to_park = 0;
+        context->park_counter = 0;
+        if (ready) {
+            ksemaphore_signal(&state_ptr->work_semaphore);
+        }
+    }
+}
+
+/**
+ * @brief Looks for a parked fiber whose counter has reached zero. If one is found,
+ * the current fiber is returned to the pool and the parked fiber is resumed.
+ * @returns True if a fiber was resumed (and this fiber later reacquired); otherwise false.
+ */
+static b8 job_try_resume_waiting_fiber() {
+    if (__atomic_load_n(&state_ptr->waiting_fiber_count, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+
+    job_fiber* ready = 0;
+    kmutex_lock(&state_ptr->fiber_mutex);
+    u32 count = state_ptr->waiting_fiber_count;
+    for (u32 i = 0; i < count; ++i) {
+        job_waiting_fiber* waiting = &state_ptr->waiting_fibers[i];
+        if (job_counter_is_complete(waiting->counter)) {
+            if (waiting->priority == JOB_PRIORITY_BACKGROUND) {
+                // A background job reclaims its slot on resuming, so it is subject to the same cap.
+                if (!job_background_slot_acquire()) {
+                    continue;
+                }
+            }
+            ready = waiting->fiber;
+            state_ptr->waiting_fibers[i] = state_ptr->waiting_fibers[count - 1];
+            __atomic_store_n(&state_ptr->waiting_fiber_count, count - 1, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    kmutex_unlock(&state_ptr->fiber_mutex);
+
+    if (!ready) {
+        return false;
+    }
+
+    job_thread_context* context = job_thread_context_get();
+    job_fiber* self = context->current_fiber;
+    context->fiber_to_free = self;
+    context->current_fiber = ready;
+    kfiber_switch(&self->fiber, &ready->fiber);
+
+    // Reacquired from the pool at some later point, possibly on another thread.
+    job_fiber_finish_switch();
+    return true;
+}
+
+void job_system_wait_for_counter(job_counter* counter) {
+    if (!counter || job_counter_is_complete(counter)) {
+        return;
+    }
+
+    job_thread_context* context = job_thread_context_get();
+    const job_entry* current_job = context->current_job;
+    job_priority priority = current_job ? current_job->priority : JOB_PRIORITY_NORMAL;
+
+    if (state_ptr && state_ptr->use_fibers && context->current_fiber) {
+        job_fiber* next = job_fiber_acquire();
+        if (next) {
+            // Park this fiber and keep the worker busy on another. A parked background
+            // job gives up its slot, as its children may need it.
+            if (priority == JOB_PRIORITY_BACKGROUND) {
+                __atomic_sub_fetch(&state_ptr->background_active, 1, __ATOMIC_ACQ_REL);
+            }
+            job_fiber* self = context->current_fiber;
+            context->fiber_to_park = self;
+            context->park_counter = counter;
+            context->park_priority = priority;
+            context->current_fiber = next;
+            kfiber_switch(&self->fiber, &next->fiber);
+
+            // Resumed by a worker once the counter reached zero, with the slot reclaimed.
+            job_fiber_finish_switch();
+            job_thread_context_get()->current_job = current_job;
+            return;
+        }
+        // NOTE: The pool is exhausted; fall back to blocking this worker.
+    }
+
+    // Blocking wait. Execute other jobs in the meantime rather than idling. The main
+    // thread serves its own queue too, but leaves background work to the workers.
+    u32 queue_mask = job_system_is_main_thread() ? JOB_QUEUES_MAIN_THREAD : JOB_QUEUES_WORKER;
+    if (priority == JOB_PRIORITY_BACKGROUND) {
+        __atomic_sub_fetch(&state_ptr->background_active, 1, __ATOMIC_ACQ_REL);
+    }
+    while (!job_counter_is_complete(counter)) {
+        job_entry entry;
+        if (state_ptr && job_queue_pop(queue_mask, &entry)) {
+            job_execute(&entry);
+        } else {
+            kthread_yield();
+        }
+    }
+    // Take the slot back once one is free, as the fiber path does on resuming.
+    while (priority == JOB_PRIORITY_BACKGROUND && !job_background_slot_acquire()) {
+        job_entry entry;
+        if (job_queue_pop(queue_mask, &entry)) {
+            job_execute(&entry);
+        } else {
+            kthread_yield();
+        }
+    }
+}
+
+static void job_worker_loop() {
+    while (__atomic_load_n(&state_ptr->running, __ATOMIC_ACQUIRE)) {
+        // Parked fibers take priority over new work, as they are further along.
+        if (state_ptr->use_fibers && job_try_resume_waiting_fiber()) {
+            continue;
+        }
+
+        job_entry entry;
+        if (job_queue_pop(JOB_QUEUES_WORKER, &entry)) {
+            job_execute(&entry);
+            continue;
+        }
+
+        ksemaphore_wait(&state_ptr->work_semaphore, JOB_IDLE_WAIT_MS);
+    }
+}
+
+static void job_fiber_entry(void* param) {
+    job_fiber_finish_switch();
+
+    job_worker_loop();
+
+    // Shutting down. Return to the worker thread's own fiber so it can exit. This fiber
+    // is never resumed again, so it is deliberately not returned to the pool.
+    job_thread_context* context = job_thread_context_get();
+    job_fiber* self = context->current_fiber;
+    context->current_fiber = 0;
+    kfiber_switch(&self->fiber, &context->worker->thread_fiber);
+}
+
+static u32 job_worker_thread(void* param) {
+    job_worker* worker = (job_worker*)param;
+    job_thread_context* context = job_thread_context_get();
+    context->worker = worker;
+
+    if (state_ptr->use_fibers && kfiber_convert_current_thread(&worker->thread_fiber)) {
+        job_fiber* fiber = job_fiber_acquire();
+        if (fiber) {
+            context->current_fiber = fiber;
+            kfiber_switch(&worker->thread_fiber, &fiber->fiber);
+
+            // Back on the thread's own stack once the system is shutting down.
+            job_fiber_finish_switch();
+            kfiber_revert_current_thread(&worker->thread_fiber);
+            // Opened if jobs were profiled with counters.
+            platform_perf_counters_close();
+            return 0;
+        }
+
+        KWARN("Job worker could not obtain a fiber. Waits on this worker will block.");
+        kfiber_revert_current_thread(&worker->thread_fiber);
+    }
+
+    job_worker_loop();
+    platform_perf_counters_close();
+    return 0;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief The lane a job is queued on. Workers always take high priority jobs first,
+ * then normal, then background.
+ */
+typedef enum job_priority {
+    // Latency-critical work, such as the frame's own tasks.
+    JOB_PRIORITY_HIGH,
+    // General work.
+    JOB_PRIORITY_NORMAL,
+    // Work with no deadline, such as asset decompression. Never runs on the main thread,
+    // and is limited to a subset of the workers so it can't starve the other lanes.
+    JOB_PRIORITY_BACKGROUND,
+
+    JOB_PRIORITY_MAX
+} job_priority;
+
+// The function invoked to perform a job's work.
+typedef void (*pfn_job_entry)(void* param);
+
+/**
+ * @brief Describes a single unit of work to be handed to the job system.
+ */
+typedef struct job_decl {
+    // The function to be invoked. Required.
+    pfn_job_entry entry_point;
+    // Data passed to entry_point. Optional.
+    void* param;
+} job_decl;
+
+/**
+ * @brief Tracks completion of a batch of jobs. Incremented for each job submitted
+ * against it and decremented as each finishes; the batch is complete at zero.
+ * Owned by the caller, and must outlive every job submitted against it.
+ */
+typedef struct job_counter {
+    volatile i32 value;
+} job_counter;
+
+typedef struct job_system_config {
+    // The number of worker threads. 0 uses one per logical processor, minus the main thread.
+    u8 worker_count;
+    // If true, jobs run on fibers and may be parked while waiting on a counter.
+    // Otherwise, waiting jobs block their worker, executing other queued jobs in the meantime.
+    b8 use_fibers;
+    // The number of fibers in the pool. 0 uses the default.
+    u32 fiber_count;
+    // The usable stack size of each fiber in bytes. 0 uses the default.
+    u64 fiber_stack_size;
+    // The most workers which may run background jobs at once. 0 uses all but one of them,
+    // so that a worker is always free for the other lanes.
+    u8 max_background_workers;
+} job_system_config;
+
+/**
+ * @brief Initializes the job system. The calling thread becomes the main thread, on
+ * which main thread jobs are run. Call twice; once to obtain memory requirement (passing
+ * state = 0), then a second time passing allocated memory to state. The memory requirement
+ * depends on config, so the same config must be passed both times.
+ *
+ * @param memory_requirement The required size of the state memory.
+ * @param state Either 0 or the allocated block of state memory.
+ * @param config The configuration for the system. Pass 0 to use the defaults.
+ * @returns True on success; otherwise false.
+ */
+b8 job_system_initialize(u64* memory_requirement, void* state, const job_system_config* config);
+
+/**
+ * @brief Shuts the job system down, waiting for all worker threads to exit.
+ * Jobs still queued at this point are discarded.
+ */
+void job_system_shutdown(void* state);
+
+/**
+ * @brief Submits jobs for execution on the worker threads. Jobs submitted from within
+ * a job take on its priority, so work spawned by the frame stays on the frame's lane.
+ * Otherwise they are submitted at normal priority.
+ *
+ * @param jobs An array of jobs to be submitted.
+ * @param job_count The number of jobs in the array.
+ * @param counter A counter to be incremented by job_count and decremented as each job completes. Optional.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 job_system_run(const job_decl* jobs, u32 job_count, job_counter* counter);
+
+/**
+ * @brief Submits jobs for execution on the worker threads at the given priority.
+ *
+ * @param jobs An array of jobs to be submitted.
+ * @param job_count The number of jobs in the array.
+ * @param priority The lane to queue the jobs on.
+ * @param counter A counter to be incremented by job_count and decremented as each job completes. Optional.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 job_system_run_with_priority(const job_decl* jobs, u32 job_count, job_priority priority, job_counter* counter);
+
+/**
+ * @brief Submits jobs which must execute on the main thread. They are run when the main
+ * thread calls job_system_drain_main_thread, or while it waits on a counter.
+ *
+ * @param jobs An array of jobs to be submitted.
+ * @param job_count The number of jobs in the array.
+ * @param counter A counter to be incremented by job_count and decremented as each job completes. Optional.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 job_system_run_on_main_thread(const job_decl* jobs, u32 job_count, job_counter* counter);
+
+/**
+ * @brief Executes every job currently queued for the main thread. Must be called from the main thread.
+ * @returns The number of jobs executed.
+ */
+KAPI u32 job_system_drain_main_thread();
+
+/**
+ * @brief Indicates if the calling thread is the main thread.
+ */
+KAPI b8 job_system_is_main_thread();
+
+/**
+ * @brief Obtains the priority of the job running on the calling thread, which jobs it
+ * submits with job_system_run are given.
+ * @returns The priority, or JOB_PRIORITY_NORMAL outside of a job.
+ */
+KAPI job_priority job_system_current_priority();
+
+/**
+ * @brief Waits until the given counter reaches zero. When called from a job in fiber
+ * mode, the calling fiber is parked and the worker moves on to other jobs, resuming
+ * the fiber once the counter hits zero. Otherwise, the calling thread executes queued
+ * jobs while it waits. The main thread executes main thread jobs first, and never
+ * picks up background jobs.
+ *
+ * @param counter The counter to wait on.
+ */
+KAPI void job_system_wait_for_counter(job_counter* counter);
+
+/**
+ * @brief Indicates if the jobs tracked by the given counter have all completed.
+ */
+KAPI b8 job_counter_is_complete(const job_counter* counter);
+
+/**
+ * @brief Obtains the number of worker threads, or 0 if the job system is not running.
+ */
+KAPI u8 job_system_worker_count();
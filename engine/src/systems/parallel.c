@@ -0,0 +1,209 @@
+#include "systems/parallel.h"
+
+#include "systems/job_system.h"
+#include "containers/darray.h"
+#include "core/kmemory.h"
+
+// Upper bound on chunks per call, which keeps the per-call bookkeeping on the stack.
+#define PARALLEL_MAX_CHUNKS 256
+
+// Chunks per thread when sizing automatically, so that uneven chunks still balance out.
+#define PARALLEL_CHUNKS_PER_THREAD 4
+
+// Reductions whose partials fit in this many bytes keep them on the stack.
+#define PARALLEL_STACK_PARTIALS_SIZE 4096
+
+// Partials are each given whole cache lines, so chunks folding into them on different
+// threads don't keep taking the same line from each other.
+#define PARALLEL_CACHE_LINE_SIZE 64
+
+typedef struct parallel_chunk {
+    u64 begin;
+    u64 end;
+    pfn_parallel_for for_fn;
+    pfn_parallel_reduce reduce_fn;
+    void* user;
+    void* partial;
+} parallel_chunk;
+
+typedef struct parallel_darray_context {
+    u8* elements;
+    u64 stride;
+    pfn_parallel_for_darray for_fn;
+    pfn_parallel_reduce_darray reduce_fn;
+    void* user;
+} parallel_darray_context;
+
+/**
+ * @brief Works out how many chunks to split count items into, given the requested grain.
+ */
+static u64 parallel_chunk_layout(u64 count, u64 grain, u64* out_grain) {
+    u8 worker_count = job_system_worker_count();
+    if (worker_count == 0) {
+        // No job system, so everything runs inline as one chunk.
+        *out_grain = count;
+        return 1;
+    }
+
+    if (grain == 0) {
+        // The calling thread takes part as well.
+        u64 target_chunks = (u64)(worker_count + 1) * PARALLEL_CHUNKS_PER_THREAD;
+        grain = (count + target_chunks - 1) / target_chunks;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    u64 chunk_count = (count + grain - 1) / grain;
+    if (chunk_count > PARALLEL_MAX_CHUNKS) {
+        grain = (count + PARALLEL_MAX_CHUNKS - 1) / PARALLEL_MAX_CHUNKS;
+        chunk_count = (count + grain - 1) / grain;
+    }
+
+    *out_grain = grain;
+    return chunk_count;
+}
+
+static void parallel_chunk_entry(void* param) {
+    parallel_chunk* chunk = (parallel_chunk*)param;
+    if (chunk->for_fn) {
+        chunk->for_fn(chunk->begin, chunk->end, chunk->user);
+    } else {
+        chunk->reduce_fn(chunk->begin, chunk->end, chunk->user, chunk->partial);
+    }
+}
+
+/**
+ * @brief Hands all but the first chunk to the job system, runs the first one on the
+ * calling thread and waits for the rest.
+ */
+static void parallel_dispatch(parallel_chunk* chunks, u64 chunk_count) {
+    job_counter counter = {0};
+    if (chunk_count > 1) {
+        job_decl jobs[PARALLEL_MAX_CHUNKS];
+        for (u64 i = 1; i < chunk_count; ++i) {
+            jobs[i - 1].entry_point = parallel_chunk_entry;
+            jobs[i - 1].param = &chunks[i];
+        }
+        job_system_run(jobs, (u32)(chunk_count - 1), &counter);
+    }
+
+    parallel_chunk_entry(&chunks[0]);
+    job_system_wait_for_counter(&counter);
+}
+
+void parallel_for(u64 begin, u64 end, u64 grain, pfn_parallel_for fn, void* user) {
+    if (!fn || end <= begin) {
+        return;
+    }
+
+    u64 count = end - begin;
+    u64 chunk_count = parallel_chunk_layout(count, grain, &grain);
+    if (chunk_count == 1) {
+        fn(begin, end, user);
+        return;
+    }
+
+    parallel_chunk chunks[PARALLEL_MAX_CHUNKS];
+    for (u64 i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = begin + i * grain;
+        chunks[i].end = (i == chunk_count - 1) ? end : chunks[i].begin + grain;
+        chunks[i].for_fn = fn;
+        chunks[i].reduce_fn = 0;
+        chunks[i].user = user;
+        chunks[i].partial = 0;
+    }
+
+    parallel_dispatch(chunks, chunk_count);
+}
+
+static void parallel_reduce_internal(
+    u64 begin, u64 end, u64 grain, u64 result_size, const void* identity,
+    pfn_parallel_reduce fn, void* fn_user,
+    pfn_parallel_combine combine, void* combine_user,
+    void* out_result) {
+    kcopy_memory(out_result, identity, result_size);
+    if (!fn || !combine || end <= begin) {
+        return;
+    }
+
+    u64 count = end - begin;
+    u64 chunk_count = parallel_chunk_layout(count, grain, &grain);
+    if (chunk_count == 1) {
+        fn(begin, end, fn_user, out_result);
+        return;
+    }
+
+    // Keep the partials on the stack where possible. Either way, the block is over-allocated
+    // by a line so the partials can start on a line boundary.
+    u64 partial_stride = (result_size + PARALLEL_CACHE_LINE_SIZE - 1) & ~(u64)(PARALLEL_CACHE_LINE_SIZE - 1);
+    u64 partials_size = partial_stride * chunk_count + PARALLEL_CACHE_LINE_SIZE;
+    u8 stack_partials[PARALLEL_STACK_PARTIALS_SIZE + PARALLEL_CACHE_LINE_SIZE];
+    u8* block = partials_size <= sizeof(stack_partials) ? stack_partials : kallocate(partials_size, MEMORY_TAG_JOB);
+    u8* partials = (u8*)(((u64)block + PARALLEL_CACHE_LINE_SIZE - 1) & ~(u64)(PARALLEL_CACHE_LINE_SIZE - 1));
+
+    parallel_chunk chunks[PARALLEL_MAX_CHUNKS];
+    for (u64 i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = begin + i * grain;
+        chunks[i].end = (i == chunk_count - 1) ? end : chunks[i].begin + grain;
+        chunks[i].for_fn = 0;
+        chunks[i].reduce_fn = fn;
+        chunks[i].user = fn_user;
+        chunks[i].partial = partials + i * partial_stride;
+        kcopy_memory(chunks[i].partial, identity, result_size);
+    }
+
+    parallel_dispatch(chunks, chunk_count);
+
+    // Combine in range order so the result doesn't depend on scheduling.
+    for (u64 i = 0; i < chunk_count; ++i) {
+        combine(out_result, chunks[i].partial, combine_user);
+    }
+
+    if (block != stack_partials) {
+        kfree(block, partials_size, MEMORY_TAG_JOB);
+    }
+}
+
+void parallel_reduce(u64 begin, u64 end, u64 grain, u64 result_size, const void* identity, pfn_parallel_reduce fn, pfn_parallel_combine combine, void* user, void* out_result) {
+    parallel_reduce_internal(begin, end, grain, result_size, identity, fn, user, combine, user, out_result);
+}
+
+static void parallel_darray_for_chunk(u64 begin, u64 end, void* user) {
+    parallel_darray_context* context = (parallel_darray_context*)user;
+    context->for_fn(context->elements + begin * context->stride, begin, end - begin, context->user);
+}
+
+static void parallel_darray_reduce_chunk(u64 begin, u64 end, void* user, void* out_partial) {
+    parallel_darray_context* context = (parallel_darray_context*)user;
+    context->reduce_fn(context->elements + begin * context->stride, begin, end - begin, context->user, out_partial);
+}
+
+void parallel_for_darray(void* array, u64 grain, pfn_parallel_for_darray fn, void* user) {
+    if (!array || !fn) {
+        return;
+    }
+
+    parallel_darray_context context;
+    context.elements = (u8*)array;
+    context.stride = darray_stride(array);
+    context.for_fn = fn;
+    context.reduce_fn = 0;
+    context.user = user;
+    parallel_for(0, darray_length(array), grain, parallel_darray_for_chunk, &context);
+}
+
+void parallel_reduce_darray(const void* array, u64 grain, u64 result_size, const void* identity, pfn_parallel_reduce_darray fn, pfn_parallel_combine combine, void* user, void* out_result) {
+    if (!array || !fn) {
+        kcopy_memory(out_result, identity, result_size);
+        return;
+    }
+
+    parallel_darray_context context;
+    context.elements = (u8*)array;
+    context.stride = darray_stride((void*)array);
+    context.for_fn = 0;
+    context.reduce_fn = fn;
+    context.user = user;
+    parallel_reduce_internal(0, darray_length((void*)array), grain, result_size, identity, parallel_darray_reduce_chunk, &context, combine, user, out_result);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Data-parallel helpers built on the job system. A range is split into chunks of
+ * roughly `grain` items, the chunks are spread across the worker threads, and the
+ * calling thread works on the first chunk itself before waiting on the rest.
+ *
+ * Passing a grain of 0 sizes chunks automatically from the worker count. Ranges no
+ * bigger than one chunk, or calls made while the job system is not running, are
+ * executed inline on the calling thread.
+ */
+
+// Invoked once per chunk, covering the items [begin, end).
+typedef void (*pfn_parallel_for)(u64 begin, u64 end, void* user);
+
+// Invoked once per chunk covering [begin, end). Should fold the chunk into out_partial,
+// which starts out as a copy of the identity value.
+typedef void (*pfn_parallel_reduce)(u64 begin, u64 end, void* user, void* out_partial);
+
+// Folds partial into accumulator. Partials are combined in range order, on the calling thread.
+typedef void (*pfn_parallel_combine)(void* accumulator, const void* partial, void* user);
+
+// Invoked once per chunk of a darray, with a pointer to the first element of the chunk.
+typedef void (*pfn_parallel_for_darray)(void* elements, u64 first_index, u64 count, void* user);
+
+// Invoked once per chunk of a darray. See pfn_parallel_reduce.
+typedef void (*pfn_parallel_reduce_darray)(const void* elements, u64 first_index, u64 count, void* user, void* out_partial);
+
+/**
+ * @brief Invokes fn over the range [begin, end), split into chunks across the job system.
+ * Returns once every chunk has completed.
+ *
+ * @param begin The first index of the range.
+ * @param end One past the last index of the range.
+ * @param grain The preferred number of items per chunk. 0 to size automatically.
+ * @param fn The function to invoke per chunk.
+ * @param user User data passed to fn. Optional.
+ */
+KAPI void parallel_for(u64 begin, u64 end, u64 grain, pfn_parallel_for fn, void* user);
+
+/**
+ * @brief Reduces the range [begin, end) to a single value of result_size bytes. Each chunk
+ * reduces into its own partial, and the partials are then combined in order, so results are
+ * deterministic for a given grain and worker count.
+ *
+ * @param begin The first index of the range.
+ * @param end One past the last index of the range.
+ * @param grain The preferred number of items per chunk. 0 to size automatically.
+ * @param result_size The size of the result type in bytes.
+ * @param identity A pointer to the identity value (e.g. 0 for a sum). Each partial starts as a copy of it.
+ * @param fn The function to invoke per chunk.
+ * @param combine The function used to fold partials together.
+ * @param user User data passed to fn and combine. Optional.
+ * @param out_result A pointer to hold the result. Set to the identity for an empty range.
+ */
+KAPI void parallel_reduce(u64 begin, u64 end, u64 grain, u64 result_size, const void* identity, pfn_parallel_reduce fn, pfn_parallel_combine combine, void* user, void* out_result);
+
+/**
+ * @brief parallel_for over every element of a darray, using its length and stride.
+ */
+KAPI void parallel_for_darray(void* array, u64 grain, pfn_parallel_for_darray fn, void* user);
+
+/**
+ * @brief parallel_reduce over every element of a darray, using its length and stride.
+ */
+KAPI void parallel_reduce_darray(const void* array, u64 grain, u64 result_size, const void* identity, pfn_parallel_reduce_darray fn, pfn_parallel_combine combine, void* user, void* out_result);
@@ -0,0 +1,267 @@
+#include "systems/task_graph.h"
+
+#include "containers/darray.h"
+#include "core/kmemory.h"
+#include "core/kstring.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+#define INVALID_TASK_INDEX 0xFFFF
+
+b8 task_graph_create(task_graph* out_graph) {
+    if (!out_graph) {
+        return false;
+    }
+
+    kzero_memory(out_graph, sizeof(task_graph));
+    out_graph->tasks = darray_create(task_graph_task);
+    out_graph->priority = JOB_PRIORITY_NORMAL;
+    return true;
+}
+
+void task_graph_destroy(task_graph* graph) {
+    if (!graph) {
+        return;
+    }
+
+    if (graph->tasks) {
+        u64 task_count = darray_length(graph->tasks);
+        for (u64 i = 0; i < task_count; ++i) {
+            task_graph_task* task = &graph->tasks[i];
+            kfree(task->name, string_length(task->name) + 1, MEMORY_TAG_STRING);
+            if (task->dependents) {
+                darray_destroy(task->dependents);
+            }
+        }
+        darray_destroy(graph->tasks);
+    }
+
+    for (u8 i = 0; i < graph->resource_count; ++i) {
+        kfree(graph->resource_names[i], string_length(graph->resource_names[i]) + 1, MEMORY_TAG_STRING);
+    }
+
+    kzero_memory(graph, sizeof(task_graph));
+}
+
+u64 task_graph_resource(task_graph* graph, const char* name) {
+    if (!graph || !name) {
+        return 0;
+    }
+
+    for (u8 i = 0; i < graph->resource_count; ++i) {
+        if (strings_equal(graph->resource_names[i], name)) {
+            return 1ull << i;
+        }
+    }
+
+    if (graph->resource_count >= TASK_GRAPH_MAX_RESOURCES) {
+        KERROR("task_graph_resource - Resource limit of %u reached, cannot add '%s'.", TASK_GRAPH_MAX_RESOURCES, name);
+        return 0;
+    }
+
+    graph->resource_names[graph->resource_count] = string_duplicate(name);
+    u64 mask = 1ull << graph->resource_count;
+    graph->resource_count++;
+    return mask;
+}
+
+b8 task_graph_add_task(task_graph* graph, const task_desc* desc) {
+    if (!graph || !desc || !desc->execute) {
+        KERROR("task_graph_add_task - A graph and a task with an execute function are required.");
+        return false;
+    }
+
+    if (darray_length(graph->tasks) >= INVALID_TASK_INDEX) {
+        KERROR("task_graph_add_task - Too many tasks.");
+        return false;
+    }
+
+    task_graph_task task;
+    kzero_memory(&task, sizeof(task_graph_task));
+    task.name = string_duplicate(desc->name ? desc->name : "unnamed");
+    task.execute = desc->execute;
+    task.user = desc->user;
+    task.reads = desc->reads;
+    task.writes = desc->writes;
+    task.main_thread = desc->main_thread;
+    task.dependents = darray_create(u16);
+    darray_push(graph->tasks, task);
+
+    graph->dirty = true;
+    return true;
+}
+
+void task_graph_build(task_graph* graph) {
+    if (!graph) {
+        return;
+    }
+
+    u16 task_count = (u16)darray_length(graph->tasks);
+    for (u16 i = 0; i < task_count; ++i) {
+        _darray_clear(graph->tasks[i].dependents);
+        graph->tasks[i].dependency_count = 0;
+        graph->tasks[i].graph = graph;
+    }
+
+    // Registration order is the serial order, so edges only ever point forward.
+    for (u16 j = 0; j < task_count; ++j) {
+        task_graph_task* later = &graph->tasks[j];
+        for (u16 i = 0; i < j; ++i) {
+            task_graph_task* earlier = &graph->tasks[i];
+            b8 read_after_write = (earlier->writes & later->reads) != 0;
+            b8 write_after_write = (earlier->writes & later->writes) != 0;
+            b8 write_after_read = (earlier->reads & later->writes) != 0;
+            if (read_after_write || write_after_write || write_after_read) {
+                darray_push(earlier->dependents, j);
+                later->dependency_count++;
+            }
+        }
+    }
+
+    graph->dirty = false;
+}
+
+static void task_graph_task_job(void* param);
+
+static void task_graph_submit(task_graph_task* task) {
+    job_decl job;
+    job.entry_point = task_graph_task_job;
+    job.param = task;
+    if (task->main_thread) {
+        job_system_run_on_main_thread(&job, 1, &task->graph->counter);
+    } else {
+        job_system_run_with_priority(&job, 1, task->graph->priority, &task->graph->counter);
+    }
+}
+
+static void task_graph_run_task(task_graph_task* task) {
+    task->start_ticks = platform_get_ticks();
+    // Once anything has failed, the rest of the graph is skipped.
+    if (!__atomic_load_n(&task->graph->failed, __ATOMIC_ACQUIRE)) {
+        if (!task->execute(task->user)) {
+            KERROR("Task '%s' failed.", task->name);
+            __atomic_store_n(&task->graph->failed, true, __ATOMIC_RELEASE);
+        }
+    }
+    task->duration = platform_ticks_to_seconds(platform_get_ticks() - task->start_ticks);
+    task->total_duration += task->duration;
+}
+
+static void task_graph_task_job(void* param) {
+    task_graph_task* task = (task_graph_task*)param;
+    task_graph_run_task(task);
+
+    // Release dependents. Submitted from within this job, so the graph's counter
+    // can't reach zero before they are accounted for.
+    task_graph* graph = task->graph;
+    u64 dependent_count = darray_length(task->dependents);
+    for (u64 i = 0; i < dependent_count; ++i) {
+        task_graph_task* dependent = &graph->tasks[task->dependents[i]];
+        if (__atomic_sub_fetch(&dependent->remaining_dependencies, 1, __ATOMIC_ACQ_REL) == 0) {
+            task_graph_submit(dependent);
+        }
+    }
+}
+
+b8 task_graph_execute(task_graph* graph) {
+    if (!graph) {
+        return false;
+    }
+
+    if (graph->dirty) {
+        task_graph_build(graph);
+    }
+
+    u64 task_count = darray_length(graph->tasks);
+    graph->failed = false;
+    graph->start_ticks = platform_get_ticks();
+
+    if (job_system_worker_count() == 0) {
+        // No job system to dispatch to. Registration order is always a valid order.
+        for (u64 i = 0; i < task_count; ++i) {
+            task_graph_run_task(&graph->tasks[i]);
+        }
+    } else {
+        for (u64 i = 0; i < task_count; ++i) {
+            graph->tasks[i].remaining_dependencies = graph->tasks[i].dependency_count;
+        }
+
+        // Kick off every task with no dependencies; the rest follow as they are released.
+        // Main thread tasks are picked up by this thread while it waits.
+        graph->counter.value = 0;
+        for (u64 i = 0; i < task_count; ++i) {
+            if (graph->tasks[i].dependency_count == 0) {
+                task_graph_submit(&graph->tasks[i]);
+            }
+        }
+        job_system_wait_for_counter(&graph->counter);
+    }
+
+    graph->duration = platform_ticks_to_seconds(platform_get_ticks() - graph->start_ticks);
+    graph->total_duration += graph->duration;
+    graph->execution_count++;
+
+    return !graph->failed;
+}
+
+void task_graph_report(const task_graph* graph) {
+    if (!graph || graph->execution_count == 0) {
+        return;
+    }
+
+    u16 task_count = (u16)darray_length(graph->tasks);
+    f64 executions = (f64)graph->execution_count;
+    KINFO("Task graph: %u tasks, %llu executions, %.3fms average.", task_count, graph->execution_count, (graph->total_duration / executions) * 1000.0);
+    if (task_count == 0) {
+        return;
+    }
+
+    // Longest path ending at each task, using average durations. Edges only point
+    // forward, so a single pass in registration order is enough.
+    f64* path = kallocate(sizeof(f64) * task_count, MEMORY_TAG_JOB);
+    u16* previous = kallocate(sizeof(u16) * task_count, MEMORY_TAG_JOB);
+    for (u16 i = 0; i < task_count; ++i) {
+        path[i] = graph->tasks[i].total_duration / executions;
+        previous[i] = INVALID_TASK_INDEX;
+    }
+
+    f64 serial_time = 0;
+    u16 critical_end = 0;
+    for (u16 i = 0; i < task_count; ++i) {
+        const task_graph_task* task = &graph->tasks[i];
+        f64 average = task->total_duration / executions;
+        serial_time += average;
+        KINFO("  %s: %.3fms", task->name, average * 1000.0);
+
+        u64 dependent_count = darray_length(task->dependents);
+        for (u64 d = 0; d < dependent_count; ++d) {
+            u16 j = task->dependents[d];
+            f64 candidate = path[i] + graph->tasks[j].total_duration / executions;
+            if (candidate > path[j]) {
+                path[j] = candidate;
+                previous[j] = i;
+            }
+        }
+
+        if (path[i] > path[critical_end]) {
+            critical_end = i;
+        }
+    }
+
+    KINFO("Critical path: %.3fms of %.3fms serial work:", path[critical_end] * 1000.0, serial_time * 1000.0);
+
+    // Walk back from the end, then print in execution order.
+    u16* chain = kallocate(sizeof(u16) * task_count, MEMORY_TAG_JOB);
+    u16 chain_length = 0;
+    for (u16 i = critical_end; i != INVALID_TASK_INDEX; i = previous[i]) {
+        chain[chain_length++] = i;
+    }
+    for (u16 i = chain_length; i > 0; --i) {
+        const task_graph_task* task = &graph->tasks[chain[i - 1]];
+        KINFO("  -> %s (%.3fms)", task->name, (task->total_duration / executions) * 1000.0);
+    }
+
+    kfree(chain, sizeof(u16) * task_count, MEMORY_TAG_JOB);
+    kfree(previous, sizeof(u16) * task_count, MEMORY_TAG_JOB);
+    kfree(path, sizeof(f64) * task_count, MEMORY_TAG_JOB);
+}
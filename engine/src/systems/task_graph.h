@@ -0,0 +1,139 @@
+#pragma once
+
+#include "defines.h"
+
+#include "systems/job_system.h"
+
+// The maximum number of distinct resources a graph can track, one per bit of a resource mask.
+#define TASK_GRAPH_MAX_RESOURCES 64
+
+/**
+ * @brief A task's work. Runs on a job system worker, or the main thread for main thread tasks.
+ * @param user The user data supplied when the task was added.
+ * @returns True on success. Returning false fails the execution, and tasks that
+ * have not started yet are skipped.
+ */
+typedef b8 (*pfn_task_execute)(void* user);
+
+/**
+ * @brief Describes a task to be added to a task graph. Reads and writes are masks of
+ * resources obtained from task_graph_resource.
+ */
+typedef struct task_desc {
+    // The name of the task, used in reports. Copied.
+    const char* name;
+    // The function which performs the task. Required.
+    pfn_task_execute execute;
+    // Data passed to execute. Optional.
+    void* user;
+    // The resources read by the task.
+    u64 reads;
+    // The resources written by the task.
+    u64 writes;
+    // If true, the task is always executed on the main thread.
+    b8 main_thread;
+} task_desc;
+
+typedef struct task_graph_task {
+    char* name;
+    pfn_task_execute execute;
+    void* user;
+    u64 reads;
+    u64 writes;
+    b8 main_thread;
+
+    // Indices of tasks which depend on this one. darray.
+    u16* dependents;
+    u16 dependency_count;
+
+    // Per-execution state.
+    struct task_graph* graph;
+    volatile i32 remaining_dependencies;
+    // platform_get_ticks when the task started.
+    u64 start_ticks;
+    // In seconds, as are the other durations.
+    f64 duration;
+
+    // Accumulated across executions, for reporting.
+    f64 total_duration;
+} task_graph_task;
+
+/**
+ * @brief A set of tasks with declared resource access, executed as a DAG on the job
+ * system. Tasks are ordered by registration: a task depends on every earlier task
+ * which writes a resource it reads or writes, or reads a resource it writes. Tasks
+ * with no such conflict run concurrently.
+ */
+typedef struct task_graph {
+    // darray of tasks, in registration order.
+    task_graph_task* tasks;
+    // Resource names, indexed by bit.
+    char* resource_names[TASK_GRAPH_MAX_RESOURCES];
+    u8 resource_count;
+
+    // Set whenever tasks change. The dependencies are rebuilt on the next execution.
+    b8 dirty;
+    // The job priority tasks are submitted at. Defaults to JOB_PRIORITY_NORMAL.
+    job_priority priority;
+
+    // Per-execution state.
+    job_counter counter;
+    volatile b8 failed;
+    // platform_get_ticks when the execution started.
+    u64 start_ticks;
+    f64 duration;
+
+    // Accumulated across executions, for reporting.
+    u64 execution_count;
+    f64 total_duration;
+} task_graph;
+
+/**
+ * @brief Creates a new, empty task graph.
+ * @param out_graph A pointer to hold the created graph.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 task_graph_create(task_graph* out_graph);
+
+/**
+ * @brief Destroys the given task graph. Must not be executing.
+ */
+KAPI void task_graph_destroy(task_graph* graph);
+
+/**
+ * @brief Obtains the mask for the resource with the given name, registering it if it does not exist.
+ * @param graph A pointer to the graph.
+ * @param name The name of the resource.
+ * @returns The resource's mask, or 0 if the resource limit has been reached.
+ */
+KAPI u64 task_graph_resource(task_graph* graph, const char* name);
+
+/**
+ * @brief Adds a task to the graph.
+ * @param graph A pointer to the graph.
+ * @param desc A description of the task.
+ * @returns True on success; otherwise false.
+ */
+KAPI b8 task_graph_add_task(task_graph* graph, const task_desc* desc);
+
+/**
+ * @brief Builds the dependencies between tasks. Called automatically by
+ * task_graph_execute when tasks have changed, so calling it explicitly is only
+ * needed to front-load the cost.
+ */
+KAPI void task_graph_build(task_graph* graph);
+
+/**
+ * @brief Executes every task in the graph on the job system, each as soon as the tasks
+ * it depends on have completed, and waits for all of them. Tasks run serially on the
+ * calling thread if the job system is not running. A graph containing main thread tasks
+ * must be executed from the main thread.
+ * @returns True if every task succeeded; otherwise false.
+ */
+KAPI b8 task_graph_execute(task_graph* graph);
+
+/**
+ * @brief Logs the average duration of each task and the critical path through the
+ * graph: the chain of dependent tasks which bounds how fast the graph can execute.
+ */
+KAPI void task_graph_report(const task_graph* graph);
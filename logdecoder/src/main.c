@@ -0,0 +1,21 @@
+#include <core/logger.h>
+#include <core/logger_deferred.h>
+
+#include <stdio.h>
+
+/**
+ * Turns a binary log, written when logger_config.binary_file_path is set, into text.
+ * Usage: logdecoder <binary log> <text output>
+ */
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        printf("Usage: logdecoder <binary log> <text output>\n");
+        return 1;
+    }
+
+    if (!log_binary_decode(argv[1], argv[2])) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -6,7 +6,7 @@
 #include <core/input.h>
 
 b8 game_initialize(game* game_inst) {
-    KDEBUG("game_initialized() called!");
+    KDEBUG_CAT(LOG_CATEGORY_GAME, "game_initialized() called!");
     return true;
 }
 
@@ -15,17 +15,17 @@ b8 game_update(game* game_inst, f32 delta_time) {
     u64 prev_alloc_count = alloc_count;
     alloc_count = get_memory_alloc_count();
     if (input_is_key_up('M') && input_was_key_down('M')) {
-        KDEBUG("Allocations: %llu (%llu this frame)", alloc_count, alloc_count - prev_alloc_count);
+        KDEBUG_CAT(LOG_CATEGORY_GAME, "Allocations: %llu (%llu this frame)", alloc_count, alloc_count - prev_alloc_count);
     }
 
     return true;
 }
 
-b8 game_render(game* game_inst, f32 delta_time) {
+b8 game_render(game* game_inst, f32 delta_time, f32 alpha) {
     //KDEBUG("game_render() called!");
     return true;
 }
 
 void game_on_resize(game* game_inst, u32 width, u32 height) {
-    KDEBUG("game_on_resize() called!");
+    KDEBUG_CAT(LOG_CATEGORY_GAME, "game_on_resize() called!");
 }
\ No newline at end of file
@@ -0,0 +1,440 @@
+#include "event_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <core/kmemory.h>
+#include <core/event.h>
+#include <systems/job_system.h>
+
+#define TEST_EVENT_CODE 0x200
+#define TEST_EVENT_CODE_REPOST 0x201
+#define TEST_EVENT_CODE_PAYLOAD 0x202
+
+typedef struct event_test_listener {
+    u32 received_count;
+    u32 received[8];
+} event_test_listener;
+
+static b8 on_test_event(u16 code, void* sender, void* listener_inst, event_context context) {
+    event_test_listener* listener = listener_inst;
+    if (listener->received_count < 8) {
+        listener->received[listener->received_count] = context.data.u32[0];
+    }
+    listener->received_count++;
+
+    if (code == TEST_EVENT_CODE_REPOST) {
+        // Posted during dispatch, so should be held for the next one.
+        event_context repost = {0};
+        repost.data.u32[0] = 100;
+        event_post(TEST_EVENT_CODE, 0, repost);
+    }
+    return false;
+}
+
+u8 event_post_should_defer_until_dispatch() {
+    u64 size = 0;
+    void* state = test_system_start(size, event_system_initialize);
+
+    event_test_listener listener = {0};
+    expect_to_be_true(event_register(TEST_EVENT_CODE, &listener, on_test_event) != INVALID_EVENT_HANDLE);
+    expect_to_be_true(event_register(TEST_EVENT_CODE_REPOST, &listener, on_test_event) != INVALID_EVENT_HANDLE);
+
+    for (u32 i = 0; i < 3; ++i) {
+        event_context context = {0};
+        context.data.u32[0] = i;
+        expect_to_be_true(event_post(i == 1 ? TEST_EVENT_CODE_REPOST : TEST_EVENT_CODE, 0, context));
+    }
+    expect_should_be(0, listener.received_count);
+
+    // Dispatched in the order posted, excluding the event posted by the listener.
+    expect_should_be(3, event_dispatch_queued());
+    expect_should_be(3, listener.received_count);
+    for (u32 i = 0; i < 3; ++i) {
+        expect_should_be(i, listener.received[i]);
+    }
+
+    expect_should_be(1, event_dispatch_queued());
+    expect_should_be(100, listener.received[3]);
+    expect_should_be(0, event_dispatch_queued());
+
+    // Immediate mode is unaffected.
+    event_context context = {0};
+    context.data.u32[0] = 7;
+    event_fire(TEST_EVENT_CODE, 0, context);
+    expect_should_be(5, listener.received_count);
+    expect_should_be(7, listener.received[4]);
+
+    test_system_stop(state, size, event_system_shutdown);
+    return true;
+}
+
+static b8 on_counted_event(u16 code, void* sender, void* listener_inst, event_context context) {
+    ((u32*)listener_inst)[0] += code;
+    return false;
+}
+
+u8 event_should_route_system_and_user_codes() {
+    u64 size = 0;
+    void* state = test_system_start(size, event_system_initialize);
+
+    // Enough user codes to grow the table several times, across the whole code range.
+    u32 totals[2] = {0};
+    for (u32 code = 1; code < 0xFFFF; code += 97) {
+        expect_to_be_true(event_register((u16)code, &totals[0], on_counted_event) != INVALID_EVENT_HANDLE);
+    }
+    // Drop every other code, then add a second listener to the rest, forcing rebuilds that skip empty codes.
+    for (u32 code = 1, i = 0; code < 0xFFFF; code += 97, ++i) {
+        if (i & 1) {
+            expect_to_be_true(event_unregister((u16)code, &totals[0], on_counted_event));
+        }
+    }
+    for (u32 code = 50; code < 0xFFFF; code += 89) {
+        expect_to_be_true(event_register((u16)code, &totals[1], on_counted_event) != INVALID_EVENT_HANDLE);
+    }
+
+    u32 expected[2] = {0};
+    for (u32 code = 1, i = 0; code < 0xFFFF; code += 97, ++i) {
+        if (!(i & 1)) {
+            expected[0] += code;
+        }
+    }
+    for (u32 code = 50; code < 0xFFFF; code += 89) {
+        expected[1] += code;
+    }
+
+    event_context context = {0};
+    for (u32 code = 0; code < 0x10000; ++code) {
+        event_fire((u16)code, 0, context);
+    }
+    expect_should_be(expected[0], totals[0]);
+    expect_should_be(expected[1], totals[1]);
+    expect_to_be_false(event_unregister(0x1234, &totals[0], on_counted_event));
+
+    test_system_stop(state, size, event_system_shutdown);
+    return true;
+}
+
+#define TEST_EVENT_CODE_LAST_WINS 0x300
+#define TEST_EVENT_CODE_ACCUMULATE 0x301
+
+static void accumulate_test_event(event_context* total, event_context next) {
+    total->data.i32[0] += next.data.i32[0];
+}
+
+u8 event_dispatch_should_coalesce() {
+    u64 size = 0;
+    void* state = test_system_start(size, event_system_initialize);
+
+    // Policies may be set before anyone listens.
+    expect_to_be_true(event_set_coalescing(TEST_EVENT_CODE_LAST_WINS, EVENT_COALESCE_LAST_WINS, 0));
+    expect_to_be_true(event_set_coalescing(TEST_EVENT_CODE_ACCUMULATE, EVENT_COALESCE_ACCUMULATE, accumulate_test_event));
+    expect_to_be_false(event_set_coalescing(TEST_EVENT_CODE, EVENT_COALESCE_ACCUMULATE, 0));
+
+    event_test_listener listener = {0};
+    expect_to_be_true(event_register(TEST_EVENT_CODE, &listener, on_test_event) != INVALID_EVENT_HANDLE);
+    expect_to_be_true(event_register(TEST_EVENT_CODE_LAST_WINS, &listener, on_test_event) != INVALID_EVENT_HANDLE);
+    expect_to_be_true(event_register(TEST_EVENT_CODE_ACCUMULATE, &listener, on_test_event) != INVALID_EVENT_HANDLE);
+
+    // last wins: 1, 2, 3. accumulate: 10 + 20. uncoalesced: 7, 8.
+    u16 codes[7] = {TEST_EVENT_CODE_LAST_WINS, TEST_EVENT_CODE_ACCUMULATE, TEST_EVENT_CODE, TEST_EVENT_CODE_LAST_WINS, TEST_EVENT_CODE_ACCUMULATE, TEST_EVENT_CODE_LAST_WINS, TEST_EVENT_CODE};
+    u32 values[7] = {1, 10, 7, 2, 20, 3, 8};
+    for (u32 i = 0; i < 7; ++i) {
+        event_context context = {0};
+        context.data.u32[0] = values[i];
+        expect_to_be_true(event_post(codes[i], 0, context));
+    }
+
+    // Each coalesced code is delivered once, where its last event was.
+    expect_should_be(4, event_dispatch_queued());
+    expect_should_be(4, listener.received_count);
+    expect_should_be(7, listener.received[0]);
+    expect_should_be(30, listener.received[1]);
+    expect_should_be(3, listener.received[2]);
+    expect_should_be(8, listener.received[3]);
+
+    // Turning coalescing off delivers everything again.
+    expect_to_be_true(event_set_coalescing(TEST_EVENT_CODE_LAST_WINS, EVENT_COALESCE_NONE, 0));
+    for (u32 i = 0; i < 2; ++i) {
+        event_context context = {0};
+        event_post(TEST_EVENT_CODE_LAST_WINS, 0, context);
+    }
+    expect_should_be(2, event_dispatch_queued());
+
+    test_system_stop(state, size, event_system_shutdown);
+    return true;
+}
+
+#define MASS_LISTENER_COUNT 10000
+
+typedef struct ordered_listener {
+    u32* log;
+    u32* log_count;
+    u32 id;
+} ordered_listener;
+
+static b8 on_ordered_event(u16 code, void* sender, void* listener_inst, event_context context) {
+    ordered_listener* listener = listener_inst;
+    listener->log[(*listener->log_count)++] = listener->id;
+    return false;
+}
+
+static b8 on_mass_event(u16 code, void* sender, void* listener_inst, event_context context) {
+    (*(u32*)listener_inst)++;
+    return false;
+}
+
+u8 event_handles_should_unregister_and_order() {
+    u64 size = 0;
+    void* state = test_system_start(size, event_system_initialize);
+
+    // Registered out of order; dispatched by order key, then registration.
+    u32 log[8];
+    u32 log_count = 0;
+    ordered_listener listeners[4];
+    i32 orders[4] = {10, -5, 10, 0};
+    event_handle handles[4];
+    for (u32 i = 0; i < 4; ++i) {
+        listeners[i].log = log;
+        listeners[i].log_count = &log_count;
+        listeners[i].id = i;
+        handles[i] = event_register_ordered(TEST_EVENT_CODE, &listeners[i], on_ordered_event, orders[i]);
+        expect_to_be_true(handles[i] != INVALID_EVENT_HANDLE);
+    }
+
+    event_context context = {0};
+    event_fire(TEST_EVENT_CODE, 0, context);
+    expect_should_be(4, log_count);
+    expect_should_be(1, log[0]);
+    expect_should_be(3, log[1]);
+    expect_should_be(0, log[2]);
+    expect_should_be(2, log[3]);
+
+    // Unregistering by handle leaves the others in order, and stale handles are rejected.
+    expect_to_be_true(event_unregister_handle(handles[3]));
+    expect_to_be_false(event_unregister_handle(handles[3]));
+    log_count = 0;
+    event_fire(TEST_EVENT_CODE, 0, context);
+    expect_should_be(3, log_count);
+    expect_should_be(1, log[0]);
+    expect_should_be(0, log[1]);
+    expect_should_be(2, log[2]);
+
+    // A reused handle slot doesn't revive the old handle.
+    event_handle reused = event_register(TEST_EVENT_CODE, &listeners[3], on_ordered_event);
+    expect_to_be_false(event_unregister_handle(handles[3]));
+    expect_to_be_true(event_unregister_handle(reused));
+    for (u32 i = 0; i < 3; ++i) {
+        expect_to_be_true(event_unregister_handle(handles[i]));
+    }
+
+    // Mass subscribe and unsubscribe, as on scene load/unload.
+    static event_handle mass_handles[MASS_LISTENER_COUNT];
+    u32 calls = 0;
+    for (u32 i = 0; i < MASS_LISTENER_COUNT; ++i) {
+        mass_handles[i] = event_register(TEST_EVENT_CODE_REPOST, &calls, on_mass_event);
+    }
+    event_fire(TEST_EVENT_CODE_REPOST, 0, context);
+    expect_should_be(MASS_LISTENER_COUNT, calls);
+    for (u32 i = 0; i < MASS_LISTENER_COUNT; i += 2) {
+        expect_to_be_true(event_unregister_handle(mass_handles[i]));
+    }
+    calls = 0;
+    event_fire(TEST_EVENT_CODE_REPOST, 0, context);
+    expect_should_be(MASS_LISTENER_COUNT / 2, calls);
+
+    test_system_stop(state, size, event_system_shutdown);
+    return true;
+}
+
+#define POSTING_JOB_COUNT 8
+// Kept within the queue capacity, in case every job runs before the first dispatch.
+#define EVENTS_PER_JOB 100
+
+typedef struct posting_test_data {
+    // The next sequence number expected from each posting job.
+    u32 next_expected[POSTING_JOB_COUNT];
+    u32 received_count;
+    u32 out_of_order_count;
+    u32 corrupt_payload_count;
+} posting_test_data;
+
+typedef struct churn_listener {
+    volatile i32 calls;
+} churn_listener;
+
+static b8 on_posted_event(u16 code, void* sender, void* listener_inst, event_context context) {
+    posting_test_data* data = listener_inst;
+    u32 job = context.data.u32[0];
+    u32 sequence = context.data.u32[1];
+    if (data->next_expected[job] != sequence) {
+        data->out_of_order_count++;
+    }
+    data->next_expected[job] = sequence + 1;
+    data->received_count++;
+    return false;
+}
+
+// Larger than event_context can carry.
+typedef struct test_payload {
+    u32 job;
+    u32 sequence;
+    u8 pattern[40];
+} test_payload;
+
+static b8 on_posted_payload(u16 code, void* sender, void* listener_inst, event_context context) {
+    posting_test_data* data = listener_inst;
+    const test_payload* payload = context.data.payload.data;
+    b8 intact = context.data.payload.size == sizeof(test_payload);
+    for (u32 i = 0; intact && i < sizeof(payload->pattern); ++i) {
+        intact = payload->pattern[i] == (u8)(payload->sequence + i);
+    }
+    if (!intact) {
+        data->corrupt_payload_count++;
+    }
+
+    // Ordered along with the job's other events.
+    event_context ordering = {0};
+    ordering.data.u32[0] = payload->job;
+    ordering.data.u32[1] = payload->sequence;
+    return on_posted_event(code, sender, listener_inst, ordering);
+}
+
+static b8 on_churn_event(u16 code, void* sender, void* listener_inst, event_context context) {
+    __atomic_add_fetch(&((churn_listener*)listener_inst)->calls, 1, __ATOMIC_ACQ_REL);
+    return false;
+}
+
+// Outlives the jobs, as a dispatch already in progress may still call it after unregistering.
+static churn_listener churn;
+
+static void posting_job(void* param) {
+    u32 job = (u32)(u64)param;
+    for (u32 i = 0; i < EVENTS_PER_JOB; ++i) {
+        if (i & 1) {
+            test_payload payload;
+            payload.job = job;
+            payload.sequence = i;
+            for (u32 p = 0; p < sizeof(payload.pattern); ++p) {
+                payload.pattern[p] = (u8)(i + p);
+            }
+            event_post_payload(TEST_EVENT_CODE_PAYLOAD, 0, &payload, sizeof(test_payload));
+        } else {
+            event_context context = {0};
+            context.data.u32[0] = job;
+            context.data.u32[1] = i;
+            event_post(TEST_EVENT_CODE, 0, context);
+        }
+
+        // Churn the listener list while the main thread dispatches.
+        if ((i & 15) == 0) {
+            event_register(TEST_EVENT_CODE, &churn, on_churn_event);
+            event_unregister(TEST_EVENT_CODE, &churn, on_churn_event);
+        }
+    }
+}
+
+u8 event_post_should_be_thread_safe() {
+    job_system_config config = {0};
+    config.worker_count = 4;
+    u64 job_size = 0;
+    void* job_state = test_system_start(job_size, job_system_initialize, &config);
+    expect_should_be(4, job_system_worker_count());
+
+    u64 size = 0;
+    void* state = test_system_start(size, event_system_initialize);
+
+    posting_test_data data = {0};
+    expect_to_be_true(event_register(TEST_EVENT_CODE, &data, on_posted_event) != INVALID_EVENT_HANDLE);
+    expect_to_be_true(event_register(TEST_EVENT_CODE_PAYLOAD, &data, on_posted_payload) != INVALID_EVENT_HANDLE);
+
+    job_decl jobs[POSTING_JOB_COUNT];
+    for (u32 i = 0; i < POSTING_JOB_COUNT; ++i) {
+        jobs[i].entry_point = posting_job;
+        jobs[i].param = (void*)(u64)i;
+    }
+    job_counter counter = {0};
+    job_system_run(jobs, POSTING_JOB_COUNT, &counter);
+
+    // Dispatch concurrently with posting, then pick up the remainder.
+    while (!job_counter_is_complete(&counter)) {
+        event_dispatch_queued();
+    }
+    job_system_wait_for_counter(&counter);
+    event_dispatch_queued();
+
+    expect_should_be(POSTING_JOB_COUNT * EVENTS_PER_JOB, data.received_count);
+    expect_should_be(0, data.out_of_order_count);
+    expect_should_be(0, data.corrupt_payload_count);
+
+    test_system_stop(state, size, event_system_shutdown);
+    test_system_stop(job_state, job_size, job_system_shutdown);
+    return true;
+}
+
+static b8 on_test_event_handle(u16 code, void* sender, void* listener_inst, event_context context) {
+    return true;
+}
+
+u8 event_instrumentation_should_record_stats() {
+    u64 size = 0;
+    void* state = test_system_start(size, event_system_initialize);
+
+    event_test_listener listener = {0};
+    event_register(TEST_EVENT_CODE, &listener, on_test_event);
+    event_register(TEST_EVENT_CODE, 0, on_test_event_handle);
+
+    // Nothing is recorded until enabled.
+    event_context context = {0};
+    event_fire(TEST_EVENT_CODE, 0, context);
+    event_code_stats stats;
+    expect_to_be_false(event_get_code_stats(TEST_EVENT_CODE, &stats));
+
+    event_instrumentation_enable(true);
+    expect_to_be_true(event_instrumentation_enabled());
+    for (u32 i = 0; i < 3; ++i) {
+        event_fire(TEST_EVENT_CODE, 0, context);
+    }
+    expect_to_be_true(event_post(TEST_EVENT_CODE, 0, context));
+    event_dispatch_queued();
+
+    expect_to_be_true(event_get_code_stats(TEST_EVENT_CODE, &stats));
+    expect_should_be(TEST_EVENT_CODE, stats.code);
+    expect_should_be(4, stats.fire_count);
+    expect_should_be(4, stats.handled_count);
+    expect_should_be(2, stats.listener_count);
+    expect_should_be(2, stats.max_listener_count);
+    expect_to_be_true(stats.last_handled_by == on_test_event_handle);
+    expect_to_be_true(stats.max_time <= stats.total_time);
+
+    event_listener_stats listeners[4];
+    expect_should_be(2, event_get_listener_stats(TEST_EVENT_CODE, 4, listeners));
+    for (u32 i = 0; i < 2; ++i) {
+        expect_should_be(4, listeners[i].call_count);
+        u64 expected_handled = listeners[i].callback == on_test_event_handle ? 4 : 0;
+        expect_should_be(expected_handled, listeners[i].handled_count);
+    }
+
+    // Recorded stats are kept when disabled, until reset.
+    event_instrumentation_enable(false);
+    event_fire(TEST_EVENT_CODE, 0, context);
+    expect_to_be_true(event_get_code_stats(TEST_EVENT_CODE, &stats));
+    expect_should_be(4, stats.fire_count);
+    event_reset_stats();
+    expect_to_be_false(event_get_code_stats(TEST_EVENT_CODE, &stats));
+    expect_should_be(0, event_get_listener_stats(TEST_EVENT_CODE, 0, 0));
+
+    test_system_stop(state, size, event_system_shutdown);
+    return true;
+}
+
+void event_register_tests() {
+    test_manager_register_test(event_post_should_defer_until_dispatch, "Posted events should be dispatched in order, in a batch");
+    test_manager_register_test(event_should_route_system_and_user_codes, "Events should reach listeners of system and user codes");
+    test_manager_register_test(event_dispatch_should_coalesce, "Queued events should be coalesced by policy");
+    test_manager_register_test(event_handles_should_unregister_and_order, "Event handles should unregister in any order and keep dispatch ordered");
+    test_manager_register_test(event_post_should_be_thread_safe, "Events and payloads posted from workers should all be dispatched in order");
+    test_manager_register_test(event_instrumentation_should_record_stats, "Event instrumentation should record fires, fan-out and listener timings");
+}
@@ -0,0 +1,63 @@
+#include "fixed_timestep_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+
+#include <core/fixed_timestep.h>
+
+u8 fixed_timestep_should_step_independently_of_frame_rate() {
+    fixed_timestep timestep;
+    fixed_timestep_create(100.0, 0, &timestep);
+    expect_should_be(5, timestep.max_steps);
+
+    // Frames shorter than a step carry their time over.
+    expect_should_be(0, fixed_timestep_advance(&timestep, 0.004));
+    expect_float_to_be(0.4f, fixed_timestep_alpha(&timestep));
+    expect_should_be(1, fixed_timestep_advance(&timestep, 0.008));
+    expect_float_to_be(0.2f, fixed_timestep_alpha(&timestep));
+
+    // Longer frames take several steps.
+    expect_should_be(3, fixed_timestep_advance(&timestep, 0.03));
+    expect_float_to_be(0.2f, fixed_timestep_alpha(&timestep));
+
+    // The same time in different frame sizes takes the same number of steps.
+    fixed_timestep fast;
+    fixed_timestep slow;
+    fixed_timestep_create(60.0, 0, &fast);
+    fixed_timestep_create(60.0, 0, &slow);
+    u32 fast_steps = 0;
+    u32 slow_steps = 0;
+    for (u32 i = 0; i < 240; ++i) {
+        fast_steps += fixed_timestep_advance(&fast, 1.0 / 240.0);
+    }
+    for (u32 i = 0; i < 30; ++i) {
+        slow_steps += fixed_timestep_advance(&slow, 1.0 / 30.0);
+    }
+    // Either may be a step short through rounding, which comes through the next frame.
+    expect_to_be_true(fast_steps >= 59 && fast_steps <= 60);
+    expect_to_be_true(slow_steps >= 59 && slow_steps <= 60);
+    return true;
+}
+
+u8 fixed_timestep_should_clamp_steps_per_frame() {
+    fixed_timestep timestep;
+    fixed_timestep_create(100.0, 4, &timestep);
+
+    // A long stall only gets max_steps, and the rest of the time is dropped.
+    expect_should_be(4, fixed_timestep_advance(&timestep, 1.005));
+    expect_should_be(1, timestep.clamped_count);
+    expect_float_to_be(0.96f, (f32)timestep.dropped_time);
+    expect_float_to_be(0.5f, fixed_timestep_alpha(&timestep));
+
+    // It doesn't carry on into the frames after.
+    expect_should_be(1, fixed_timestep_advance(&timestep, 0.01));
+    expect_should_be(1, timestep.clamped_count);
+    expect_should_be(5, timestep.step_count);
+    return true;
+}
+
+void fixed_timestep_register_tests() {
+    test_manager_register_test(fixed_timestep_should_step_independently_of_frame_rate, "Fixed timestep should step independently of frame rate");
+    test_manager_register_test(fixed_timestep_should_clamp_steps_per_frame, "Fixed timestep should clamp steps per frame");
+}
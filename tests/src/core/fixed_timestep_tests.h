@@ -0,0 +1,3 @@
+#pragma once
+
+void fixed_timestep_register_tests();
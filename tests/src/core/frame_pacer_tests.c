@@ -0,0 +1,50 @@
+#include "frame_pacer_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+
+#include <core/frame_pacer.h>
+#include <platform/platform.h>
+
+u8 frame_pacer_should_hold_target_rate() {
+    frame_pacer pacer;
+    frame_pacer_create(200.0, 0, &pacer);
+
+    // The first wait only starts the schedule.
+    frame_pacer_wait(&pacer);
+    f64 start_time = platform_get_absolute_time();
+    for (u32 i = 0; i < 40; ++i) {
+        frame_pacer_wait(&pacer);
+    }
+    f64 elapsed = platform_get_absolute_time() - start_time;
+
+    frame_pacer_stats stats;
+    frame_pacer_get_stats(&pacer, &stats);
+    expect_should_be(40, stats.wait_count + stats.late_count);
+    // Deadlines are kept to the schedule, so 40 frames at 5ms take at least about 200ms. There's
+    // no upper bound, as the machine running the tests may be busy.
+    expect_to_be_true(elapsed > 0.195);
+    // Some frames must actually have been waited on, rather than all counted late.
+    expect_to_be_true(stats.wait_count > 0);
+    expect_to_be_true(stats.max_error >= stats.mean_error);
+
+    // A frame running long isn't waited on, and the next starts a new schedule.
+    platform_sleep(10);
+    frame_pacer_wait(&pacer);
+    frame_pacer_get_stats(&pacer, &stats);
+    expect_to_be_true(stats.late_count >= 1);
+
+    // Unlimited doesn't wait at all, so nothing is counted.
+    u64 frame_count = stats.wait_count + stats.late_count;
+    frame_pacer_set_target_rate(&pacer, 0);
+    frame_pacer_wait(&pacer);
+    frame_pacer_wait(&pacer);
+    frame_pacer_get_stats(&pacer, &stats);
+    expect_should_be(frame_count, stats.wait_count + stats.late_count);
+    return true;
+}
+
+void frame_pacer_register_tests() {
+    test_manager_register_test(frame_pacer_should_hold_target_rate, "Frame pacer should hold a target rate and measure its error");
+}
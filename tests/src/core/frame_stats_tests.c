@@ -0,0 +1,62 @@
+#include "frame_stats_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <core/kmemory.h>
+#include <core/frame_stats.h>
+
+static b8 nearly_equal(f64 a, f64 b) {
+    return a - b < 0.000001 && b - a < 0.000001;
+}
+
+u8 frame_stats_should_report_percentiles_and_hitches() {
+    frame_stats_config config = {0};
+    config.window_size = 100;
+    config.hitch_threshold = 0.0905;
+    u64 size = 0;
+    void* state = test_system_start(size, frame_stats_system_initialize, &config);
+
+    // 1ms to 100ms, in a scrambled order.
+    for (u32 i = 0; i < 100; ++i) {
+        u32 ms = (i * 37) % 100 + 1;
+        frame_stats_record(FRAME_STAT_UPDATE, ms * 0.0005);
+        frame_stats_record(FRAME_STAT_UPDATE, ms * 0.0005);
+        frame_stats_frame_end(ms * 0.001);
+    }
+
+    frame_stats_report report;
+    expect_to_be_true(frame_stats_get(&report));
+    expect_should_be(100, report.frame_count);
+    expect_should_be(100, report.window_count);
+    expect_should_be(10, report.hitch_count);
+    expect_to_be_true(nearly_equal(0.1, report.worst_frame_time));
+    expect_to_be_true(nearly_equal(0.0505, report.stats[FRAME_STAT_FRAME].mean));
+    expect_to_be_true(nearly_equal(0.05, report.stats[FRAME_STAT_FRAME].p50));
+    expect_to_be_true(nearly_equal(0.095, report.stats[FRAME_STAT_FRAME].p95));
+    expect_to_be_true(nearly_equal(0.099, report.stats[FRAME_STAT_FRAME].p99));
+    expect_to_be_true(nearly_equal(0.1, report.stats[FRAME_STAT_FRAME].max));
+    // Recorded twice a frame, added together.
+    expect_to_be_true(nearly_equal(0.05, report.stats[FRAME_STAT_UPDATE].p50));
+    expect_to_be_true(nearly_equal(0.0, report.stats[FRAME_STAT_RENDER].max));
+
+    // The window rolls on; the hitches and worst frame don't.
+    for (u32 i = 0; i < 100; ++i) {
+        frame_stats_frame_end(0.002);
+    }
+    expect_to_be_true(frame_stats_get(&report));
+    expect_should_be(200, report.frame_count);
+    expect_should_be(10, report.hitch_count);
+    expect_to_be_true(nearly_equal(0.002, report.stats[FRAME_STAT_FRAME].p99));
+    expect_to_be_true(nearly_equal(0.1, report.worst_frame_time));
+
+    test_system_stop(state, size, frame_stats_system_shutdown);
+    expect_to_be_false(frame_stats_get(&report));
+    return true;
+}
+
+void frame_stats_register_tests() {
+    test_manager_register_test(frame_stats_should_report_percentiles_and_hitches, "Frame stats should report rolling percentiles and hitches");
+}
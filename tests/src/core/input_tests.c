@@ -0,0 +1,175 @@
+#include "input_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <core/kmemory.h>
+#include <core/input.h>
+
+#include <stdio.h>
+
+#define TEST_RECORDING_PATH "input_tests_recording.bin"
+
+u8 input_replay_should_match_recording() {
+    u64 size = 0;
+    void* state = test_system_start(size, input_system_initialize);
+
+    expect_to_be_true(input_recording_start(TEST_RECORDING_PATH));
+    expect_to_be_true(input_is_recording());
+    input_process_key(KEY_A, true);
+    input_process_mouse_move(10, 20);
+    input_update(0.016);
+    input_process_key(KEY_A, false);
+    input_process_button(BUTTON_LEFT, true);
+    input_update(0.016);
+    input_process_mouse_move(30, 40);
+    input_recording_stop();
+    expect_to_be_false(input_is_recording());
+
+    test_system_stop(state, size, input_system_shutdown);
+    state = test_system_start(size, input_system_initialize);
+
+    // The first frame's input is fed straight away.
+    expect_to_be_true(input_replay_start(TEST_RECORDING_PATH, 0.5));
+    expect_to_be_true(input_is_replaying());
+    expect_float_to_be(0.5, input_replay_frame_delta());
+    expect_to_be_true(input_is_key_down(KEY_A));
+    i32 x, y;
+    input_get_mouse_position(&x, &y);
+    expect_should_be(10, x);
+    expect_should_be(20, y);
+
+    // Live input is ignored while replaying.
+    input_process_key(KEY_B, true);
+    expect_to_be_false(input_is_key_down(KEY_B));
+
+    input_update(0.5);
+    expect_to_be_true(input_is_key_up(KEY_A));
+    expect_to_be_true(input_is_button_down(BUTTON_LEFT));
+
+    // Input recorded after the last frame ended still plays out.
+    input_update(0.5);
+    input_get_mouse_position(&x, &y);
+    expect_should_be(30, x);
+    expect_should_be(40, y);
+
+    input_update(0.5);
+    expect_to_be_false(input_is_replaying());
+    input_process_key(KEY_B, true);
+    expect_to_be_true(input_is_key_down(KEY_B));
+
+    test_system_stop(state, size, input_system_shutdown);
+    remove(TEST_RECORDING_PATH);
+    return true;
+}
+
+#define TEST_ACTION_JUMP 0
+#define TEST_ACTION_SAVE 1
+#define TEST_ACTION_FIRE 63
+
+u8 input_actions_should_track_bindings_and_edges() {
+    u64 size = 0;
+    void* state = test_system_start(size, input_system_initialize);
+
+    keys save_chord[2] = {KEY_LCONTROL, KEY_S};
+    expect_to_be_true(input_action_bind_key(TEST_ACTION_JUMP, KEY_SPACE));
+    expect_to_be_true(input_action_bind_key(TEST_ACTION_JUMP, KEY_W));
+    expect_to_be_true(input_action_bind(TEST_ACTION_SAVE, 2, save_chord, 0, 0));
+    expect_to_be_true(input_action_bind_button(TEST_ACTION_FIRE, BUTTON_LEFT));
+    expect_to_be_false(input_action_bind_key(INPUT_MAX_ACTIONS, KEY_A));
+    expect_should_be(0, input_actions_down());
+
+    // Either binding of an action.
+    input_process_key(KEY_W, true);
+    expect_to_be_true(input_action_is_down(TEST_ACTION_JUMP));
+    expect_to_be_true(input_action_was_pressed(TEST_ACTION_JUMP));
+    input_update(0.016);
+    input_process_key(KEY_SPACE, true);
+    input_process_key(KEY_W, false);
+    expect_to_be_true(input_action_is_down(TEST_ACTION_JUMP));
+    expect_to_be_false(input_action_was_pressed(TEST_ACTION_JUMP));
+
+    // A chord needs all of its keys.
+    input_process_key(KEY_S, true);
+    expect_to_be_false(input_action_is_down(TEST_ACTION_SAVE));
+    input_process_key(KEY_LCONTROL, true);
+    input_process_button(BUTTON_LEFT, true);
+    u64 expected = (1ull << TEST_ACTION_JUMP) | (1ull << TEST_ACTION_SAVE) | (1ull << TEST_ACTION_FIRE);
+    expect_should_be(expected, input_actions_down());
+    expected = (1ull << TEST_ACTION_SAVE) | (1ull << TEST_ACTION_FIRE);
+    expect_should_be(expected, input_actions_pressed());
+    input_update(0.016);
+
+    input_process_key(KEY_LCONTROL, false);
+    input_process_key(KEY_SPACE, false);
+    expected = (1ull << TEST_ACTION_JUMP) | (1ull << TEST_ACTION_SAVE);
+    expect_should_be(expected, input_actions_released());
+    expect_to_be_true(input_action_is_down(TEST_ACTION_FIRE));
+
+    input_action_unbind(TEST_ACTION_FIRE);
+    expect_to_be_false(input_action_is_down(TEST_ACTION_FIRE));
+    expect_to_be_false(input_action_was_released(TEST_ACTION_FIRE));
+
+    test_system_stop(state, size, input_system_shutdown);
+    return true;
+}
+
+u8 input_events_should_keep_every_transition_of_the_frame() {
+    u64 size = 0;
+    void* state = test_system_start(size, input_system_initialize);
+
+    // Several transitions within one frame, all of which should be visible in order.
+    input_process_key(KEY_A, true);
+    input_process_key(KEY_A, false);
+    input_process_key(KEY_A, true);
+    input_process_mouse_move(5, 6);
+
+    input_event_iterator iterator = input_events_this_frame();
+    input_event event;
+    u32 count = 0;
+    u64 last_ticks = 0;
+    while (input_events_next(&iterator, &event)) {
+        expect_to_be_true(event.ticks >= last_ticks);
+        last_ticks = event.ticks;
+        count++;
+    }
+    expect_should_be(4, count);
+    expect_should_be(0, iterator.dropped);
+
+    iterator = input_events_this_frame();
+    expect_to_be_true(input_events_next(&iterator, &event));
+    expect_should_be(INPUT_EVENT_KEY, event.type);
+    expect_should_be(KEY_A, event.code);
+    expect_to_be_true(event.pressed);
+    expect_to_be_true(input_events_next(&iterator, &event));
+    expect_to_be_false(event.pressed);
+
+    // A new frame starts empty.
+    input_update(0.016);
+    iterator = input_events_this_frame();
+    expect_to_be_false(input_events_next(&iterator, &event));
+
+    // Overflowing the buffer drops the oldest events.
+    for (u32 i = 0; i < INPUT_EVENT_BUFFER_SIZE + 10; ++i) {
+        input_process_mouse_move((i16)i, 0);
+    }
+    iterator = input_events_this_frame();
+    count = 0;
+    while (input_events_next(&iterator, &event)) {
+        count++;
+    }
+    expect_should_be(INPUT_EVENT_BUFFER_SIZE, count);
+    expect_should_be(10, iterator.dropped);
+    expect_should_be(INPUT_EVENT_BUFFER_SIZE + 9, event.x);
+
+    test_system_stop(state, size, input_system_shutdown);
+    return true;
+}
+
+void input_register_tests() {
+    test_manager_register_test(input_replay_should_match_recording, "Replayed input should match what was recorded, frame by frame");
+    test_manager_register_test(input_actions_should_track_bindings_and_edges, "Input actions should follow their bindings and report edges");
+    test_manager_register_test(input_events_should_keep_every_transition_of_the_frame, "Input events should keep every transition since the last frame, in order");
+}
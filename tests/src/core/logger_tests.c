@@ -0,0 +1,232 @@
+#include "logger_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <core/kmemory.h>
+#include <core/kstring.h>
+#include <core/logger.h>
+#include <core/logger_deferred.h>
+#include <platform/filesystem.h>
+#include <platform/kthread.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_LOG_PATH "logger_tests.log"
+#define TEST_BINARY_LOG_PATH "logger_tests.kblg"
+#define TEST_DECODED_LOG_PATH "logger_tests_decoded.log"
+#define TEST_LOG_THREADS 4
+#define TEST_LOG_MESSAGES_PER_THREAD 2000
+
+static void remove_test_logs() {
+    remove(TEST_LOG_PATH);
+    char path[64];
+    for (u32 i = 1; i <= 4; ++i) {
+        string_format(path, "%s.%u", TEST_LOG_PATH, i);
+        remove(path);
+    }
+    remove(TEST_BINARY_LOG_PATH);
+    remove(TEST_DECODED_LOG_PATH);
+}
+
+/**
+ * @brief Counts the lines of a log file containing the given text.
+ * @returns The number of matching lines, or -1 if the file couldn't be read.
+ */
+static i32 count_log_lines(const char* path, const char* text, char* out_last_line) {
+    file_handle f;
+    if (!filesystem_open(path, FILE_MODE_READ, false, &f)) {
+        return -1;
+    }
+    i32 count = 0;
+    char* line = 0;
+    while (filesystem_read_line(&f, &line)) {
+        if (strstr(line, text)) {
+            count++;
+            if (out_last_line) {
+                strcpy(out_last_line, line);
+            }
+        }
+        kfree(line, string_length(line) + 1, MEMORY_TAG_STRING);
+    }
+    filesystem_close(&f);
+    return count;
+}
+
+u8 logger_file_sink_should_rotate() {
+    remove_test_logs();
+
+    logger_config config = {0};
+    config.console_disabled = true;
+    config.file_path = TEST_LOG_PATH;
+    config.file_buffer_size = 1024;
+    config.file_max_size = 4096;
+    config.file_max_backups = 2;
+    u64 size = 0;
+    void* state = test_system_start(size, initialize_logging, &config);
+
+    for (u32 i = 0; i < 400; ++i) {
+        KINFO("logger_file_sink_should_rotate line %u", i);
+    }
+    test_system_stop(state, size, shutdown_logging);
+
+    // Rotated by size, keeping only the newest backups.
+    expect_to_be_true(filesystem_exists(TEST_LOG_PATH ".1"));
+    expect_to_be_true(filesystem_exists(TEST_LOG_PATH ".2"));
+    expect_to_be_false(filesystem_exists(TEST_LOG_PATH ".3"));
+
+    // Everything was written out by shutdown, ending with the last line.
+    char last_line[256] = {0};
+    i32 count = count_log_lines(TEST_LOG_PATH, "logger_file_sink_should_rotate", last_line);
+    expect_to_be_true(count > 0);
+    expect_to_be_true(strstr(last_line, "line 399") != 0);
+
+    remove_test_logs();
+    return true;
+}
+
+static u32 log_test_thread(void* params) {
+    u32 index = (u32)(u64)params;
+    for (u32 i = 0; i < TEST_LOG_MESSAGES_PER_THREAD; ++i) {
+        KTRACE("log_test_thread %u message %u", index, i);
+    }
+    return 0;
+}
+
+u8 logger_async_should_write_everything_in_order() {
+    remove_test_logs();
+
+    logger_config config = {0};
+    config.async = true;
+    config.console_disabled = true;
+    config.file_path = TEST_LOG_PATH;
+    u64 size = 0;
+    void* state = test_system_start(size, initialize_logging, &config);
+
+    kthread threads[TEST_LOG_THREADS];
+    for (u32 i = 0; i < TEST_LOG_THREADS; ++i) {
+        expect_to_be_true(kthread_create(log_test_thread, (void*)(u64)i, false, &threads[i]));
+    }
+    for (u32 i = 0; i < TEST_LOG_THREADS; ++i) {
+        kthread_wait(&threads[i]);
+    }
+
+    // A fatal message flushes everything logged before it, without shutting down.
+    KFATAL("logger_async_should_write_everything_in_order fatal");
+    expect_should_be(1, count_log_lines(TEST_LOG_PATH, "logger_async_should_write_everything_in_order fatal", 0));
+    expect_should_be(TEST_LOG_THREADS * TEST_LOG_MESSAGES_PER_THREAD, count_log_lines(TEST_LOG_PATH, "log_test_thread", 0));
+
+    test_system_stop(state, size, shutdown_logging);
+
+    // Each thread's messages are in the order they were logged.
+    file_handle f;
+    expect_to_be_true(filesystem_open(TEST_LOG_PATH, FILE_MODE_READ, false, &f));
+    u32 expected[TEST_LOG_THREADS] = {0};
+    b8 in_order = true;
+    char* line = 0;
+    while (filesystem_read_line(&f, &line)) {
+        const char* message = strstr(line, "log_test_thread");
+        u32 thread_index, message_index;
+        if (message && sscanf(message, "log_test_thread %u message %u", &thread_index, &message_index) == 2) {
+            in_order = in_order && thread_index < TEST_LOG_THREADS && message_index == expected[thread_index];
+            if (thread_index < TEST_LOG_THREADS) {
+                expected[thread_index]++;
+            }
+        }
+        kfree(line, string_length(line) + 1, MEMORY_TAG_STRING);
+    }
+    filesystem_close(&f);
+    expect_to_be_true(in_order);
+
+    remove_test_logs();
+    return true;
+}
+
+u8 logger_deferred_should_decode_binary_log() {
+    remove_test_logs();
+
+    logger_config config = {0};
+    config.async = true;
+    config.console_disabled = true;
+    config.file_path = TEST_LOG_PATH;
+    config.binary_file_path = TEST_BINARY_LOG_PATH;
+    u64 size = 0;
+    void* state = test_system_start(size, initialize_logging, &config);
+
+    for (u32 i = 0; i < 100; ++i) {
+        KLOG_DEFERRED(LOG_LEVEL_WARN, "deferred %u %s %.2f %llu %p 100%%", i, "text", i * 0.5, (u64)i * 10000000000ull, (void*)0);
+    }
+    // Can't be deferred, so is formatted straight away into the text log.
+    KLOG_DEFERRED(LOG_LEVEL_INFO, "not deferred %*d", 4, 7);
+    // Nor can a conversion spec too long to copy out.
+    KLOG_DEFERRED(LOG_LEVEL_INFO, "long spec %000000000000000000000000000000004d %s", 7, "after");
+
+    test_system_stop(state, size, shutdown_logging);
+
+    expect_to_be_true(log_binary_decode(TEST_BINARY_LOG_PATH, TEST_DECODED_LOG_PATH));
+    char last_line[256] = {0};
+    expect_should_be(100, count_log_lines(TEST_DECODED_LOG_PATH, "[WARN]:  deferred", last_line));
+    char expected[128];
+    snprintf(expected, sizeof(expected), "deferred 99 text 49.50 990000000000 %p 100%%", (void*)0);
+    expect_to_be_true(strstr(last_line, expected) != 0);
+    expect_should_be(0, count_log_lines(TEST_LOG_PATH, "deferred 99", 0));
+    expect_should_be(1, count_log_lines(TEST_LOG_PATH, "not deferred    7", 0));
+    expect_should_be(1, count_log_lines(TEST_LOG_PATH, "long spec 0007 after", 0));
+
+    remove_test_logs();
+    return true;
+}
+
+static i32 category_argument_evaluations;
+
+static i32 count_category_argument() {
+    return ++category_argument_evaluations;
+}
+
+u8 logger_category_levels_should_gate_messages() {
+    u8 saved_levels[LOG_CATEGORY_MAX_COUNT];
+    kcopy_memory(saved_levels, log_category_levels, sizeof(saved_levels));
+    u8 saved_deferred_level = log_deferred_level;
+
+    expect_to_be_true(log_category_levels_parse("all=warn, Renderer=trace,input = debug,"));
+    expect_should_be(LOG_LEVEL_TRACE, log_category_levels[LOG_CATEGORY_RENDERER]);
+    expect_should_be(LOG_LEVEL_DEBUG, log_category_levels[LOG_CATEGORY_INPUT]);
+    expect_should_be(LOG_LEVEL_WARN, log_category_levels[LOG_CATEGORY_GAME]);
+    expect_should_be(LOG_LEVEL_WARN, log_deferred_level);
+
+    // Bad pairs are reported, while the good ones still apply.
+    expect_to_be_false(log_category_levels_parse("sound=trace,game=error,events=loud"));
+    expect_should_be(LOG_LEVEL_ERROR, log_category_levels[LOG_CATEGORY_GAME]);
+    expect_should_be(LOG_LEVEL_WARN, log_category_levels[LOG_CATEGORY_EVENTS]);
+
+    // Arguments of skipped messages aren't evaluated.
+    category_argument_evaluations = 0;
+    KDEBUG_CAT(LOG_CATEGORY_GAME, "logger_category_levels_should_gate_messages %i", count_category_argument());
+    expect_should_be(0, category_argument_evaluations);
+    log_category_level_set(LOG_CATEGORY_GAME, LOG_LEVEL_TRACE);
+    KDEBUG_CAT(LOG_CATEGORY_GAME, "logger_category_levels_should_gate_messages %i", count_category_argument());
+    expect_should_be(1, category_argument_evaluations);
+
+    // Deferred messages are gated at runtime too, rather than compiled out.
+    expect_to_be_true(log_category_levels_parse("deferred=info"));
+    category_argument_evaluations = 0;
+    KTRACE_DEFERRED("logger_category_levels_should_gate_messages %i", count_category_argument());
+    expect_should_be(0, category_argument_evaluations);
+    log_deferred_level_set(LOG_LEVEL_TRACE);
+    KTRACE_DEFERRED("logger_category_levels_should_gate_messages %i", count_category_argument());
+    expect_should_be(1, category_argument_evaluations);
+
+    kcopy_memory(log_category_levels, saved_levels, sizeof(saved_levels));
+    log_deferred_level = saved_deferred_level;
+    return true;
+}
+
+void logger_register_tests() {
+    test_manager_register_test(logger_file_sink_should_rotate, "Log file sink should write everything out and rotate by size");
+    test_manager_register_test(logger_async_should_write_everything_in_order, "Async logging should write every message, in order, flushing on fatal");
+    test_manager_register_test(logger_deferred_should_decode_binary_log, "Deferred log messages should decode from the binary log");
+    test_manager_register_test(logger_category_levels_should_gate_messages, "Log category levels should parse and gate messages before formatting");
+}
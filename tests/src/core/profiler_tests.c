@@ -0,0 +1,175 @@
+#include "profiler_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <core/kmemory.h>
+#include <core/profiler.h>
+#include <platform/kthread.h>
+#include <platform/platform.h>
+#include <platform/filesystem.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_CAPTURE_PATH "profiler_tests_capture.json"
+
+static void profiled_leaf() {
+    KPROFILE_SCOPE("profiled_leaf");
+    platform_sleep(1);
+}
+
+static u32 profiled_thread(void* params) {
+    KPROFILE_SCOPE("profiled_outer");
+    profiled_leaf();
+    return 0;
+}
+
+u8 profiler_should_build_call_tree() {
+    u64 size = 0;
+    void* state = test_system_start(size, profiler_system_initialize);
+
+    {
+        KPROFILE_SCOPE("profiled_outer");
+        profiled_leaf();
+        profiled_leaf();
+    }
+    // Zones on other threads merge into the same tree.
+    kthread thread;
+    expect_to_be_true(kthread_create(profiled_thread, 0, false, &thread));
+    kthread_wait(&thread);
+    profiler_frame_end();
+
+    const profiler_frame* frame = profiler_last_frame();
+    expect_to_be_true(frame != 0);
+    expect_should_be(0, frame->dropped_zone_count);
+    u16 outer = profiler_node_find_child(frame, PROFILER_ROOT_NODE, "profiled_outer");
+    expect_to_be_true(outer != PROFILER_INVALID_NODE);
+    u16 leaf = profiler_node_find_child(frame, outer, "profiled_leaf");
+    expect_to_be_true(leaf != PROFILER_INVALID_NODE);
+    expect_should_be(PROFILER_INVALID_NODE, profiler_node_find_child(frame, PROFILER_ROOT_NODE, "profiled_leaf"));
+
+    const profiler_node* outer_node = &frame->nodes[outer];
+    const profiler_node* leaf_node = &frame->nodes[leaf];
+    expect_should_be(2, outer_node->call_count);
+    expect_should_be(3, leaf_node->call_count);
+    expect_to_be_true(leaf_node->inclusive_time >= 0.003);
+    expect_to_be_true(outer_node->inclusive_time >= leaf_node->inclusive_time);
+    // Self time is what is left once the children are taken out.
+    f64 self_error = outer_node->self_time - (outer_node->inclusive_time - leaf_node->inclusive_time);
+    expect_to_be_true(self_error < 0.000001 && self_error > -0.000001);
+    expect_to_be_true(frame->nodes[PROFILER_ROOT_NODE].inclusive_time >= outer_node->inclusive_time / 2);
+
+    // The next frame starts empty.
+    profiler_frame_end();
+    frame = profiler_last_frame();
+    expect_should_be(1, frame->node_count);
+
+    test_system_stop(state, size, profiler_system_shutdown);
+    return true;
+}
+
+u8 profiler_capture_should_write_chrome_trace() {
+    u64 size = 0;
+    void* state = test_system_start(size, profiler_system_initialize);
+
+    expect_to_be_true(profiler_capture_start(TEST_CAPTURE_PATH, 2));
+    expect_to_be_true(profiler_is_capturing());
+    expect_to_be_false(profiler_capture_start(TEST_CAPTURE_PATH, 2));
+    for (u32 frame = 0; frame < 3; ++frame) {
+        profiled_leaf();
+        KPROFILE_INSTANT("profiled_instant");
+        kthread thread;
+        expect_to_be_true(kthread_create(profiled_thread, 0, false, &thread));
+        kthread_wait(&thread);
+        profiler_frame_end();
+    }
+    // Finished by itself after 2 frames.
+    expect_to_be_false(profiler_is_capturing());
+    test_system_stop(state, size, profiler_system_shutdown);
+
+    file_handle f;
+    expect_to_be_true(filesystem_open(TEST_CAPTURE_PATH, FILE_MODE_READ, false, &f));
+    u8* text = 0;
+    u64 text_size = 0;
+    expect_to_be_true(filesystem_read_all_bytes(&f, &text, &text_size));
+    filesystem_close(&f);
+    // NOTE: Not null-terminated; the end is checked first, then overwritten.
+    expect_to_be_true(text_size > 4 && text[text_size - 3] == ']' && text[text_size - 2] == '}');
+    text[text_size - 1] = 0;
+
+    expect_to_be_true(strstr((char*)text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == (char*)text);
+    expect_to_be_true(strstr((char*)text, "\"args\":{\"name\":\"main\"}") != 0);
+    expect_to_be_true(strstr((char*)text, "{\"name\":\"profiled_outer\",\"ph\":\"X\"") != 0);
+    expect_to_be_true(strstr((char*)text, "{\"name\":\"profiled_instant\",\"ph\":\"i\"") != 0);
+    expect_to_be_true(strstr((char*)text, "{\"name\":\"memory\",\"ph\":\"C\"") != 0);
+    // 2 frames on 2 threads.
+    u32 leaf_count = 0;
+    for (char* c = (char*)text; (c = strstr(c, "\"profiled_leaf\"")); ++c) {
+        leaf_count++;
+    }
+    expect_should_be(4, leaf_count);
+
+    kfree(text, text_size, MEMORY_TAG_STRING);
+    remove(TEST_CAPTURE_PATH);
+    return true;
+}
+
+static void profiled_busy() {
+    KPROFILE_SCOPE("profiled_busy");
+    // Enough work to show up in the counters.
+    volatile u64 total = 0;
+    for (u32 i = 0; i < 100000; ++i) {
+        total += i * i;
+    }
+}
+
+u8 profiler_counters_should_attribute_or_degrade() {
+    u64 size = 0;
+    void* state = test_system_start(size, profiler_system_initialize);
+
+    // Often unavailable, such as in containers, in which case zones are only timed.
+    b8 enabled = profiler_set_counters_enabled(true);
+    for (u32 frame = 0; frame < 2; ++frame) {
+        KPROFILE_SCOPE("profiled_outer");
+        profiled_busy();
+        profiled_busy();
+    }
+    profiler_frame_end();
+
+    const profiler_frame* frame = profiler_last_frame();
+    u16 outer = profiler_node_find_child(frame, PROFILER_ROOT_NODE, "profiled_outer");
+    expect_to_be_true(outer != PROFILER_INVALID_NODE);
+    u16 busy = profiler_node_find_child(frame, outer, "profiled_busy");
+    expect_to_be_true(busy != PROFILER_INVALID_NODE);
+    expect_should_be(4, frame->nodes[busy].call_count);
+
+    const profiler_node* outer_node = &frame->nodes[outer];
+    const profiler_node* busy_node = &frame->nodes[busy];
+    if (enabled) {
+        expect_to_be_true(frame->counter_mask & (1 << PERF_COUNTER_CYCLES));
+        expect_to_be_true(busy_node->counters[PERF_COUNTER_CYCLES] > 0);
+        expect_to_be_true(outer_node->counters[PERF_COUNTER_CYCLES] >= busy_node->counters[PERF_COUNTER_CYCLES]);
+        expect_should_be(outer_node->counters[PERF_COUNTER_CYCLES] - busy_node->counters[PERF_COUNTER_CYCLES], outer_node->self_counters[PERF_COUNTER_CYCLES]);
+    } else {
+        expect_should_be(0, frame->counter_mask);
+        expect_should_be(0, busy_node->counters[PERF_COUNTER_CYCLES]);
+    }
+
+    // Once disabled, nothing more is counted.
+    expect_to_be_false(profiler_set_counters_enabled(false));
+    profiled_busy();
+    profiler_frame_end();
+    expect_should_be(0, profiler_last_frame()->counter_mask);
+
+    test_system_stop(state, size, profiler_system_shutdown);
+    return true;
+}
+
+void profiler_register_tests() {
+    test_manager_register_test(profiler_should_build_call_tree, "Profiler should build a per-frame call tree with self and inclusive times");
+    test_manager_register_test(profiler_capture_should_write_chrome_trace, "Profiler captures should write Chrome Trace Event JSON");
+    test_manager_register_test(profiler_counters_should_attribute_or_degrade, "Profiler should attribute hardware counters to zones, or do without");
+}
@@ -1,6 +1,17 @@
 #include "test_manager.h"
 
 #include "memory/linear_allocator_tests.h"
+#include "core/event_tests.h"
+#include "core/input_tests.h"
+#include "core/logger_tests.h"
+#include "core/profiler_tests.h"
+#include "core/frame_stats_tests.h"
+#include "core/frame_pacer_tests.h"
+#include "core/fixed_timestep_tests.h"
+#include "platform/platform_tests.h"
+#include "systems/job_system_tests.h"
+#include "systems/parallel_tests.h"
+#include "systems/task_graph_tests.h"
 
 #include <core/logger.h>
 
@@ -10,6 +21,17 @@ int main() {
 
     // TODO: add test registrations here.
     linear_allocator_register_tests();
+    event_register_tests();
+    input_register_tests();
+    logger_register_tests();
+    profiler_register_tests();
+    frame_stats_register_tests();
+    frame_pacer_register_tests();
+    fixed_timestep_register_tests();
+    platform_register_tests();
+    job_system_register_tests();
+    parallel_register_tests();
+    task_graph_register_tests();
 
 
     KDEBUG("Starting tests...");
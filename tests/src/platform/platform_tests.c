@@ -0,0 +1,39 @@
+#include "platform_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+
+#include <defines.h>
+
+#include <platform/platform.h>
+
+u8 platform_ticks_should_match_absolute_time() {
+    u64 frequency = platform_get_tick_frequency();
+    expect_to_be_true(frequency >= 1000000);
+    expect_should_be(1000000000, platform_ticks_to_nanoseconds(frequency));
+    expect_float_to_be(1.0f, (f32)platform_ticks_to_seconds(frequency));
+    // Large enough to overflow if multiplied out directly.
+    expect_should_be(3600ULL * 24 * 1000000000ULL, platform_ticks_to_nanoseconds(frequency * 3600 * 24));
+
+    u64 last = platform_get_ticks();
+    for (u32 i = 0; i < 1000; ++i) {
+        u64 now = platform_get_ticks();
+        expect_to_be_true(now >= last);
+        last = now;
+    }
+
+    // Both clocks should cover at least the time slept. The tick span is read inside the time
+    // span, so it can't be longer however busy the machine is, beyond calibration error.
+    f64 start_time = platform_get_absolute_time();
+    u64 start_ticks = platform_get_ticks();
+    platform_sleep(20);
+    f64 elapsed_ticks = platform_ticks_to_seconds(platform_get_ticks() - start_ticks);
+    f64 elapsed_time = platform_get_absolute_time() - start_time;
+    expect_to_be_true(elapsed_ticks >= 0.019);
+    expect_to_be_true(elapsed_time >= 0.019);
+    expect_to_be_true(elapsed_ticks <= elapsed_time * 1.01);
+    return true;
+}
+
+void platform_register_tests() {
+    test_manager_register_test(platform_ticks_should_match_absolute_time, "Platform ticks should be monotonic and match absolute time");
+}
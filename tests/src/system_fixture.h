@@ -0,0 +1,31 @@
+#pragma once
+
+#include <core/kmemory.h>
+
+/**
+ * @brief Starts a system for a test using the engine's two-call initialization: once to
+ * get the memory requirement, then again with a block of that size. Any arguments after
+ * initialize (such as a config) are passed to both calls.
+ * @param size A u64 which receives the size of the state block.
+ * @param initialize The system's initialize function.
+ * @returns A pointer to the system's state block.
+ */
+#define test_system_start(size, initialize, ...)                           \
+    ({                                                                     \
+        initialize(&(size), 0, ##__VA_ARGS__);                             \
+        void* test_system_state = kallocate(size, MEMORY_TAG_APPLICATION); \
+        initialize(&(size), test_system_state, ##__VA_ARGS__);             \
+        test_system_state;                                                 \
+    })
+
+/**
+ * @brief Shuts down a system started with test_system_start and frees its state block.
+ * @param state The system's state block.
+ * @param size The size of the state block.
+ * @param shutdown The system's shutdown function.
+ */
+#define test_system_stop(state, size, shutdown)     \
+    do {                                            \
+        shutdown(state);                            \
+        kfree(state, size, MEMORY_TAG_APPLICATION); \
+    } while (0)
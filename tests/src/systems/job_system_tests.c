@@ -0,0 +1,291 @@
+#include "job_system_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <core/kmemory.h>
+#include <systems/job_system.h>
+#include <platform/kthread.h>
+
+#define PARENT_JOB_COUNT 16
+#define CHILD_JOB_COUNT 64
+// More than a job queue holds.
+#define OVERFLOW_JOB_COUNT 5000
+
+typedef struct parent_job_data {
+    volatile i32* total;
+    b8 children_complete;
+} parent_job_data;
+
+static void increment_job(void* param) {
+    __atomic_add_fetch((volatile i32*)param, 1, __ATOMIC_ACQ_REL);
+}
+
+static void parent_job(void* param) {
+    parent_job_data* data = param;
+
+    job_decl children[CHILD_JOB_COUNT];
+    for (u32 i = 0; i < CHILD_JOB_COUNT; ++i) {
+        children[i].entry_point = increment_job;
+        children[i].param = (void*)data->total;
+    }
+
+    job_counter counter = {0};
+    job_system_run(children, CHILD_JOB_COUNT, &counter);
+    job_system_wait_for_counter(&counter);
+    data->children_complete = job_counter_is_complete(&counter);
+}
+
+static u8 run_nested_jobs(b8 use_fibers) {
+    u64 size = 0;
+    job_system_config config = {0};
+    config.worker_count = 4;
+    config.use_fibers = use_fibers;
+    void* state = test_system_start(size, job_system_initialize, &config);
+    expect_should_be(4, job_system_worker_count());
+
+    volatile i32 total = 0;
+    parent_job_data data[PARENT_JOB_COUNT];
+    job_decl parents[PARENT_JOB_COUNT];
+    for (u32 i = 0; i < PARENT_JOB_COUNT; ++i) {
+        data[i].total = &total;
+        data[i].children_complete = false;
+        parents[i].entry_point = parent_job;
+        parents[i].param = &data[i];
+    }
+
+    job_counter counter = {0};
+    expect_to_be_true(job_system_run(parents, PARENT_JOB_COUNT, &counter));
+    job_system_wait_for_counter(&counter);
+
+    expect_should_be(0, counter.value);
+    expect_should_be(PARENT_JOB_COUNT * CHILD_JOB_COUNT, total);
+    for (u32 i = 0; i < PARENT_JOB_COUNT; ++i) {
+        expect_to_be_true(data[i].children_complete);
+    }
+
+    test_system_stop(state, size, job_system_shutdown);
+    return true;
+}
+
+u8 job_system_should_run_jobs_and_wait() {
+    u64 size = 0;
+    job_system_config config = {0};
+    config.worker_count = 4;
+    config.use_fibers = false;
+    void* state = test_system_start(size, job_system_initialize, &config);
+    expect_should_be(4, job_system_worker_count());
+
+    volatile i32 total = 0;
+    job_decl jobs[CHILD_JOB_COUNT];
+    for (u32 i = 0; i < CHILD_JOB_COUNT; ++i) {
+        jobs[i].entry_point = increment_job;
+        jobs[i].param = (void*)&total;
+    }
+
+    job_counter counter = {0};
+    expect_to_be_true(job_system_run(jobs, CHILD_JOB_COUNT, &counter));
+    job_system_wait_for_counter(&counter);
+    expect_should_be(CHILD_JOB_COUNT, total);
+
+    test_system_stop(state, size, job_system_shutdown);
+    return true;
+}
+
+typedef struct lane_test_data {
+    volatile i32 background_active;
+    volatile i32 background_peak;
+    volatile i32 background_done;
+    volatile i32 high_done;
+    u64 main_thread_id;
+    volatile i32 off_main_thread;
+    volatile i32 background_on_main_thread;
+} lane_test_data;
+
+static void background_job(void* param) {
+    lane_test_data* data = param;
+    if (platform_current_thread_id() == data->main_thread_id) {
+        __atomic_add_fetch(&data->background_on_main_thread, 1, __ATOMIC_ACQ_REL);
+    }
+    i32 active = __atomic_add_fetch(&data->background_active, 1, __ATOMIC_ACQ_REL);
+    i32 peak = __atomic_load_n(&data->background_peak, __ATOMIC_ACQUIRE);
+    while (active > peak && !__atomic_compare_exchange_n(&data->background_peak, &peak, active, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    }
+    // Hold the slot long enough for others to try to start.
+    for (u32 i = 0; i < 50; ++i) {
+        kthread_yield();
+    }
+    __atomic_sub_fetch(&data->background_active, 1, __ATOMIC_ACQ_REL);
+    __atomic_add_fetch(&data->background_done, 1, __ATOMIC_ACQ_REL);
+}
+
+static void high_job(void* param) {
+    __atomic_add_fetch(&((lane_test_data*)param)->high_done, 1, __ATOMIC_ACQ_REL);
+}
+
+static void main_thread_job(void* param) {
+    lane_test_data* data = param;
+    if (platform_current_thread_id() != data->main_thread_id) {
+        __atomic_add_fetch(&data->off_main_thread, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+u8 job_system_should_respect_lanes() {
+    job_system_config config = {0};
+    config.worker_count = 4;
+    config.use_fibers = true;
+    config.max_background_workers = 1;
+    u64 size = 0;
+    void* state = test_system_start(size, job_system_initialize, &config);
+    expect_should_be(4, job_system_worker_count());
+    expect_to_be_true(job_system_is_main_thread());
+
+    lane_test_data data = {0};
+    data.main_thread_id = platform_current_thread_id();
+
+    job_decl background[16];
+    job_decl high[16];
+    job_decl main_thread[16];
+    for (u32 i = 0; i < 16; ++i) {
+        background[i].entry_point = background_job;
+        background[i].param = &data;
+        high[i].entry_point = high_job;
+        high[i].param = &data;
+        main_thread[i].entry_point = main_thread_job;
+        main_thread[i].param = &data;
+    }
+
+    job_counter background_counter = {0};
+    job_counter high_counter = {0};
+    job_counter main_counter = {0};
+    expect_to_be_true(job_system_run_with_priority(background, 16, JOB_PRIORITY_BACKGROUND, &background_counter));
+    expect_to_be_true(job_system_run_with_priority(high, 16, JOB_PRIORITY_HIGH, &high_counter));
+
+    // High priority work completes without waiting behind the background queue.
+    job_system_wait_for_counter(&high_counter);
+    expect_should_be(16, data.high_done);
+
+    // Main thread jobs run here, either drained explicitly or while waiting.
+    expect_to_be_true(job_system_run_on_main_thread(main_thread, 8, &main_counter));
+    expect_should_be(8, job_system_drain_main_thread());
+    expect_to_be_true(job_counter_is_complete(&main_counter));
+    expect_to_be_true(job_system_run_on_main_thread(&main_thread[8], 8, &main_counter));
+    job_system_wait_for_counter(&main_counter);
+    expect_should_be(0, data.off_main_thread);
+
+    job_system_wait_for_counter(&background_counter);
+    expect_should_be(16, data.background_done);
+    expect_should_be(1, data.background_peak);
+
+    test_system_stop(state, size, job_system_shutdown);
+    return true;
+}
+
+u8 job_system_should_keep_background_lane_when_full() {
+    job_system_config config = {0};
+    config.worker_count = 4;
+    config.use_fibers = true;
+    config.max_background_workers = 1;
+    u64 size = 0;
+    void* state = test_system_start(size, job_system_initialize, &config);
+    expect_should_be(4, job_system_worker_count());
+
+    lane_test_data data = {0};
+    data.main_thread_id = platform_current_thread_id();
+
+    job_decl* background = kallocate(sizeof(job_decl) * OVERFLOW_JOB_COUNT, MEMORY_TAG_APPLICATION);
+    for (u32 i = 0; i < OVERFLOW_JOB_COUNT; ++i) {
+        background[i].entry_point = background_job;
+        background[i].param = &data;
+    }
+
+    // Overflows the queue, which must wait for room rather than running the rest here.
+    job_counter counter = {0};
+    expect_to_be_true(job_system_run_with_priority(background, OVERFLOW_JOB_COUNT, JOB_PRIORITY_BACKGROUND, &counter));
+    job_system_wait_for_counter(&counter);
+    expect_should_be(OVERFLOW_JOB_COUNT, data.background_done);
+    expect_should_be(0, data.background_on_main_thread);
+    expect_should_be(1, data.background_peak);
+
+    kfree(background, sizeof(job_decl) * OVERFLOW_JOB_COUNT, MEMORY_TAG_APPLICATION);
+    test_system_stop(state, size, job_system_shutdown);
+    return true;
+}
+
+typedef struct migration_test_data {
+    volatile i32 migrated;
+    volatile i32 mismatched;
+} migration_test_data;
+
+static void yielding_job(void* param) {
+    kthread_yield();
+}
+
+static void migrating_parent_job(void* param) {
+    migration_test_data* data = param;
+    job_decl children[8];
+    for (u32 i = 0; i < 8; ++i) {
+        children[i].entry_point = yielding_job;
+        children[i].param = 0;
+    }
+
+    for (u32 round = 0; round < 8; ++round) {
+        u64 thread_id = platform_current_thread_id();
+        job_counter counter = {0};
+        job_system_run(children, 8, &counter);
+        job_system_wait_for_counter(&counter);
+        if (platform_current_thread_id() != thread_id) {
+            __atomic_add_fetch(&data->migrated, 1, __ATOMIC_ACQ_REL);
+        }
+        // Still this job, wherever the fiber was resumed. A thread with no job reports normal.
+        if (job_system_current_priority() != JOB_PRIORITY_HIGH) {
+            __atomic_add_fetch(&data->mismatched, 1, __ATOMIC_ACQ_REL);
+        }
+    }
+}
+
+u8 job_system_should_keep_current_job_across_migration() {
+    u64 size = 0;
+    job_system_config config = {0};
+    config.worker_count = 4;
+    config.use_fibers = true;
+    void* state = test_system_start(size, job_system_initialize, &config);
+    expect_should_be(4, job_system_worker_count());
+
+    migration_test_data data = {0};
+    // Keep going until parked fibers have been seen resuming on other threads.
+    for (u32 attempt = 0; attempt < 20 && data.migrated == 0; ++attempt) {
+        job_decl parents[PARENT_JOB_COUNT];
+        for (u32 i = 0; i < PARENT_JOB_COUNT; ++i) {
+            parents[i].entry_point = migrating_parent_job;
+            parents[i].param = &data;
+        }
+        job_counter counter = {0};
+        expect_to_be_true(job_system_run_with_priority(parents, PARENT_JOB_COUNT, JOB_PRIORITY_HIGH, &counter));
+        job_system_wait_for_counter(&counter);
+    }
+    expect_to_be_true(data.migrated > 0);
+    expect_should_be(0, data.mismatched);
+
+    test_system_stop(state, size, job_system_shutdown);
+    return true;
+}
+
+u8 job_system_nested_wait_blocking() {
+    return run_nested_jobs(false);
+}
+
+u8 job_system_nested_wait_fibers() {
+    return run_nested_jobs(true);
+}
+
+void job_system_register_tests() {
+    test_manager_register_test(job_system_should_run_jobs_and_wait, "Job system should run jobs and wait on counter");
+    test_manager_register_test(job_system_nested_wait_blocking, "Job system nested waits in blocking mode");
+    test_manager_register_test(job_system_nested_wait_fibers, "Job system nested waits park fibers");
+    test_manager_register_test(job_system_should_keep_current_job_across_migration, "Job system should keep a fiber's current job when it resumes on another thread");
+    test_manager_register_test(job_system_should_respect_lanes, "Job system should respect priority lanes and main thread affinity");
+    test_manager_register_test(job_system_should_keep_background_lane_when_full, "Job system should keep background jobs off the main thread when the queue is full");
+}
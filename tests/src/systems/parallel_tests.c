@@ -0,0 +1,104 @@
+#include "parallel_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <containers/darray.h>
+#include <core/kmemory.h>
+#include <systems/job_system.h>
+#include <systems/parallel.h>
+
+#define ELEMENT_COUNT 10000
+
+static void double_elements(void* elements, u64 first_index, u64 count, void* user) {
+    u32* values = elements;
+    for (u64 i = 0; i < count; ++i) {
+        values[i] = (u32)(first_index + i) * 2;
+    }
+}
+
+static void sum_range(u64 begin, u64 end, void* user, void* out_partial) {
+    u64* sum = out_partial;
+    for (u64 i = begin; i < end; ++i) {
+        *sum += i;
+    }
+}
+
+static void sum_elements(const void* elements, u64 first_index, u64 count, void* user, void* out_partial) {
+    const u32* values = elements;
+    u64* sum = out_partial;
+    for (u64 i = 0; i < count; ++i) {
+        *sum += values[i];
+    }
+}
+
+static void combine_sum(void* accumulator, const void* partial, void* user) {
+    *(u64*)accumulator += *(const u64*)partial;
+}
+
+u8 parallel_for_darray_should_visit_every_element() {
+    job_system_config config = {0};
+    config.worker_count = 4;
+    config.use_fibers = true;
+    u64 size = 0;
+    void* state = test_system_start(size, job_system_initialize, &config);
+
+    u32* values = darray_reserve(u32, ELEMENT_COUNT);
+    for (u32 i = 0; i < ELEMENT_COUNT; ++i) {
+        darray_push(values, (u32)0);
+    }
+
+    parallel_for_darray(values, 0, double_elements, 0);
+    for (u32 i = 0; i < ELEMENT_COUNT; ++i) {
+        expect_should_be(i * 2, values[i]);
+    }
+
+    u64 sum = 0;
+    u64 identity = 0;
+    parallel_reduce_darray(values, 100, sizeof(u64), &identity, sum_elements, combine_sum, 0, &sum);
+    expect_should_be((u64)ELEMENT_COUNT * (ELEMENT_COUNT - 1), sum);
+
+    darray_destroy(values);
+    test_system_stop(state, size, job_system_shutdown);
+    return true;
+}
+
+u8 parallel_reduce_should_match_serial_result() {
+    u64 expected = (u64)ELEMENT_COUNT * (ELEMENT_COUNT - 1) / 2;
+    u64 identity = 0;
+
+    // No job system; runs inline.
+    u64 sum = 0;
+    parallel_reduce(0, ELEMENT_COUNT, 0, sizeof(u64), &identity, sum_range, combine_sum, 0, &sum);
+    expect_should_be(expected, sum);
+
+    job_system_config config = {0};
+    config.worker_count = 4;
+    config.use_fibers = true;
+    u64 size = 0;
+    void* state = test_system_start(size, job_system_initialize, &config);
+
+    sum = 0;
+    parallel_reduce(0, ELEMENT_COUNT, 0, sizeof(u64), &identity, sum_range, combine_sum, 0, &sum);
+    expect_should_be(expected, sum);
+
+    // A grain of 1 exceeds the chunk limit, so chunks must be grown to cover the range.
+    sum = 0;
+    parallel_reduce(0, ELEMENT_COUNT, 1, sizeof(u64), &identity, sum_range, combine_sum, 0, &sum);
+    expect_should_be(expected, sum);
+
+    // Empty ranges yield the identity.
+    sum = 123;
+    parallel_reduce(5, 5, 0, sizeof(u64), &identity, sum_range, combine_sum, 0, &sum);
+    expect_should_be(0, sum);
+
+    test_system_stop(state, size, job_system_shutdown);
+    return true;
+}
+
+void parallel_register_tests() {
+    test_manager_register_test(parallel_for_darray_should_visit_every_element, "parallel_for_darray should visit every element");
+    test_manager_register_test(parallel_reduce_should_match_serial_result, "parallel_reduce should match the serial result");
+}
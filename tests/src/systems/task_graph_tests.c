@@ -0,0 +1,106 @@
+#include "task_graph_tests.h"
+#include "../test_manager.h"
+#include "../expect.h"
+#include "../system_fixture.h"
+
+#include <defines.h>
+
+#include <core/kmemory.h>
+#include <systems/job_system.h>
+#include <systems/task_graph.h>
+
+typedef struct graph_test_data {
+    volatile i32 sequence;
+    i32 order[4];
+} graph_test_data;
+
+typedef struct graph_test_task {
+    graph_test_data* data;
+    u32 index;
+} graph_test_task;
+
+static b8 record_order(void* user) {
+    graph_test_task* task = user;
+    task->data->order[task->index] = __atomic_add_fetch(&task->data->sequence, 1, __ATOMIC_ACQ_REL);
+    return true;
+}
+
+static b8 fail_task(void* user) {
+    return false;
+}
+
+static u8 run_graph(b8 with_jobs) {
+    u64 size = 0;
+    void* state = 0;
+    if (with_jobs) {
+        job_system_config config = {0};
+        config.worker_count = 4;
+        config.use_fibers = true;
+        state = test_system_start(size, job_system_initialize, &config);
+    }
+
+    task_graph graph;
+    expect_to_be_true(task_graph_create(&graph));
+    u64 a = task_graph_resource(&graph, "a");
+    u64 b = task_graph_resource(&graph, "b");
+    expect_should_be(a, task_graph_resource(&graph, "a"));
+    expect_should_not_be(a, b);
+
+    graph_test_data data = {0};
+    graph_test_task tasks[4];
+    // 0 writes a, 1 writes b, 2 reads both, 3 writes a again (after 2's read).
+    u64 reads[4] = {0, 0, a | b, 0};
+    u64 writes[4] = {a, b, 0, a};
+    for (u32 i = 0; i < 4; ++i) {
+        tasks[i].data = &data;
+        tasks[i].index = i;
+        task_desc desc = {0};
+        desc.name = "test_task";
+        desc.execute = record_order;
+        desc.user = &tasks[i];
+        desc.reads = reads[i];
+        desc.writes = writes[i];
+        expect_to_be_true(task_graph_add_task(&graph, &desc));
+    }
+
+    for (u32 frame = 0; frame < 8; ++frame) {
+        data.sequence = 0;
+        expect_to_be_true(task_graph_execute(&graph));
+        expect_should_be(4, data.sequence);
+        expect_to_be_true(data.order[2] > data.order[0]);
+        expect_to_be_true(data.order[2] > data.order[1]);
+        expect_to_be_true(data.order[3] > data.order[2]);
+    }
+    u16 first_dependent = graph.tasks[0].dependents[0];
+    expect_should_be(2, first_dependent);
+    expect_should_be(2, graph.tasks[2].dependency_count);
+
+    // A failing task fails the execution.
+    task_desc failing = {0};
+    failing.name = "failing_task";
+    failing.execute = fail_task;
+    failing.writes = b;
+    expect_to_be_true(task_graph_add_task(&graph, &failing));
+    expect_to_be_false(task_graph_execute(&graph));
+
+    task_graph_report(&graph);
+    task_graph_destroy(&graph);
+
+    if (state) {
+        test_system_stop(state, size, job_system_shutdown);
+    }
+    return true;
+}
+
+u8 task_graph_should_respect_dependencies_inline() {
+    return run_graph(false);
+}
+
+u8 task_graph_should_respect_dependencies_on_jobs() {
+    return run_graph(true);
+}
+
+void task_graph_register_tests() {
+    test_manager_register_test(task_graph_should_respect_dependencies_inline, "Task graph should respect dependencies without a job system");
+    test_manager_register_test(task_graph_should_respect_dependencies_on_jobs, "Task graph should respect dependencies on the job system");
+}